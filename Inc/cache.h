@@ -0,0 +1,82 @@
+/*
+
+  cache.h - driver code for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+L1_CACHE_ENABLE 0 - caches off.
+L1_CACHE_ENABLE 1 - instruction and data caches on, the .dmaram section is mapped non-cacheable by the MPU.
+L1_CACHE_ENABLE 2 - caches on without the MPU mapping. DMA buffers are then cached without maintenance and received
+                    data may be lost or corrupted, only for measuring the cost of the non-cacheable DMA region.
+
+Code is linked at 0x08000000 and fetched from flash over the AXIM interface, the ART accelerator and flash prefetch
+only serve the ITCM flash interface at 0x00200000 and are left disabled as they would not speed up this code. Flash wait
+states are only hidden by the L1 instruction cache and by the functions placed in ITCM RAM.
+
+Benchmark procedure, build the same configuration with ISR_PROFILE_ENABLE and STREAM_BENCH_ENABLE set to 1 three times,
+with L1_CACHE_ENABLE set to 0, 2 and 1. For each build:
+
+1. Reset the controller and run a representative job, e.g. a long arc or a raster file, with the maximum step rate in use.
+2. Output the interrupt handler execution times with $ISR and note the average and maximum for the stepper and
+   pulse-off handlers, and for the serial, USB or Ethernet handlers of the stream in use.
+3. Run tools/stream_bench in sink mode, $SBM=S, over the same stream and note bps, lps and ovf. Repeat in
+   timestamp mode, $SBM=T, while sending ? status reports to get the realtime command round trip under load.
+
+The difference between the 0 and 2 builds is the gain from the caches, the difference between the 2 and 1 builds
+is the cost of keeping DMA buffers non-cacheable. Results from the 2 build are only valid if no stream errors
+were seen, use the SPI SD card and Ethernet only with the 0 and 1 builds.
+
+*/
+
+#pragma once
+
+#include "main.h"
+
+#define CACHE_LINE_SIZE 32
+
+// Uninitialized buffers accessed by DMA, placed in the .dmaram section which is mapped non-cacheable by the MPU.
+// No cache maintenance is needed for these.
+#ifndef DMA_DATA
+#define DMA_DATA __attribute__((section(".dmaram"), aligned(CACHE_LINE_SIZE)))
+#endif
+
+void cache_init (void);
+
+// Cache maintenance for buffers not in the DMA region, no-ops when the data cache is not enabled.
+// Buffers that are written by DMA should be cache line aligned and sized, or data adjacent to them may be lost.
+
+// Write back cached data to memory before it is read by DMA.
+static inline void cache_clean (const void *addr, uint32_t size)
+{
+    if(SCB->CCR & SCB_CCR_DC_Msk) {
+        uint32_t start = (uint32_t)addr & ~(CACHE_LINE_SIZE - 1);
+        SCB_CleanDCache_by_Addr((uint32_t *)start, (int32_t)(size + (uint32_t)addr - start));
+    }
+}
+
+// Discard cached data after memory has been written by DMA.
+static inline void cache_invalidate (void *addr, uint32_t size)
+{
+    if(SCB->CCR & SCB_CCR_DC_Msk) {
+        uint32_t start = (uint32_t)addr & ~(CACHE_LINE_SIZE - 1);
+        SCB_InvalidateDCache_by_Addr((uint32_t *)start, (int32_t)(size + (uint32_t)addr - start));
+    }
+}
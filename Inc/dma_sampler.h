@@ -0,0 +1,39 @@
+/*
+
+  dma_sampler.h - timer triggered DMA sampling of aux input ports for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if DMA_SAMPLER_ENABLE
+
+bool dma_sampler_add (input_signal_t *input);
+bool dma_sampler_owns (const input_signal_t *input);
+bool dma_sampler_irq_enable (const input_signal_t *input, pin_irq_mode_t irq_mode);
+uint32_t dma_sampler_get_edges (const input_signal_t *input);
+bool dma_sampler_init (void);
+
+#define DMA_SAMPLED(input) dma_sampler_owns(input)
+
+#else
+
+#define DMA_SAMPLED(input) false
+
+#endif // DMA_SAMPLER_ENABLE
@@ -47,8 +47,25 @@
 #include "grbl/driver_opts.h"
 
 #include "timers.h"
+#include "cache.h"
 
+#ifndef ISR_CODE
+#define ISR_CODE
+#endif
+
+// Data accessed from interrupt context, placed in the zero wait state DTCM. DTCM_DATA data is zeroed by the startup code
+// and any initializer is ignored, use DTCM_INIT_DATA for data with non-zero initializers.
+// Placement is manual, the main stack takes the DTCM left over by tagged data - see the linker scripts.
+#ifndef DTCM_DATA
+#define DTCM_DATA __attribute__((section(".dtcmbss")))
+#endif
+#ifndef DTCM_INIT_DATA
+#define DTCM_INIT_DATA __attribute__((section(".dtcmram")))
+#endif
+
+#ifndef DIGITAL_OUT // may be overridden by the host step timing simulator, see tools/step_sim
 #define DIGITAL_OUT(port, bit, on) { (port)->BSRR = (on) ? (bit) : ((bit) << 16); }
+#endif
 #define DIGITAL_IN(port, bit) (!!((port)->IDR & (bit)))
 
 #define timer(t) timerN(t)
@@ -109,6 +126,202 @@
 #define GPIO_MAP     14
 #define GPIO_SINGLE  15
 
+// Set to 1 to output step pulses via timer triggered DMA instead of from the stepper interrupt.
+// All step outputs must be on the same port, STEP_OUTMODE is still used for clearing outputs.
+#ifndef STEP_DMA_ENABLE
+#define STEP_DMA_ENABLE 0
+#endif
+
+// Set to 1 to output step pulses from timer channels in one-pulse mode, pulse delay and length is then generated by hardware.
+// All step pins must be timer capable, see pwm_pin[] in pwm.c. Timers used are claimed and cannot be used for PWM outputs.
+#ifndef STEP_OPM_ENABLE
+#define STEP_OPM_ENABLE 0
+#endif
+
+// Set to 1 to debounce inputs by sampling them from a low priority timer interrupt instead of rechecking them after 40 ms from a delayed task.
+// Level changes are filtered by an integrating counter per input, a new level is accepted when stable for about DEBOUNCE_INPUT_US. Claims TIM7.
+#ifndef DEBOUNCE_TIMER_ENABLE
+#define DEBOUNCE_TIMER_ENABLE 0
+#endif
+#ifndef DEBOUNCE_SAMPLE_US
+#define DEBOUNCE_SAMPLE_US 50
+#endif
+#ifndef DEBOUNCE_INPUT_US
+#define DEBOUNCE_INPUT_US 2000
+#endif
+// Limit inputs are only debounced when DEBOUNCE_LIMIT_US is set > 0, keep it short as it adds to the limit switch reaction time.
+#ifndef DEBOUNCE_LIMIT_US
+#define DEBOUNCE_LIMIT_US 0
+#endif
+// Debounce times for individual control inputs, board map or aux input mapped, default to DEBOUNCE_INPUT_US.
+#ifndef DEBOUNCE_ESTOP_US
+#define DEBOUNCE_ESTOP_US DEBOUNCE_INPUT_US
+#endif
+#ifndef DEBOUNCE_RESET_US
+#define DEBOUNCE_RESET_US DEBOUNCE_INPUT_US
+#endif
+#ifndef DEBOUNCE_FEED_HOLD_US
+#define DEBOUNCE_FEED_HOLD_US DEBOUNCE_INPUT_US
+#endif
+#ifndef DEBOUNCE_CYCLE_START_US
+#define DEBOUNCE_CYCLE_START_US DEBOUNCE_INPUT_US
+#endif
+#ifndef DEBOUNCE_SAFETY_DOOR_US
+#define DEBOUNCE_SAFETY_DOOR_US DEBOUNCE_INPUT_US
+#endif
+
+// Set to 1 to latch the step position from the probe, probe 2 and toolsetter pin interrupts, output by the $PRL command.
+// Set to 2 to also use the latched position as the probe result. Probe inputs must be interrupt capable.
+#ifndef PROBE_LATCH_ENABLE
+#define PROBE_LATCH_ENABLE 0
+#endif
+
+// Set to 1 to pass aux input, SD card detect, MPG mode and I2C strobe events from interrupt context to the foreground
+// via timestamped event rings, ring statistics are output by the $IEV command. Safety critical inputs are still handled in the interrupt.
+#ifndef INPUT_EVENTS_ENABLE
+#define INPUT_EVENTS_ENABLE 0
+#endif
+
+// Set to 1 to sample aux inputs that cannot be assigned an EXTI line by timer triggered DMA reads of the port IDR registers,
+// edges are detected by comparing consecutive samples. Up to DMA_SAMPLER_MAX_PORTS ports can be sampled. Claims TIM1 and DMA2 streams 5 and 6.
+#ifndef DMA_SAMPLER_ENABLE
+#define DMA_SAMPLER_ENABLE 0
+#endif
+#ifndef DMA_SAMPLER_RATE
+#define DMA_SAMPLER_RATE 100000 // Hz, max ~1 MHz
+#endif
+#ifndef DMA_SAMPLER_BUFFER_SIZE
+#define DMA_SAMPLER_BUFFER_SIZE 256 // samples per port, must be a power of 2
+#endif
+
+// Set to 1 to turn analog aux inputs assigned to a timer channel 1 or 2 pin without ADC function into frequency, period or duty cycle meters.
+// The timer is run in PWM input mode and captures are transferred by DMA to a small ring, values are averaged over the ring.
+#ifndef FREQ_METER_ENABLE
+#define FREQ_METER_ENABLE 0
+#endif
+#ifndef FREQ_METER_MODE
+#define FREQ_METER_MODE 0 // Value returned for the analog port, 0: frequency in Hz, 1: period in microseconds, 2: duty cycle in percent
+#endif
+#ifndef FREQ_METER_MIN_HZ
+#define FREQ_METER_MIN_HZ 5 // Lowest frequency measured, sets the timer prescaler for 16 bit timers. 0 is reported below this.
+#endif
+#ifndef FREQ_METER_RING_SIZE
+#define FREQ_METER_RING_SIZE 8 // Captures averaged
+#endif
+
+// Set to 1 to read limit and control inputs with a single IDR read per port via gather tables, the $INB command outputs a cycle count comparison.
+#ifndef INPUT_GATHER_ENABLE
+#define INPUT_GATHER_ENABLE 0
+#endif
+#ifndef INPUT_GATHER_MAX_PORTS
+#define INPUT_GATHER_MAX_PORTS 4
+#endif
+
+// Set to 1 to capture a timestamped trace of step and direction output writes, timing statistics are output by the $STT command.
+#ifndef STEP_TRACE_ENABLE
+#define STEP_TRACE_ENABLE 0
+#endif
+
+// Set to 1 to verify emitted step pulses by counting them with timers, the step outputs must be wired to timer inputs
+// defined by <axis>_STEP_LOOPBACK_PORT and <axis>_STEP_LOOPBACK_PIN in the board map. Mismatches are reported by the $SLB command.
+#ifndef STEP_LOOPBACK_ENABLE
+#define STEP_LOOPBACK_ENABLE 0
+#endif
+
+// Set to 1 to output step and direction signals via per port lookup tables, a single BSRR write per port used.
+// Overrides STEP_OUTMODE and DIRECTION_OUTMODE, falls back to these if outputs are spread over more than STEP_PORTMAP_MAX_PORTS ports.
+#ifndef STEP_PORTMAP_ENABLE
+#define STEP_PORTMAP_ENABLE 0
+#endif
+#ifndef STEP_PORTMAP_MAX_PORTS
+#define STEP_PORTMAP_MAX_PORTS 4
+#endif
+
+// Set to 1 to enable the L1 instruction and data caches. DMA buffers must then be tagged DMA_DATA
+// or be maintained by the cache_clean() and cache_invalidate() helpers, see cache.h.
+// Set to 2 to enable the caches without the non-cacheable DMA region, unsafe and only for benchmarking, see cache.h.
+#ifndef L1_CACHE_ENABLE
+#define L1_CACHE_ENABLE 0
+#endif
+
+// Set to 1 to receive on the UARTs via circular DMA, received data is processed from the idle line and DMA half and full transfer
+// interrupts. Realtime command latency is bounded by the time to receive SERIAL_RX_DMA_SIZE / 2 characters, statistics are output by the $SRX command.
+#ifndef SERIAL_RX_DMA_ENABLE
+#define SERIAL_RX_DMA_ENABLE 0
+#endif
+#ifndef SERIAL_RX_DMA_SIZE
+#define SERIAL_RX_DMA_SIZE 64 // must be a power of 2
+#endif
+
+// Set to 1 to transmit on the UARTs via DMA, written data is copied to the transmit buffer in blocks and sent in contiguous chunks
+// chained from the DMA transfer complete interrupt. Statistics are output by the $STX command.
+#ifndef SERIAL_TX_DMA_ENABLE
+#define SERIAL_TX_DMA_ENABLE 0
+#endif
+
+// Set to 1 to frame Modbus RTU traffic on the MODBUS_RTU_STREAM port in hardware: the transceiver is switched by the peripheral
+// driver enable output and received frames are made available whole when the receiver timeout detects the inter-frame gap.
+#ifndef MODBUS_HW_FRAMING_ENABLE
+#define MODBUS_HW_FRAMING_ENABLE 0
+#endif
+#ifndef RS485_DE_ASSERT_TIME
+#define RS485_DE_ASSERT_TIME 16   // driver enable to start bit, sample times (1/16 or 1/8 bit), max 31
+#endif
+#ifndef RS485_DE_DEASSERT_TIME
+#define RS485_DE_DEASSERT_TIME 16 // last stop bit to driver disable, sample times, max 31
+#endif
+
+// Set to 1 to allow bulk reads of the UART and USB CDC input buffers as contiguous spans, see stream_span.h.
+// Line assembly throughput from spans and from single character reads is compared by the $RSB command.
+#ifndef STREAM_SPAN_ENABLE
+#define STREAM_SPAN_ENABLE 0
+#endif
+
+// Set to 1 to add the $SBM command for measuring input stream throughput from a host in sink, echo or timestamp mode,
+// see stream_bench.h. Input buffer overflows are only reported when STREAM_SPAN_ENABLE is set.
+#ifndef STREAM_BENCH_ENABLE
+#define STREAM_BENCH_ENABLE 0
+#endif
+
+// Set to 1 to measure the time from a limit or e-stop interrupt to the step interrupt being disabled by stepperGoIdle(),
+// statistics are output by the $LAT command. For debounced inputs the time is measured from when the level is accepted,
+// the debounce time is not included.
+#ifndef TRIP_LATENCY_ENABLE
+#define TRIP_LATENCY_ENABLE 0
+#endif
+
+// Set to 1 to enable interrupt handler profiling, statistics are output by the $ISR command.
+#ifndef ISR_PROFILE_ENABLE
+#define ISR_PROFILE_ENABLE 0
+#endif
+
+#if DEBOUNCE_TIMER_ENABLE && (DEBOUNCE_INPUT_US / DEBOUNCE_SAMPLE_US > 32767 || DEBOUNCE_LIMIT_US / DEBOUNCE_SAMPLE_US > 32767 || \
+                               DEBOUNCE_ESTOP_US / DEBOUNCE_SAMPLE_US > 32767 || DEBOUNCE_RESET_US / DEBOUNCE_SAMPLE_US > 32767 || \
+                               DEBOUNCE_FEED_HOLD_US / DEBOUNCE_SAMPLE_US > 32767 || DEBOUNCE_CYCLE_START_US / DEBOUNCE_SAMPLE_US > 32767 || \
+                               DEBOUNCE_SAFETY_DOOR_US / DEBOUNCE_SAMPLE_US > 32767)
+#error "Debounce time too long for DEBOUNCE_SAMPLE_US!"
+#endif
+
+#if DMA_SAMPLER_ENABLE && (DMA_SAMPLER_BUFFER_SIZE & (DMA_SAMPLER_BUFFER_SIZE - 1))
+#error "DMA_SAMPLER_BUFFER_SIZE must be a power of 2!"
+#endif
+
+#if FREQ_METER_ENABLE && (FREQ_METER_RING_SIZE < 2 || FREQ_METER_MIN_HZ < 1)
+#error "FREQ_METER_RING_SIZE must be at least 2 and FREQ_METER_MIN_HZ at least 1!"
+#endif
+
+#if SERIAL_RX_DMA_ENABLE && (SERIAL_RX_DMA_SIZE & (SERIAL_RX_DMA_SIZE - 1))
+#error "SERIAL_RX_DMA_SIZE must be a power of 2!"
+#endif
+
+#if STEP_DMA_ENABLE && STEP_OPM_ENABLE
+#error "STEP_DMA_ENABLE and STEP_OPM_ENABLE cannot be enabled at the same time!"
+#endif
+
+#if STEP_OPM_ENABLE && DMA_SAMPLER_ENABLE
+#error "STEP_OPM_ENABLE and DMA_SAMPLER_ENABLE cannot be enabled at the same time, both use TIM1!"
+#endif
+
 #ifndef IS_NUCLEO_DEVKIT
 #if defined(NUCLEO_F756)
 #define IS_NUCLEO_DEVKIT 1
@@ -163,6 +376,32 @@
 #define STEPPER_TIMER_IRQn          timerINT(STEPPER_TIMER_N)
 #define STEPPER_TIMER_IRQHandler    timerHANDLER(STEPPER_TIMER_N)
 
+#if STEP_DMA_ENABLE
+
+// Step pulses are output by DMA transfers to the GPIO BSRR register, triggered by
+// compare events from a one-pulse mode timer. TIM8 CC3 -> pulse on, CC4 -> pulse off.
+
+#define STEP_PULSE_TIMER_N          8
+#define STEP_PULSE_TIMER_BASE       timerBase(STEP_PULSE_TIMER_N)
+#define STEP_PULSE_TIMER            timer(STEP_PULSE_TIMER_N)
+#define STEP_PULSE_TIMER_CLKEN      timerCLKEN(STEP_PULSE_TIMER_N)
+#define STEP_PULSE_DMA_ON           DMA2_Stream4 // TIM8_CH3
+#define STEP_PULSE_DMA_OFF          DMA2_Stream7 // TIM8_CH4
+#define STEP_PULSE_DMA_CHANNEL      DMA_CHANNEL_7
+#define STEP_PULSE_DMA_IFCR         DMA2->HIFCR
+#define STEP_PULSE_DMA_IFLAGS       (DMA_HIFCR_CTCIF4|DMA_HIFCR_CHTIF4|DMA_HIFCR_CTEIF4|DMA_HIFCR_CDMEIF4|DMA_HIFCR_CFEIF4|\
+                                     DMA_HIFCR_CTCIF7|DMA_HIFCR_CHTIF7|DMA_HIFCR_CTEIF7|DMA_HIFCR_CDMEIF7|DMA_HIFCR_CFEIF7)
+
+#ifndef STEP_DMA_PORT
+#ifdef STEP_PORT
+#define STEP_DMA_PORT STEP_PORT
+#else
+#define STEP_DMA_PORT X_STEP_PORT
+#endif
+#endif
+
+#endif // STEP_DMA_ENABLE
+
 #if ETHERNET_ENABLE
 
     /**ETH GPIO Configuration
@@ -197,7 +436,55 @@
 
 #endif
 
-#define IS_TIMER_CLAIMED(INSTANCE) ((INSTANCE) == STEPPER_TIMER_BASE)
+#if DEBOUNCE_TIMER_ENABLE
+
+#define DEBOUNCE_TIMER_N            7
+#define DEBOUNCE_TIMER_BASE         timerBase(DEBOUNCE_TIMER_N)
+#define DEBOUNCE_TIMER              timer(DEBOUNCE_TIMER_N)
+#define DEBOUNCE_TIMER_CLKEN        timerCLKEN(DEBOUNCE_TIMER_N)
+#define DEBOUNCE_TIMER_IRQn         timerINT(DEBOUNCE_TIMER_N)
+#define DEBOUNCE_TIMER_IRQHandler   timerHANDLER(DEBOUNCE_TIMER_N)
+#define IS_DEBOUNCE_TIMER(INSTANCE) ((INSTANCE) == DEBOUNCE_TIMER_BASE)
+
+#else
+#define IS_DEBOUNCE_TIMER(INSTANCE) 0
+#endif
+
+#if DMA_SAMPLER_ENABLE
+
+// Port IDR registers are read by DMA2 as DMA1 cannot access the AHB1 GPIO ports. TIM1 UP -> port 0, TIM1 CC3 -> port 1.
+
+#define DMA_SAMPLER_MAX_PORTS       2
+#define DMA_SAMPLER_TIMER_N         1
+#define DMA_SAMPLER_TIMER_BASE      timerBase(DMA_SAMPLER_TIMER_N)
+#define DMA_SAMPLER_TIMER           timer(DMA_SAMPLER_TIMER_N)
+#define DMA_SAMPLER_TIMER_CLKEN     timerCLKEN(DMA_SAMPLER_TIMER_N)
+#define DMA_SAMPLER_DMA0            DMA2_Stream5 // TIM1_UP
+#define DMA_SAMPLER_DMA0_CHANNEL    DMA_CHANNEL_6
+#define DMA_SAMPLER_DMA1            DMA2_Stream6 // TIM1_CH3
+#define DMA_SAMPLER_DMA1_CHANNEL    DMA_CHANNEL_6
+#define DMA_SAMPLER_DMA_IRQn        DMA2_Stream5_IRQn
+#define DMA_SAMPLER_DMA_IRQHandler  DMA2_Stream5_IRQHandler
+#define DMA_SAMPLER_DMA_IFCR        DMA2->HIFCR
+#define DMA_SAMPLER_DMA_IFLAGS      (DMA_HIFCR_CTCIF5|DMA_HIFCR_CHTIF5|DMA_HIFCR_CTEIF5|DMA_HIFCR_CDMEIF5|DMA_HIFCR_CFEIF5|\
+                                     DMA_HIFCR_CTCIF6|DMA_HIFCR_CHTIF6|DMA_HIFCR_CTEIF6|DMA_HIFCR_CDMEIF6|DMA_HIFCR_CFEIF6)
+#define IS_DMA_SAMPLER_TIMER(INSTANCE) ((INSTANCE) == DMA_SAMPLER_TIMER_BASE)
+
+#else
+#define IS_DMA_SAMPLER_TIMER(INSTANCE) 0
+#endif
+
+// USART/UART peripheral number from a SERIAL_PORT .. SERIAL7_PORT value, for use in #if expressions.
+#define SERIAL_USART(p) ((p) >= 10 ? (p) / 10 : (p))
+#define SERIAL_USES_USART(n) (SERIAL_USART(SERIAL_PORT) == (n) || SERIAL_USART(SERIAL1_PORT) == (n) || SERIAL_USART(SERIAL2_PORT) == (n) || \
+                              SERIAL_USART(SERIAL3_PORT) == (n) || SERIAL_USART(SERIAL4_PORT) == (n) || SERIAL_USART(SERIAL5_PORT) == (n) || \
+                              SERIAL_USART(SERIAL6_PORT) == (n) || SERIAL_USART(SERIAL7_PORT) == (n))
+
+#if STEP_DMA_ENABLE
+#define IS_TIMER_CLAIMED(INSTANCE) ((INSTANCE) == STEPPER_TIMER_BASE || (INSTANCE) == STEP_PULSE_TIMER_BASE || IS_DEBOUNCE_TIMER(INSTANCE) || IS_DMA_SAMPLER_TIMER(INSTANCE))
+#else
+#define IS_TIMER_CLAIMED(INSTANCE) ((INSTANCE) == STEPPER_TIMER_BASE || IS_DEBOUNCE_TIMER(INSTANCE) || IS_DMA_SAMPLER_TIMER(INSTANCE))
+#endif
 
 // Adjust these values to get more accurate step pulse timings when required, e.g if using high step rates.
 // The default values below are calibrated for 5 microsecond pulses on a F756 @ 180 MHz.
@@ -230,6 +517,10 @@
 
 #include "grbl/driver_opts2.h"
 
+#if STEP_OPM_ENABLE && STEP_INJECT_ENABLE
+#error "STEP_OPM_ENABLE cannot be used with step injection (stepper spindle or plasma THC)!"
+#endif
+
 #ifndef I2C_PORT
 #define I2C_PORT 2 // GPIOB, SCL_PIN = 10, SDA_PIN = 11
 #endif
@@ -301,12 +592,20 @@ typedef struct {
     } pins;
 } pin_group_pins_t;
 
+#include "isr_profile.h"
+#include "step_trace.h"
+#include "probe_latch.h"
+#include "input_events.h"
+#include "trip_latency.h"
+#include "dma_sampler.h"
+
 bool driver_init (void);
 void Driver_IncTick (void);
 void gpio_irq_enable (const input_signal_t *input, pin_irq_mode_t irq_mode);
 void ioports_init(pin_group_pins_t *aux_inputs, pin_group_pins_t *aux_outputs);
 void ioports_init_analog (pin_group_pins_t *aux_inputs, pin_group_pins_t *aux_outputs);
 void ioports_event (input_signal_t *input);
+int32_t ioports_wait_response_us (uint8_t *port);
 const pwm_signal_t *get_pwm_timer (GPIO_TypeDef *port, uint8_t pin);
 
 #endif // __DRIVER_H__
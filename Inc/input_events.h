@@ -0,0 +1,57 @@
+/*
+
+  input_events.h - interrupt to foreground input event rings for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if INPUT_EVENTS_ENABLE
+
+#ifndef INPUT_EVENTS_RING_SIZE
+#define INPUT_EVENTS_RING_SIZE 32 // must be a power of 2
+#endif
+
+#if INPUT_EVENTS_RING_SIZE & (INPUT_EVENTS_RING_SIZE - 1)
+#error "INPUT_EVENTS_RING_SIZE must be a power of 2!"
+#endif
+
+typedef struct {
+    uint32_t timestamp;     // DWT cycle counter when the event was posted
+    input_signal_t *input;
+    bool state;             // input level when the event was posted
+} input_event_t;
+
+typedef void (*input_event_handler_ptr)(input_event_t *event);
+
+// Events that are not safety critical, these are posted to the rings from interrupt context
+// and processed in the foreground. Limit, e-stop, reset, door, probe and motor fault inputs are still handled synchronously.
+static inline bool input_event_deferred (input_signal_t *input)
+{
+    return (input->id >= Input_Aux0 && input->id <= Input_AuxMax) ||
+            input->id == Input_I2CStrobe ||
+             input->id == Input_MPGSelect ||
+              input->id == Input_SdCardDetect;
+}
+
+bool input_event_post (input_signal_t *input, bool state);
+const input_event_t *input_event_current (void);
+void input_events_init (input_event_handler_ptr handler);
+
+#endif // INPUT_EVENTS_ENABLE
@@ -0,0 +1,88 @@
+/*
+
+  isr_profile.h - interrupt handler profiling for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if ISR_PROFILE_ENABLE
+
+#define ISR_PROFILE_BINS 16 // log2 histogram, bin n counts 2^n to 2^(n+1) - 1 cycles, last bin is open ended
+
+typedef enum {
+    ISR_Stepper = 0,
+    ISR_EXTI0,
+    ISR_EXTI1,
+    ISR_EXTI2,
+    ISR_EXTI3,
+    ISR_EXTI4,
+    ISR_EXTI9_5,
+    ISR_EXTI15_10,
+    ISR_Serial0,
+    ISR_Serial1,
+    ISR_Serial2,
+    ISR_Serial3,
+    ISR_Serial4,
+    ISR_Serial5,
+    ISR_Serial6,
+    ISR_Serial7,
+    ISR_USB,
+    ISR_Timer,
+    ISR_EthInput,
+    ISR_Debounce,
+    ISR_NumHandlers
+} isr_id_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[ISR_PROFILE_BINS];
+} isr_profile_t;
+
+extern isr_profile_t isr_profile[ISR_NumHandlers];
+
+// NOTE: cycle counts includes time spent in higher priority handlers preempting the profiled one.
+static inline __attribute__((always_inline)) void isr_profile_add (isr_id_t id, uint32_t cycles)
+{
+    isr_profile_t *profile = &isr_profile[id];
+    uint_fast8_t bin = 31 - __CLZ(cycles | 1);
+
+    profile->count++;
+    profile->total += cycles;
+    if(cycles < profile->min)
+        profile->min = cycles;
+    if(cycles > profile->max)
+        profile->max = cycles;
+    profile->hist[bin >= ISR_PROFILE_BINS ? ISR_PROFILE_BINS - 1 : bin]++;
+}
+
+void isr_profile_init (void);
+
+#define ISR_PROFILE_ENTER() uint32_t isr_profile_t0 = DWT->CYCCNT
+#define ISR_PROFILE_EXIT(id) isr_profile_add(id, DWT->CYCCNT - isr_profile_t0)
+
+#else
+
+#define ISR_PROFILE_ENTER()
+#define ISR_PROFILE_EXIT(id)
+
+#endif // ISR_PROFILE_ENABLE
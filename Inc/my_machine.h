@@ -89,6 +89,25 @@
 //#define ESP_AT_ENABLE           1 // Enable support for Telnet communication via UART connected ESP32 running ESP-AT.
 //#define FEED_OVERRIDE_ENABLE    1 // Enable M200 feed override control.
 //#define HOMING_PULLOFF_ENABLE   1 // Enable per axis homing pulloff distance settings.
+//#define STEP_DMA_ENABLE         1 // Output step pulses via timer triggered DMA, step pins must be on the same port. Claims TIM8 and DMA2 streams 4 and 7.
+//#define STEP_OPM_ENABLE         1 // Output step pulses from timers in one-pulse mode, step pins must be timer capable. Timers used are claimed.
+//#define DEBOUNCE_TIMER_ENABLE   1 // Debounce inputs by sampling them from a timer interrupt, stable levels are accepted within DEBOUNCE_INPUT_US. Claims TIM7.
+//#define PROBE_LATCH_ENABLE      1 // Latch the step position in the probe pin interrupt, output by the $PRL command. Set to 2 to use it as the probe result.
+//#define INPUT_EVENTS_ENABLE     1 // Process non safety critical input events in the foreground via timestamped event rings, output by the $IEV command.
+//#define DMA_SAMPLER_ENABLE      1 // Sample aux inputs without an EXTI line by timer triggered DMA, output by the $DSS command. Claims TIM1 and DMA2 streams 5 and 6.
+//#define FREQ_METER_ENABLE       1 // Measure frequency, period or duty cycle on analog aux inputs mapped to timer capable pins without ADC function.
+//#define INPUT_GATHER_ENABLE     1 // Read limit and control inputs with one IDR read per GPIO port.
+//#define STEP_TRACE_ENABLE       1 // Capture step and direction output timing with the DWT cycle counter, output by the $STT command.
+//#define STEP_LOOPBACK_ENABLE    1 // Count emitted step pulses with timers via jumpers to <axis>_STEP_LOOPBACK_PIN inputs and report mismatches.
+//#define STEP_PORTMAP_ENABLE     1 // Output step and direction signals with one write per GPIO port via lookup tables.
+//#define L1_CACHE_ENABLE         1 // Enable the instruction and data caches, DMA buffers are mapped non-cacheable by the MPU.
+//#define SERIAL_RX_DMA_ENABLE    1 // Receive on the UARTs via circular DMA with idle line detection, output by the $SRX command.
+//#define SERIAL_TX_DMA_ENABLE    1 // Transmit on the UARTs via DMA in contiguous chunks, output by the $STX command. Ports fall back to interrupts when their stream is in use.
+//#define MODBUS_HW_FRAMING_ENABLE 1 // Modbus RTU framing by the receiver timeout with the transceiver switched by the UART driver enable output, see serial.h.
+//#define STREAM_SPAN_ENABLE      1 // Bulk read UART and USB CDC input buffers as contiguous spans, benchmarked by the $RSB command.
+//#define STREAM_BENCH_ENABLE     1 // Measure input stream throughput from a host in sink, echo or timestamp mode, run by the $SBM command.
+//#define TRIP_LATENCY_ENABLE     1 // Measure limit and e-stop to motion stop latency with the DWT cycle counter, output by the $LAT command.
+//#define ISR_PROFILE_ENABLE      1 // Profile interrupt handler execution times with the DWT cycle counter, output by the $ISR command.
 
 // IO expanders:
 //#define MCP3221_ENABLE          1 // MCP3221 I2C 12 bit ADC input, default address is 0x9A (MCP3221_ADDRESS).
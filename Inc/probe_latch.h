@@ -0,0 +1,68 @@
+/*
+
+  probe_latch.h - probe position capture from the probe pin interrupt for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if PROBE_LATCH_ENABLE
+
+#include "grbl/system.h"
+
+typedef struct {
+    volatile uint32_t armed;    // EXTI line of the selected probe input when armed for capture
+    volatile bool triggered;
+    input_signal_t *input;      // probe input that triggered the capture
+    uint32_t t_entry;           // DWT cycle counter at EXTI handler entry
+    uint32_t t_latch;           // DWT cycle counter at position snapshot
+    int32_t position[N_AXIS];   // step position at snapshot
+} probe_latch_t;
+
+extern probe_latch_t probe_latch;
+
+// Called from the EXTI handlers before dispatching the input, latches the step position on the first edge after arming.
+// The stepper interrupt has the same priority as the EXTI handlers so sys.position cannot be updated while copied.
+static inline __attribute__((always_inline)) void probe_latch_event (input_signal_t *input, uint32_t t_entry)
+{
+    if(probe_latch.armed & input->bit) {
+        uint_fast8_t idx = N_AXIS;
+        do {
+            idx--;
+            probe_latch.position[idx] = sys.position[idx];
+        } while(idx);
+        probe_latch.t_latch = DWT->CYCCNT;
+        probe_latch.input = input;
+        probe_latch.t_entry = t_entry;
+        probe_latch.armed = 0;
+        probe_latch.triggered = true;
+    }
+}
+
+void probe_latch_add (probe_id_t probe_id, input_signal_t *input);
+
+#define PROBE_LATCH_ENTRY() uint32_t probe_latch_t0 = DWT->CYCCNT
+#define PROBE_LATCH_EVENT(input) probe_latch_event(input, probe_latch_t0)
+
+#else
+
+#define PROBE_LATCH_ENTRY()
+#define PROBE_LATCH_EVENT(input)
+
+#endif // PROBE_LATCH_ENABLE
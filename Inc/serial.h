@@ -30,8 +30,27 @@
 3  - GPIOB: TX = 10, RX = 11 - Nucleo-144: cannot be used with ethernet enabled
 31 - GPIOC: TX = 10, RX = 11 - Nucleo-144: cannot be used with SDIO enabled
 32 - GPIOD: TX =  8, RX =  9 - Nucleo-144: virtual COM port
+4  - GPIOA: TX =  0, RX =  1 - UART4
+41 - GPIOC: TX = 10, RX = 11 - UART4
+5  - GPIOC: TX = 12, GPIOD: RX = 2 - UART5
 6  - GPIOC: TX =  6, RX =  7
 61 - GPIOG: TX = 14, RX =  9
+7  - GPIOF: TX =  7, RX =  6 - UART7, not available on 100 pin packages
+71 - GPIOE: TX =  8, RX =  7 - UART7
+8  - GPIOE: TX =  1, RX =  0 - UART8
+
+Up to eight ports can be assigned, SERIAL_PORT to SERIAL7_PORT, each to a different peripheral.
+
+Baud rates up to 1/8 of the peripheral clock are supported, 13.5 Mbaud for USART1 and USART6 and 6.75 Mbaud for the others.
+Receive via DMA, SERIAL_RX_DMA_ENABLE, is recommended for rates above 1 Mbaud.
+
+RTS/CTS flow control for the first three ports is enabled by adding SERIAL_RTS_PORT/SERIAL_RTS_PIN and SERIAL_CTS_PORT/SERIAL_CTS_PIN,
+SERIAL1_ and SERIAL2_ prefixed for the next ports, to the board map. RTS can be any GPIO pin, CTS must be mapped to the peripheral:
+e.g. USART1 PA11, USART2 PA0 or PD3, USART3 PB13 or PD11, UART4 PB0, UART5 PC9, USART6 PG13 or PG15, UART7 PE10 or PF9, UART8 PD14.
+
+With MODBUS_HW_FRAMING_ENABLE the MODBUS_RTU_STREAM port drives the RS485 transceiver from the peripheral driver enable output,
+declared by RS485_DE_PORT/RS485_DE_PIN in the board map instead of RS485_DIR_PORT/RS485_DIR_PIN. This is the RTS pin of the peripheral:
+e.g. USART1 PA12, USART2 PA1 or PD4, USART3 PB14 or PD12, UART4 PA15, UART5 PC8, USART6 PG8 or PG12, UART7 PE9 or PF8, UART8 PD15.
 
 */
 
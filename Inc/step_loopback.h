@@ -0,0 +1,33 @@
+/*
+
+  step_loopback.h - step pulse loopback verification for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if STEP_LOOPBACK_ENABLE
+
+bool step_loopback_init (void);
+void step_loopback_attach (settings_t *settings);
+void step_loopback_injected (axes_signals_t step_out);
+
+axes_signals_t stepper_loopback_axes (void); // in driver.c
+
+#endif
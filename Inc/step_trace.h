@@ -0,0 +1,73 @@
+/*
+
+  step_trace.h - step and direction output timing trace for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if STEP_TRACE_ENABLE
+
+#ifndef STEP_TRACE_SIZE
+#define STEP_TRACE_SIZE 256
+#endif
+
+typedef enum {
+    StepTrace_Dir = 0,
+    StepTrace_Step
+} step_trace_type_t;
+
+typedef struct {
+    uint32_t cycles;    // DWT cycle counter at output write
+    uint32_t period;    // stepper timer reload value, timer ticks
+    uint8_t type;       // step_trace_type_t
+    uint8_t bits;       // axis bits written, step off when 0 for step events
+} step_trace_event_t;
+
+typedef struct {
+    volatile uint32_t n;
+    bool pulse_hw;      // step pulse end is timed by DMA or timer output compare and not traced
+    step_trace_event_t event[STEP_TRACE_SIZE];
+} step_trace_t;
+
+extern step_trace_t step_trace;
+
+// Records until the buffer is full, $STT=R rearms the capture.
+static inline __attribute__((always_inline)) void step_trace_add (step_trace_type_t type, uint8_t bits)
+{
+    uint32_t n = step_trace.n;
+
+    if(n < STEP_TRACE_SIZE) {
+        step_trace.event[n].cycles = DWT->CYCCNT;
+        step_trace.event[n].period = STEPPER_TIMER->ARR;
+        step_trace.event[n].type = type;
+        step_trace.event[n].bits = bits;
+        step_trace.n = n + 1;
+    }
+}
+
+void step_trace_init (void);
+
+#define STEP_TRACE(type, bits) step_trace_add(type, bits)
+
+#else
+
+#define STEP_TRACE(type, bits)
+
+#endif // STEP_TRACE_ENABLE
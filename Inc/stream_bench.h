@@ -0,0 +1,51 @@
+/*
+
+  stream_bench.h - stream throughput and latency benchmark for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+The $SBM command switches the current input stream to a benchmark mode, a host tool may then push synthetic G-code at full speed
+over any stream the controller offers: UART, USB CDC or a network stream. Input is not parsed, only received and split into lines.
+
+$SBM=S - sink: lines are counted and discarded.
+$SBM=E - echo: each line is sent back as received, for round trip throughput measurements.
+$SBM=T - timestamp: each line is acknowledged by [SBT:<line>|<us>], the time of the line end relative to the first character.
+
+Input must be sent after the [SBM:ready|<mode>] message, the benchmark ends when no input is received for 2 seconds, or on a line
+containing a single %. Realtime commands are processed as usual while the benchmark runs, the round trip latency of a ? status
+report request can thus be measured by the host under load. The final report is:
+
+[SBM:<lines>|bytes:<n>|ms:<n>|bps:<n>|lps:<n>|peak:<n>|ovf:<n>]
+
+peak is the highest input buffer fill level seen and ovf the number of input buffer overflows detected, the latter is only reported
+for streams supporting span reads, see stream_span.h.
+
+tools/stream_bench is a Linux host tool for running the benchmark over a serial device or Telnet.
+
+*/
+
+#pragma once
+
+#if STREAM_BENCH_ENABLE
+
+void stream_bench_init (void);
+
+#endif // STREAM_BENCH_ENABLE
@@ -0,0 +1,63 @@
+/*
+
+  stream_harness.h - shared run loop for the input stream benchmarks for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+Used by the $RSB and $SBM commands. The harness repeatedly calls the benchmark poll function until it reports completion,
+no input has been processed for STREAM_HARNESS_TIMEOUT_MS or the controller is reset. Realtime commands are serviced once per
+millisecond while running so the host can measure status report latency under load.
+
+Times are in CPU cycles, accumulated per poll so the DWT cycle counter may wrap during a run.
+
+*/
+
+#pragma once
+
+#if STREAM_SPAN_ENABLE || STREAM_BENCH_ENABLE
+
+#include <stdint.h>
+
+#define STREAM_HARNESS_TIMEOUT_MS 2000 // run ends when no input is processed within this time
+
+typedef enum {
+    StreamHarness_Idle = 0, // no input processed
+    StreamHarness_Data,     // input processed, restarts the idle timeout
+    StreamHarness_Done      // input processed, benchmark complete
+} stream_harness_status_t;
+
+typedef struct stream_harness stream_harness_t;
+
+typedef stream_harness_status_t (*stream_harness_poll_ptr)(stream_harness_t *harness);
+
+struct stream_harness {
+    stream_harness_poll_ptr poll;
+    void *context;      // benchmark data, for use by the poll function
+    uint32_t t_now;     // DWT cycle counter at the start of the current poll
+    uint64_t elapsed;   // CPU cycles since the first input was processed, 0 until then
+    uint64_t total;     // CPU cycles from the first to the last input processed
+};
+
+void stream_harness_run (stream_harness_t *harness);
+uint32_t stream_harness_ms (const stream_harness_t *harness);
+uint32_t stream_harness_rate (const stream_harness_t *harness, uint32_t count);
+
+#endif // STREAM_SPAN_ENABLE || STREAM_BENCH_ENABLE
@@ -0,0 +1,83 @@
+/*
+
+  stream_span.h - bulk read access to stream input buffers for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if STREAM_SPAN_ENABLE
+
+#include "grbl/stream.h"
+
+#ifndef STREAM_SPAN_SOURCES
+#define STREAM_SPAN_SOURCES 10
+#endif
+
+typedef void (*stream_rx_released_ptr)(void);
+
+typedef struct {
+    const uint8_t *data;
+    uint_fast16_t length;
+} stream_span_t;
+
+typedef struct {
+    stream_read_ptr read;               // io_stream_t read function identifying the stream
+    stream_rx_buffer_t *rxbuf;
+    stream_rx_released_ptr released;    // optional, called when characters are consumed, e.g. for flow control
+} stream_span_source_t;
+
+// Returns the number of non-empty spans, 0 to 2. The readable region of the buffer is split in two when it wraps.
+// Single consumer only, the spans stay valid until consumed as the producer only ever writes ahead of the head.
+static inline uint_fast8_t stream_rx_span (const stream_span_source_t *source, stream_span_t span[2])
+{
+    stream_rx_buffer_t *rxbuf = source->rxbuf;
+    uint_fast16_t tail = rxbuf->tail, head = rxbuf->head;
+
+    if(head == tail)
+        return 0;
+
+    span[0].data = &rxbuf->data[tail];
+
+    if(head > tail) {
+        span[0].length = head - tail;
+        return 1;
+    }
+
+    span[0].length = sizeof(rxbuf->data) - tail;
+    span[1].data = rxbuf->data;
+
+    return (span[1].length = head) ? 2 : 1;
+}
+
+// Releases n characters from the tail of the buffer, n must not exceed the combined span length.
+static inline void stream_rx_consume (const stream_span_source_t *source, uint_fast16_t n)
+{
+    source->rxbuf->tail = (source->rxbuf->tail + n) & (sizeof(source->rxbuf->data) - 1);
+
+    if(source->released)
+        source->released();
+}
+
+// Input buffers are looked up by the read function of the stream as io_stream_t has no buffer access.
+void stream_span_register (stream_read_ptr read, stream_rx_buffer_t *rxbuf, stream_rx_released_ptr released);
+const stream_span_source_t *stream_span_get (const io_stream_t *stream);
+void stream_span_init (void);
+
+#endif // STREAM_SPAN_ENABLE
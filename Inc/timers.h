@@ -24,7 +24,19 @@
 
 /* Internal API */
 
+// Timer input pins that can clock a timer for pulse counting.
+typedef struct {
+    uint8_t pin;
+    uint8_t af;
+    bool ecm; // external clock mode 1 via TI1, else external clock mode 2 via ETR
+    GPIO_TypeDef *port;
+    TIM_TypeDef *timer;
+} stm32_pcnt_hw_t;
+
+const stm32_pcnt_hw_t *pcnt_claim (GPIO_TypeDef *port, uint8_t pin, hal_timer_t *timer);
+
 hal_timer_t timer_claim (TIM_TypeDef *timer);
+void timer_release (TIM_TypeDef *timer);
 bool timer_is_claimed (TIM_TypeDef *timer);
 uint32_t timer_clk_enable (TIM_TypeDef *timer);
 uint32_t timer_get_clock_hz (TIM_TypeDef *timer);
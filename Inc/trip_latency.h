@@ -0,0 +1,79 @@
+/*
+
+  trip_latency.h - limit and e-stop to motion stop latency measurement for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#if TRIP_LATENCY_ENABLE
+
+#include "grbl/hal.h"
+
+#define TRIP_LATENCY_BINS 24 // log2 histogram, bin n counts 2^n to 2^(n+1) - 1 cycles, last bin is open ended
+
+#ifndef TRIP_LATENCY_TIMEOUT_MS
+#define TRIP_LATENCY_TIMEOUT_MS 100 // trips not followed by stepperGoIdle() within this time are discarded
+#endif
+
+typedef struct {
+    volatile bool armed;
+    uint32_t t0;            // DWT cycle counter at trip
+    uint32_t ms0;           // elapsed ms at trip, the cycle counter wraps in less than 20 seconds
+    uint32_t count;
+    uint32_t discarded;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+    uint32_t hist[TRIP_LATENCY_BINS];
+} trip_latency_t;
+
+extern trip_latency_t trip_latency;
+
+void trip_latency_add (uint32_t cycles, uint32_t ms);
+void trip_latency_init (void);
+
+// Called from the limit and e-stop interrupt handlers, the first trip is kept until motion is stopped.
+static inline __attribute__((always_inline)) void trip_latency_start (void)
+{
+    if(!trip_latency.armed) {
+        trip_latency.t0 = DWT->CYCCNT;
+        trip_latency.ms0 = hal.get_elapsed_ticks();
+        trip_latency.armed = true;
+    }
+}
+
+// Called from stepperGoIdle() when the step interrupt is disabled and outputs cleared.
+static inline __attribute__((always_inline)) void trip_latency_stop (void)
+{
+    if(trip_latency.armed) {
+        trip_latency.armed = false;
+        trip_latency_add(DWT->CYCCNT - trip_latency.t0, hal.get_elapsed_ticks() - trip_latency.ms0);
+    }
+}
+
+#define TRIP_LATENCY_START() trip_latency_start()
+#define TRIP_LATENCY_STOP() trip_latency_stop()
+
+#else
+
+#define TRIP_LATENCY_START()
+#define TRIP_LATENCY_STOP()
+
+#endif // TRIP_LATENCY_ENABLE
@@ -29,6 +29,7 @@
 #include "lwip/ethip6.h"
 #include "ethernetif.h"
 #include "lan8742.h"
+#include "cache.h"
 #include <string.h>
 
 /* Within 'USER CODE' section, code will be kept by default at each generation */
@@ -288,6 +289,8 @@ static err_t low_level_output(struct netif *netif, struct pbuf *p)
     Txbuffer[i].buffer = q->payload;
     Txbuffer[i].len = q->len;
 
+    cache_clean(q->payload, q->len);
+
     if(i>0)
     {
       Txbuffer[i-1].next = &Txbuffer[i];
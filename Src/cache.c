@@ -0,0 +1,66 @@
+/*
+
+  cache.c - L1 cache and MPU configuration for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+#include "cache.h"
+
+extern uint8_t _sdmaram, _edmaram;
+
+// Map the .dmaram section non-cacheable and enable the L1 caches.
+// Must be called before any peripheral is initialized.
+void cache_init (void)
+{
+#if L1_CACHE_ENABLE
+
+    uint32_t size = (uint32_t)&_edmaram - (uint32_t)&_sdmaram;
+
+    if(size && L1_CACHE_ENABLE != 2) { // L1_CACHE_ENABLE 2 leaves DMA buffers cacheable, for benchmarking only.
+
+        uint8_t region_size = MPU_REGION_SIZE_32B; // Region size is 2^(region_size + 1) bytes
+
+        while((1UL << (region_size + 1)) < size)
+            region_size++;
+
+        MPU_Region_InitTypeDef dma_region = {
+            .Enable = MPU_REGION_ENABLE,
+            .Number = MPU_REGION_NUMBER0,
+            .BaseAddress = (uint32_t)&_sdmaram,
+            .Size = region_size,
+            .SubRegionDisable = 0,
+            .TypeExtField = MPU_TEX_LEVEL1,
+            .AccessPermission = MPU_REGION_FULL_ACCESS,
+            .DisableExec = MPU_INSTRUCTION_ACCESS_DISABLE,
+            .IsShareable = MPU_ACCESS_SHAREABLE,
+            .IsCacheable = MPU_ACCESS_NOT_CACHEABLE,
+            .IsBufferable = MPU_ACCESS_NOT_BUFFERABLE
+        };
+
+        HAL_MPU_Disable();
+        HAL_MPU_ConfigRegion(&dma_region);
+        HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+    }
+
+    SCB_EnableICache();
+    SCB_EnableDCache();
+
+#endif
+}
@@ -0,0 +1,283 @@
+/*
+
+  dma_sampler.c - timer triggered DMA sampling of aux input ports for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if DMA_SAMPLER_ENABLE
+
+#include "grbl/hal.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+// Aux inputs that could not be assigned an EXTI line are sampled by DMA transfers from the port IDR registers,
+// triggered by DMA_SAMPLER_TIMER. Port 0 is read on update events, port 1 on channel 3 compare events.
+// Consecutive samples are compared from the half and full transfer interrupts of the port 0 stream and
+// edges are passed to ioports_event() the same way as for EXTI lines.
+
+typedef struct {
+    GPIO_TypeDef *port;
+    DMA_Stream_TypeDef *stream;
+    uint32_t channel;
+    uint16_t mask;
+    uint16_t rise;          // pins reporting rising edges, set from the mode passed to gpio_irq_enable()
+    uint16_t fall;          // pins reporting falling edges
+    uint16_t prev;
+    uint_fast16_t tail;
+    uint16_t *samples;
+    input_signal_t *input[16];
+    uint32_t edges[16];
+} sampler_port_t;
+
+DMA_DATA static uint16_t samples[DMA_SAMPLER_MAX_PORTS][DMA_SAMPLER_BUFFER_SIZE];
+
+static struct {
+    bool enabled;
+    uint_fast8_t n_ports;
+    uint32_t rate;
+    sampler_port_t port[DMA_SAMPLER_MAX_PORTS];
+} sampler = {};
+
+static const struct {
+    DMA_Stream_TypeDef *stream;
+    uint32_t channel;
+} sampler_dma[] = {
+    { .stream = DMA_SAMPLER_DMA0, .channel = DMA_SAMPLER_DMA0_CHANNEL },
+    { .stream = DMA_SAMPLER_DMA1, .channel = DMA_SAMPLER_DMA1_CHANNEL }
+};
+
+// All edges are counted, only edges matching the interrupt mode of the input are passed on.
+static void sampler_edges (sampler_port_t *port, uint32_t diff, uint32_t sample)
+{
+    uint32_t bit, pin, post = (diff & sample & port->rise) | (diff & ~sample & port->fall);
+
+    while(diff) {
+
+        bit = diff & -diff; // isolate the lowest set bit
+        diff &= ~bit;
+        pin = __builtin_ctz(bit);
+
+        port->edges[pin]++;
+
+        if(post & bit)
+            ioports_event(port->input[pin]);
+    }
+}
+
+// Compares samples from the last processed up to the current DMA write position.
+static inline void sampler_process (sampler_port_t *port)
+{
+    uint_fast16_t head = DMA_SAMPLER_BUFFER_SIZE - port->stream->NDTR, tail = port->tail;
+    uint16_t sample, prev = port->prev, diff;
+
+    if(head == DMA_SAMPLER_BUFFER_SIZE)
+        head = 0;
+
+    while(tail != head) {
+        sample = port->samples[tail];
+        if((diff = (sample ^ prev) & port->mask))
+            sampler_edges(port, diff, sample);
+        prev = sample;
+        tail = (tail + 1) & (DMA_SAMPLER_BUFFER_SIZE - 1);
+    }
+
+    port->tail = tail;
+    port->prev = prev;
+}
+
+ISR_CODE void DMA_SAMPLER_DMA_IRQHandler (void)
+{
+    uint_fast8_t idx;
+
+    DMA_SAMPLER_DMA_IFCR = DMA_SAMPLER_DMA_IFLAGS;
+
+    for(idx = 0; idx < sampler.n_ports; idx++)
+        sampler_process(&sampler.port[idx]);
+}
+
+// Assigns an input to the sampler, at most DMA_SAMPLER_MAX_PORTS ports can be sampled.
+bool dma_sampler_add (input_signal_t *input)
+{
+    uint_fast8_t idx;
+    sampler_port_t *port = NULL;
+
+    for(idx = 0; idx < sampler.n_ports; idx++) {
+        if(sampler.port[idx].port == input->port)
+            port = &sampler.port[idx];
+    }
+
+    if(port == NULL && sampler.n_ports < DMA_SAMPLER_MAX_PORTS) {
+        port = &sampler.port[sampler.n_ports];
+        port->port = input->port;
+        port->stream = sampler_dma[sampler.n_ports].stream;
+        port->channel = sampler_dma[sampler.n_ports].channel;
+        port->samples = samples[sampler.n_ports++];
+    }
+
+    if(port) {
+        port->mask |= 1 << input->pin;
+        port->input[input->pin] = input;
+    }
+
+    return port != NULL;
+}
+
+static sampler_port_t *sampler_port_get (const input_signal_t *input)
+{
+    uint_fast8_t idx = sampler.n_ports;
+
+    if(idx) do {
+        idx--;
+        if(sampler.port[idx].port == input->port && (sampler.port[idx].mask & (1 << input->pin)))
+            return &sampler.port[idx];
+    } while(idx);
+
+    return NULL;
+}
+
+bool dma_sampler_owns (const input_signal_t *input)
+{
+    return sampler_port_get(input) != NULL;
+}
+
+// Called from gpio_irq_enable(), selects the edges reported for a sampled input as the EXTI trigger registers
+// do for other inputs. Returns false if the input is not sampled.
+bool dma_sampler_irq_enable (const input_signal_t *input, pin_irq_mode_t irq_mode)
+{
+    sampler_port_t *port;
+
+    if((port = sampler_port_get(input))) {
+
+        uint16_t bit = 1 << input->pin;
+
+        if(irq_mode == IRQ_Mode_Rising || irq_mode == IRQ_Mode_Change)
+            port->rise |= bit;
+        else
+            port->rise &= ~bit;
+
+        if(irq_mode == IRQ_Mode_Falling || irq_mode == IRQ_Mode_Change)
+            port->fall |= bit;
+        else
+            port->fall &= ~bit;
+    }
+
+    return port != NULL;
+}
+
+uint32_t dma_sampler_get_edges (const input_signal_t *input)
+{
+    sampler_port_t *port = sampler_port_get(input);
+
+    return port ? port->edges[input->pin] : 0;
+}
+
+// $DSS - report sample rate and edge counts for sampled inputs.
+static status_code_t dma_sampler_report (sys_state_t state, char *args)
+{
+    uint_fast8_t idx, pin;
+
+    hal.stream.write("[DSS:");
+    hal.stream.write(uitoa(sampler.rate));
+    hal.stream.write("Hz|ports:");
+    hal.stream.write(uitoa(sampler.n_ports));
+    hal.stream.write("]" ASCII_EOL);
+
+    for(idx = 0; idx < sampler.n_ports; idx++) {
+        for(pin = 0; pin < 16; pin++) {
+            if(sampler.port[idx].mask & (1 << pin)) {
+                hal.stream.write("[DSS:AUX");
+                hal.stream.write(uitoa(sampler.port[idx].input[pin]->user_port));
+                hal.stream.write("|edges:");
+                hal.stream.write(uitoa(sampler.port[idx].edges[pin]));
+                hal.stream.write("]" ASCII_EOL);
+            }
+        }
+    }
+
+    return Status_OK;
+}
+
+// Starts sampling of the assigned ports, called once after all inputs has been assigned.
+bool dma_sampler_init (void)
+{
+    static const sys_command_t dma_sampler_command_list[] = {
+        {"DSS", dma_sampler_report, { .allow_blocking = On, .noargs = On }, { .str = "output DMA sampled input edge counts" } }
+    };
+
+    static sys_commands_t dma_sampler_commands = {
+        .n_commands = sizeof(dma_sampler_command_list) / sizeof(sys_command_t),
+        .commands = dma_sampler_command_list
+    };
+
+    uint_fast8_t idx;
+    uint32_t f_timer = HAL_RCC_GetPCLK2Freq() * 2, psc, period;
+
+    if(sampler.n_ports == 0)
+        return false;
+
+    psc = (f_timer / DMA_SAMPLER_RATE) / 65536;
+    period = f_timer / ((psc + 1) * DMA_SAMPLER_RATE);
+    sampler.rate = f_timer / ((psc + 1) * period);
+
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    for(idx = 0; idx < sampler.n_ports; idx++) {
+
+        sampler_port_t *port = &sampler.port[idx];
+
+        port->stream->CR = 0;
+        while(port->stream->CR & DMA_SxCR_EN);
+
+        port->prev = (uint16_t)port->port->IDR;
+        port->tail = 0;
+        port->stream->PAR = (uint32_t)&port->port->IDR;
+        port->stream->M0AR = (uint32_t)port->samples;
+        port->stream->NDTR = DMA_SAMPLER_BUFFER_SIZE;
+        port->stream->FCR = 0; // Direct mode
+        port->stream->CR = port->channel|DMA_SxCR_PL_1|DMA_SxCR_MSIZE_0|DMA_SxCR_PSIZE_0|DMA_SxCR_MINC|DMA_SxCR_CIRC|
+                            (idx == 0 ? DMA_SxCR_HTIE|DMA_SxCR_TCIE : 0);
+    }
+
+    DMA_SAMPLER_DMA_IFCR = DMA_SAMPLER_DMA_IFLAGS;
+
+    for(idx = 0; idx < sampler.n_ports; idx++)
+        sampler.port[idx].stream->CR |= DMA_SxCR_EN;
+
+    DMA_SAMPLER_TIMER_CLKEN();
+    DMA_SAMPLER_TIMER->CR1 = 0;
+    DMA_SAMPLER_TIMER->PSC = psc;
+    DMA_SAMPLER_TIMER->ARR = period - 1;
+    DMA_SAMPLER_TIMER->CCR3 = 0;
+    DMA_SAMPLER_TIMER->EGR = TIM_EGR_UG;
+    DMA_SAMPLER_TIMER->SR = 0;
+    DMA_SAMPLER_TIMER->DIER = TIM_DIER_UDE|(sampler.n_ports > 1 ? TIM_DIER_CC3DE : 0);
+
+    HAL_NVIC_SetPriority(DMA_SAMPLER_DMA_IRQn, 1, 0);
+    NVIC_EnableIRQ(DMA_SAMPLER_DMA_IRQn);
+
+    DMA_SAMPLER_TIMER->CR1 = TIM_CR1_ARPE|TIM_CR1_CEN;
+
+    system_register_commands(&dma_sampler_commands);
+
+    return (sampler.enabled = true);
+}
+
+#endif // DMA_SAMPLER_ENABLE
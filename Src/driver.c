@@ -30,6 +30,9 @@
 #include "driver.h"
 #include "serial.h"
 #include "encoders.h"
+#include "step_loopback.h"
+#include "stream_span.h"
+#include "stream_bench.h"
 
 #include "grbl/task.h"
 #include "grbl/motor_pins.h"
@@ -71,7 +74,7 @@
 #error Interrupt enabled input pins must have unique pin numbers!
 #endif
 
-#define STEPPER_TIMER_DIV 4
+#define STEPPER_TIMER_DIV 1 // TIM5 is 32 bit, run at full clock for best resolution
 #define DRIVER_IRQMASK (LIMIT_MASK|DEVICES_IRQ_MASK)
 
 static periph_signal_t *periph_pins = NULL;
@@ -133,7 +136,7 @@ static input_signal_t inputpin[] = {
     { .id = Input_LimitV_Max,     .port = V_LIMIT_PORT_MAX,   .pin = V_LIMIT_PIN_MAX,     .group = PinGroup_LimitMax },
 #endif
 #ifdef W_LIMIT_PIN_MAX
-    { .id = Input_LimitW_Max,     .port = W_LIMIT_PORT_MAX,   .pin = W_LIMIT_PIN_MAX,     .group = PinGroup_Limit },
+    { .id = Input_LimitW_Max,     .port = W_LIMIT_PORT_MAX,   .pin = W_LIMIT_PIN_MAX,     .group = PinGroup_LimitMax },
 #endif
 #if SPINDLE_SYNC_ENABLE
     { .id = Input_SpindleIndex,   .port = SPINDLE_INDEX_PORT, .pin = SPINDLE_INDEX_PIN,   .group = PinGroup_SpindleIndex },
@@ -396,8 +399,8 @@ static uint32_t aux_irq = 0;
 static bool IOInitDone = false;
 static pin_group_pins_t limit_inputs = {0};
 static delay_t delay = { .ms = 1, .callback = NULL }; // NOTE: initial ms set to 1 for "resetting" systick timer on startup
-static input_signal_t *pin_irq[16] = {0};
-static struct {
+DTCM_DATA static input_signal_t *pin_irq[16] = {0};
+DTCM_DATA static struct {
     // t_* parameters are timer ticks
     uint32_t t_min_period;
     uint32_t t_on; // delayed pulse
@@ -418,8 +421,87 @@ static struct {
 #endif
 } step_pulse = {};
 
+#if STEP_DMA_ENABLE
+
+DTCM_DATA static struct {
+    bool enabled;
+    // t_* parameters are pulse timer ticks
+    uint32_t t_on;      // pulse on delay, no direction change
+    uint32_t t_dly_on;  // pulse on delay after direction change
+    uint32_t t_len;     // pulse length
+    uint16_t invert;    // step_invert setting as port bits
+    uint16_t map[1 << N_AXIS];
+#ifdef SQUARING_ENABLED
+    uint16_t map2[8];   // X2, Y2 and Z2 motors
+#endif
+} step_dma = {};
+
+// BSRR words written by DMA: [0] = pulse on, [1] = pulse off.
+// DTCM is not cached so no cache maintenance is needed before the transfer.
+DTCM_DATA static volatile uint32_t step_dma_out[2] = {0};
+
+#endif // STEP_DMA_ENABLE
+
+#if STEP_OPM_ENABLE
+
+typedef struct {
+    const pwm_signal_t *pwm;
+    uint32_t ocm_mask;  // Output compare mode, preload and fast enable and capture/compare selection bits
+    uint32_t ocm_on;    // PWM mode 2: output active from CCR until update
+    uint32_t ocm_off;   // Forced inactive, for channels sharing a timer with a stepping axis
+    axes_signals_t axis;
+    bool ganged;        // Second motor of auto squared axis
+    bool shared;        // Timer is shared with other step outputs
+} step_opm_out_t;
+
+DTCM_DATA static struct {
+    bool enabled;
+    uint_fast8_t n_out;
+    // t_* parameters are timer ticks
+    uint32_t t_on;      // pulse on delay, no direction change
+    uint32_t t_dly_on;  // pulse on delay after direction change
+    uint32_t t_len;     // pulse length
+    uint32_t t_cur;     // pulse on delay currently loaded
+    step_opm_out_t out[N_AXIS + 3];
+} step_opm = {};
+
+#endif // STEP_OPM_ENABLE
+
+#if STEP_PORTMAP_ENABLE
+
+typedef struct {
+    GPIO_TypeDef *port;
+    uint32_t map[1 << N_AXIS]; // BSRR words indexed by axis bits
+#ifdef SQUARING_ENABLED
+    uint32_t map2[8];          // BSRR words for X2, Y2 and Z2 motors indexed by X, Y and Z bits
+#endif
+} port_map_t;
+
+DTCM_DATA static struct {
+    bool enabled;
+    uint_fast8_t n_step;
+    uint_fast8_t n_dir;
+    port_map_t step[STEP_PORTMAP_MAX_PORTS];
+    port_map_t dir[STEP_PORTMAP_MAX_PORTS];
+} portmap = {};
+
+#endif // STEP_PORTMAP_ENABLE
+
 #if defined(SAFETY_DOOR_PIN)
 static pin_debounce_t debounce;
+#endif
+
+#if DEBOUNCE_TIMER_ENABLE
+
+#define DEBOUNCE_SAMPLES(us) max(1, (us) / DEBOUNCE_SAMPLE_US)
+
+// Integrating counters per EXTI line, a counter starts midway and a level is accepted when it reaches either rail.
+DTCM_DATA static struct {
+    volatile uint32_t active;   // EXTI lines being sampled, masked in EXTI->IMR while active
+    uint16_t count[16];
+    uint16_t rail[16];
+} pin_filter = {};
+
 #endif
 static void aux_irq_handler (uint8_t port, bool state);
 
@@ -539,9 +621,11 @@ static void stepperWakeUp (void)
 }
 
 // Sets up stepper driver interrupt timeout, "Normal" version
+// NOTE: ARR is preloaded and takes effect on the next update event, with the timer running
+//       undivided the 32 bit counter covers the full cycles_per_tick range without clamping.
 ISR_CODE static void stepperCyclesPerTick (uint32_t cycles_per_tick)
 {
-    STEPPER_TIMER->ARR = cycles_per_tick < (1UL << 20) ? max(cycles_per_tick, step_pulse.t_min_period) : 0x000FFFFFUL;
+    STEPPER_TIMER->ARR = max(cycles_per_tick, step_pulse.t_min_period);
 }
 
 #ifdef SQUARING_ENABLED
@@ -550,6 +634,8 @@ inline static __attribute__((always_inline)) void stepper_step_out (axes_signals
 {
     axes_signals_t step_out2;
 
+    STEP_TRACE(StepTrace_Step, step_out1.bits);
+
 #if STEP_INJECT_ENABLE
 
     axes_signals_t axes = { .bits = step_pulse.inject.axes.bits };
@@ -639,6 +725,20 @@ inline static __attribute__((always_inline)) void stepper_step_out (axes_signals
 
 #endif // STEP_INJECT_ENABLE
 
+#if STEP_PORTMAP_ENABLE
+    if(portmap.enabled) {
+
+        port_map_t *map = portmap.step;
+        uint_fast8_t n = portmap.n_step;
+
+        do {
+            map->port->BSRR = map->map[step_out1.bits & motors_1.bits] | map->map2[step_out1.bits & motors_2.bits & 0b111];
+            map++;
+        } while(--n);
+
+    } else {
+#endif
+
     step_out2.bits = (step_out1.bits & motors_2.bits) ^ settings.steppers.step_invert.bits;
 
 #if STEP_OUTMODE == GPIO_SINGLE
@@ -680,6 +780,9 @@ inline static __attribute__((always_inline)) void stepper_step_out (axes_signals
 #ifdef Z2_STEP_PIN
     DIGITAL_OUT(Z2_STEP_PORT, Z2_STEP_BIT, step_out2.z);
 #endif
+#if STEP_PORTMAP_ENABLE
+    }
+#endif
 #if STEP_INJECT_ENABLE
     }
 #endif
@@ -698,6 +801,8 @@ static void StepperDisableMotors (axes_signals_t axes, squaring_mode_t mode)
 // NOTE: step_outbits are: bit0 -> X, bit1 -> Y, bit2 -> Z...
 inline static __attribute__((always_inline)) void stepper_step_out (axes_signals_t step_out)
 {
+    STEP_TRACE(StepTrace_Step, step_out.bits);
+
 #if STEP_INJECT_ENABLE
 
     axes_signals_t axes = { .bits = step_pulse.inject.axes.bits };
@@ -760,6 +865,20 @@ inline static __attribute__((always_inline)) void stepper_step_out (axes_signals
 
 #endif // STEP_INJECT_ENABLE
 
+#if STEP_PORTMAP_ENABLE
+    if(portmap.enabled) {
+
+        port_map_t *map = portmap.step;
+        uint_fast8_t n = portmap.n_step;
+
+        do {
+            map->port->BSRR = map->map[step_out.bits];
+            map++;
+        } while(--n);
+
+    } else {
+#endif
+
 #if STEP_OUTMODE == GPIO_SINGLE
     step_out.bits ^= settings.steppers.step_invert.bits;
     DIGITAL_OUT(X_STEP_PORT, X_STEP_BIT, step_out.x);
@@ -816,6 +935,9 @@ inline static __attribute__((always_inline)) void stepper_step_out (axes_signals
     DIGITAL_OUT(Z2_STEP_PORT, Z2_STEP_BIT, step_out.z);
   #endif
 #endif
+#if STEP_PORTMAP_ENABLE
+    }
+#endif
 #if STEP_INJECT_ENABLE
     }
 #endif
@@ -860,6 +982,8 @@ static axes_signals_t getGangedAxes (bool auto_squared)
 // NOTE: see note for stepper_step_out()
 inline static __attribute__((always_inline)) void stepper_dir_out (axes_signals_t dir_out)
 {
+    STEP_TRACE(StepTrace_Dir, dir_out.bits);
+
 #if STEP_INJECT_ENABLE
 
     axes_signals_t axes = { .bits = step_pulse.inject.axes.bits };
@@ -931,6 +1055,20 @@ inline static __attribute__((always_inline)) void stepper_dir_out (axes_signals_
 
 #endif // STEP_INJECT_ENABLE
 
+#if STEP_PORTMAP_ENABLE
+    if(portmap.enabled) {
+
+        port_map_t *map = portmap.dir;
+        uint_fast8_t n = portmap.n_dir;
+
+        do {
+            map->port->BSRR = map->map[dir_out.bits];
+            map++;
+        } while(--n);
+
+    } else {
+#endif
+
 #if DIRECTION_OUTMODE == GPIO_SINGLE
     dir_out.mask ^= settings.steppers.dir_invert.mask;
     DIGITAL_OUT(X_DIRECTION_PORT, X_DIRECTION_BIT, dir_out.x);
@@ -997,20 +1135,157 @@ inline static __attribute__((always_inline)) void stepper_dir_out (axes_signals_
    DIRECTION_PORT->ODR = (DIRECTION_PORT->ODR & ~DIRECTION_MASK) | ((dir_out.mask ^ settings.steppers.dir_invert.mask) << DIRECTION_OUTMODE);
   #endif
 #endif
+#if STEP_PORTMAP_ENABLE
+    }
+#endif
 #if STEP_INJECT_ENABLE
     }
 #endif
 }
 
+#if STEP_PORTMAP_ENABLE
+
+static uint_fast8_t portmap_axis (pin_function_t id, bool *ganged)
+{
+    *ganged = false;
+
+    switch(id) {
+
+        case Output_StepX_2:
+        case Output_DirX_2:
+            *ganged = true;
+            // fall through
+        case Output_StepX:
+        case Output_DirX:
+            return X_AXIS;
+
+        case Output_StepY_2:
+        case Output_DirY_2:
+            *ganged = true;
+            // fall through
+        case Output_StepY:
+        case Output_DirY:
+            return Y_AXIS;
+
+        case Output_StepZ_2:
+        case Output_DirZ_2:
+            *ganged = true;
+            // fall through
+        case Output_StepZ:
+        case Output_DirZ:
+            return Z_AXIS;
+#ifdef A_AXIS
+        case Output_StepA:
+        case Output_DirA:
+            return A_AXIS;
+#endif
+#ifdef B_AXIS
+        case Output_StepB:
+        case Output_DirB:
+            return B_AXIS;
+#endif
+#ifdef C_AXIS
+        case Output_StepC:
+        case Output_DirC:
+            return C_AXIS;
+#endif
+#ifdef U_AXIS
+        case Output_StepU:
+        case Output_DirU:
+            return U_AXIS;
+#endif
+#ifdef V_AXIS
+        case Output_StepV:
+        case Output_DirV:
+            return V_AXIS;
+#endif
+#ifdef W_AXIS
+        case Output_StepW:
+        case Output_DirW:
+            return W_AXIS;
+#endif
+        default:
+            break;
+    }
+
+    return X_AXIS;
+}
+
+// Build per port BSRR lookup tables for step and direction outputs with signal inversion applied,
+// returns false if the outputs are spread over more than STEP_PORTMAP_MAX_PORTS ports.
+// The tables are built at runtime rather than at compile time since the step and direction inversion masks
+// are settings that may change without a rebuild, this function is called again from settings_changed().
+// The pin to port assignment is known at compile time, but the preprocessor cannot group pins by port.
+static bool stepdir_portmap_init (settings_t *settings)
+{
+    bool ganged, invert, is_step;
+    uint32_t bit;
+    uint_fast8_t idx, i, axis, *n_ports;
+    port_map_t *ports, *map;
+
+    portmap.enabled = false;
+    portmap.n_step = portmap.n_dir = 0;
+    memset(portmap.step, 0, sizeof(portmap.step));
+    memset(portmap.dir, 0, sizeof(portmap.dir));
+
+    for(idx = 0; idx < sizeof(outputpin) / sizeof(output_signal_t); idx++) {
+
+        if(!((is_step = outputpin[idx].group == PinGroup_StepperStep) || outputpin[idx].group == PinGroup_StepperDir))
+            continue;
+
+        axis = portmap_axis(outputpin[idx].id, &ganged);
+        ports = is_step ? portmap.step : portmap.dir;
+        n_ports = is_step ? &portmap.n_step : &portmap.n_dir;
+
+        for(i = 0; i < *n_ports && ports[i].port != outputpin[idx].port; i++);
+
+        if(i == *n_ports) {
+            if(i == STEP_PORTMAP_MAX_PORTS)
+                return false;
+            ports[i].port = outputpin[idx].port;
+            (*n_ports)++;
+        }
+
+        map = &ports[i];
+        bit = 1 << outputpin[idx].pin;
+
+        if(is_step)
+            invert = !!(settings->steppers.step_invert.bits & (1 << axis));
+        else
+            invert = !!((settings->steppers.dir_invert.bits ^ (ganged ? settings->steppers.ganged_dir_invert.bits : 0)) & (1 << axis));
+
+#ifdef SQUARING_ENABLED
+        if(is_step && ganged) {
+            for(i = 0; i < 8; i++)
+                map->map2[i] |= (!!(i & (1 << axis)) ^ invert) ? bit : (bit << 16);
+            continue;
+        }
+#endif
+
+        for(i = 0; i < (1 << N_AXIS); i++)
+            map->map[i] |= (!!(i & (1 << axis)) ^ invert) ? bit : (bit << 16);
+    }
+
+    return (portmap.enabled = portmap.n_step && portmap.n_dir);
+}
+
+#endif // STEP_PORTMAP_ENABLE
+
 // Disables stepper driver interrupts
 static void stepperGoIdle (bool clear_signals)
 {
     STEPPER_TIMER->DIER &= ~TIM_DIER_UIE;
 
     if(clear_signals) {
+#if STEP_DMA_ENABLE
+        STEP_PULSE_TIMER->CR1 &= ~TIM_CR1_CEN;
+        STEP_PULSE_TIMER->CNT = 0;
+#endif
         stepper_dir_out((axes_signals_t){0});
         stepper_step_out((axes_signals_t){0});
     }
+
+    TRIP_LATENCY_STOP();
 }
 
 static inline __attribute__((always_inline)) void _stepper_step_out (axes_signals_t step_out)
@@ -1076,6 +1351,316 @@ ISR_CODE static void stepperPulseStartDelayed (stepper_t *stepper)
         _stepper_step_out(stepper->step_out);
 }
 
+#if STEP_DMA_ENABLE
+
+// Output a step pulse via DMA, the pulse timer fires the on and off transfers.
+static inline __attribute__((always_inline)) void stepper_step_out_dma (axes_signals_t step_out, uint32_t t_on)
+{
+    uint32_t bits;
+
+    STEP_TRACE(StepTrace_Step, step_out.bits); // pulse is output t_on pulse timer ticks later
+
+#if STEP_INJECT_ENABLE
+    step_out.bits &= ~step_pulse.inject.axes.bits;
+#endif
+#ifdef SQUARING_ENABLED
+    bits = step_dma.map[step_out.bits & motors_1.bits] | step_dma.map2[step_out.bits & motors_2.bits & 0b111];
+#else
+    bits = step_dma.map[step_out.bits];
+#endif
+
+    step_dma_out[0] = (bits & ~step_dma.invert) | ((bits & step_dma.invert) << 16);
+    step_dma_out[1] = (bits & step_dma.invert) | ((bits & ~step_dma.invert) << 16);
+
+    STEP_PULSE_TIMER->CCR3 = t_on;
+    STEP_PULSE_TIMER->CCR4 = STEP_PULSE_TIMER->ARR = t_on + step_dma.t_len;
+    STEP_PULSE_TIMER->CR1 |= TIM_CR1_CEN;
+}
+
+// Sets stepper direction pins and starts a DMA driven step pulse.
+// Note: delay is only added when there is a direction change and a pulse to be output.
+ISR_CODE static void stepperPulseStartDMA (stepper_t *stepper)
+{
+    uint32_t t_on = step_dma.t_on;
+
+    if(stepper->dir_changed.bits) {
+        if(stepper->step_out.bits & stepper->dir_changed.bits)
+            t_on = step_dma.t_dly_on;
+        stepper->dir_changed.bits = 0;
+        stepper_dir_out(stepper->dir_out);
+    }
+
+    if(stepper->step_out.bits)
+        stepper_step_out_dma(stepper->step_out, t_on);
+}
+
+// Map step outputs to port bits, returns false if not all are on STEP_DMA_PORT.
+static bool stepper_dma_init (void)
+{
+    uint_fast8_t idx, axis;
+    uint16_t bits[N_AXIS] = {0};
+
+    for(idx = 0; idx < sizeof(outputpin) / sizeof(output_signal_t); idx++) {
+
+        if(outputpin[idx].group != PinGroup_StepperStep)
+            continue;
+
+        if(outputpin[idx].port != STEP_DMA_PORT)
+            return false;
+
+        switch(outputpin[idx].id) {
+            case Output_StepX: axis = X_AXIS; break;
+            case Output_StepY: axis = Y_AXIS; break;
+            case Output_StepZ: axis = Z_AXIS; break;
+#ifdef A_AXIS
+            case Output_StepA: axis = A_AXIS; break;
+#endif
+#ifdef B_AXIS
+            case Output_StepB: axis = B_AXIS; break;
+#endif
+#ifdef C_AXIS
+            case Output_StepC: axis = C_AXIS; break;
+#endif
+#ifdef U_AXIS
+            case Output_StepU: axis = U_AXIS; break;
+#endif
+#ifdef V_AXIS
+            case Output_StepV: axis = V_AXIS; break;
+#endif
+#ifdef W_AXIS
+            case Output_StepW: axis = W_AXIS; break;
+#endif
+            default: // Ganged motors
+                axis = outputpin[idx].id == Output_StepX_2 ? X_AXIS : (outputpin[idx].id == Output_StepY_2 ? Y_AXIS : Z_AXIS);
+#ifdef SQUARING_ENABLED
+                for(uint_fast8_t i = 0; i < 8; i++) {
+                    if(i & (1 << axis))
+                        step_dma.map2[i] |= 1 << outputpin[idx].pin;
+                }
+                continue;
+#endif
+                break;
+        }
+
+        bits[axis] |= 1 << outputpin[idx].pin;
+    }
+
+    for(idx = 0; idx < (1 << N_AXIS); idx++) {
+        step_dma.map[idx] = 0;
+        for(axis = 0; axis < N_AXIS; axis++) {
+            if(idx & (1 << axis))
+                step_dma.map[idx] |= bits[axis];
+        }
+    }
+
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    STEP_PULSE_DMA_ON->CR = STEP_PULSE_DMA_OFF->CR = 0;
+    while((STEP_PULSE_DMA_ON->CR & DMA_SxCR_EN) || (STEP_PULSE_DMA_OFF->CR & DMA_SxCR_EN));
+    STEP_PULSE_DMA_IFCR = STEP_PULSE_DMA_IFLAGS;
+
+    STEP_PULSE_DMA_ON->PAR = STEP_PULSE_DMA_OFF->PAR = (uint32_t)&STEP_DMA_PORT->BSRR;
+    STEP_PULSE_DMA_ON->M0AR = (uint32_t)&step_dma_out[0];
+    STEP_PULSE_DMA_OFF->M0AR = (uint32_t)&step_dma_out[1];
+    STEP_PULSE_DMA_ON->NDTR = STEP_PULSE_DMA_OFF->NDTR = 1;
+    STEP_PULSE_DMA_ON->FCR = STEP_PULSE_DMA_OFF->FCR = 0; // Direct mode
+    STEP_PULSE_DMA_ON->CR = STEP_PULSE_DMA_OFF->CR = STEP_PULSE_DMA_CHANNEL|DMA_SxCR_PL|DMA_SxCR_MSIZE_1|DMA_SxCR_PSIZE_1|DMA_SxCR_CIRC|DMA_SxCR_DIR_0|DMA_SxCR_EN;
+
+    STEP_PULSE_TIMER_CLKEN();
+    STEP_PULSE_TIMER->CR1 = TIM_CR1_OPM;
+    STEP_PULSE_TIMER->PSC = (HAL_RCC_GetPCLK2Freq() * 2) / hal.f_step_timer - 1; // Same tick rate as the stepper timer
+    STEP_PULSE_TIMER->CCMR2 = 0;
+    STEP_PULSE_TIMER->DIER = TIM_DIER_CC3DE|TIM_DIER_CC4DE;
+    STEP_PULSE_TIMER->EGR = TIM_EGR_UG;
+    STEP_PULSE_TIMER->SR = 0;
+
+    return true;
+}
+
+#endif // STEP_DMA_ENABLE
+
+#if STEP_OPM_ENABLE
+
+// Fire step pulses from the timers, pulse delay and length is handled by hardware.
+static inline __attribute__((always_inline)) void stepper_step_out_opm (axes_signals_t step_out, uint32_t t_on)
+{
+    uint_fast8_t idx;
+    step_opm_out_t *out;
+    axes_signals_t step_out1 = step_out, step_out2 = step_out;
+
+    STEP_TRACE(StepTrace_Step, step_out.bits); // pulse is output t_on timer ticks later
+
+#ifdef SQUARING_ENABLED
+    step_out1.bits &= motors_1.bits;
+    step_out2.bits &= motors_2.bits;
+#endif
+
+    if(t_on != step_opm.t_cur) {
+        step_opm.t_cur = t_on;
+        idx = step_opm.n_out;
+        do {
+            out = &step_opm.out[--idx];
+            *out->pwm->ccr = t_on;
+            out->pwm->timer->ARR = t_on + step_opm.t_len;
+        } while(idx);
+    }
+
+    // Block channels on shared timers that should not output a pulse before starting any timer.
+    idx = step_opm.n_out;
+    do {
+        out = &step_opm.out[--idx];
+        if(out->shared)
+            *out->pwm->ccmr = (*out->pwm->ccmr & ~out->ocm_mask) | ((out->ganged ? step_out2.bits : step_out1.bits) & out->axis.bits ? out->ocm_on : out->ocm_off);
+    } while(idx);
+
+    idx = step_opm.n_out;
+    do {
+        out = &step_opm.out[--idx];
+        if((out->ganged ? step_out2.bits : step_out1.bits) & out->axis.bits)
+            out->pwm->timer->CR1 |= TIM_CR1_CEN;
+    } while(idx);
+}
+
+// Sets stepper direction pins and starts one-pulse mode timers.
+// Note: delay is only added when there is a direction change and a pulse to be output.
+ISR_CODE static void stepperPulseStartOPM (stepper_t *stepper)
+{
+    uint32_t t_on = step_opm.t_on;
+
+    if(stepper->dir_changed.bits) {
+        if(stepper->step_out.bits & stepper->dir_changed.bits)
+            t_on = step_opm.t_dly_on;
+        stepper->dir_changed.bits = 0;
+        stepper_dir_out(stepper->dir_out);
+    }
+
+    if(stepper->step_out.bits)
+        stepper_step_out_opm(stepper->step_out, t_on);
+}
+
+// Claim timers for all step outputs, returns false if any step pin is not timer capable or its timer is not available.
+// Timers already claimed are released on failure. NOTE: must be called before auxiliary PWM outputs are claimed.
+static bool stepper_opm_claim (void)
+{
+    bool ok = true;
+    uint_fast8_t idx, i;
+    const pwm_signal_t *pwm;
+    step_opm_out_t *out;
+
+    for(idx = 0; ok && idx < sizeof(outputpin) / sizeof(output_signal_t); idx++) {
+
+        if(outputpin[idx].group != PinGroup_StepperStep)
+            continue;
+
+        if(!(ok = (pwm = get_pwm_timer(outputpin[idx].port, outputpin[idx].pin)) != NULL))
+            break;
+
+        // pwm->ocm is OCxM_1|OCxM_2 (PWM mode 1), derive the other bits from it.
+        uint32_t ocm_0 = (pwm->ocm >> 1) & ~pwm->ocm;
+
+        out = &step_opm.out[step_opm.n_out];
+        out->pwm = pwm;
+        out->ocm_on = pwm->ocm|ocm_0;
+        out->ocm_off = pwm->ocm & ~(pwm->ocm >> 1);
+        out->ocm_mask = out->ocm_on|((ocm_0 >> 4) * 0x0F);
+
+        switch(outputpin[idx].id) {
+            case Output_StepX_2: out->ganged = On; // fall through
+            case Output_StepX: out->axis.x = On; break;
+            case Output_StepY_2: out->ganged = On; // fall through
+            case Output_StepY: out->axis.y = On; break;
+            case Output_StepZ_2: out->ganged = On; // fall through
+            case Output_StepZ: out->axis.z = On; break;
+#ifdef A_AXIS
+            case Output_StepA: out->axis.a = On; break;
+#endif
+#ifdef B_AXIS
+            case Output_StepB: out->axis.b = On; break;
+#endif
+#ifdef C_AXIS
+            case Output_StepC: out->axis.c = On; break;
+#endif
+#ifdef U_AXIS
+            case Output_StepU: out->axis.u = On; break;
+#endif
+#ifdef V_AXIS
+            case Output_StepV: out->axis.v = On; break;
+#endif
+#ifdef W_AXIS
+            case Output_StepW: out->axis.w = On; break;
+#endif
+            default: break;
+        }
+
+        for(i = 0; i < step_opm.n_out; i++) {
+            if(step_opm.out[i].pwm->timer == pwm->timer)
+                out->shared = step_opm.out[i].shared = On;
+        }
+
+        // timer_claim() fails for timers owned by other functions, including those not in the general pool.
+        if(!(ok = out->shared || timer_claim(pwm->timer) != NULL))
+            break;
+
+        step_opm.n_out++;
+    }
+
+    if(!ok) {
+        for(idx = 0; idx < step_opm.n_out; idx++)
+            timer_release(step_opm.out[idx].pwm->timer);
+        step_opm.n_out = 0;
+    }
+
+    return ok && step_opm.n_out > 0;
+}
+
+// Switch step pins to timer output and configure the timers for one-pulse mode.
+static void stepper_opm_init (void)
+{
+    uint_fast8_t idx;
+    step_opm_out_t *out;
+
+    for(idx = 0; idx < step_opm.n_out; idx++) {
+
+        out = &step_opm.out[idx];
+
+        pwm_enable(out->pwm);
+
+        out->pwm->timer->CR1 = TIM_CR1_OPM;
+        out->pwm->timer->PSC = timer_get_clock_hz(out->pwm->timer) / hal.f_step_timer - 1; // Same tick rate as the stepper timer
+        out->pwm->timer->CCER &= ~(out->pwm->en|out->pwm->pol);
+        *out->pwm->ccmr = (*out->pwm->ccmr & ~out->ocm_mask) | out->ocm_on;
+        *out->pwm->ccr = step_opm.t_cur = 1;
+        out->pwm->timer->ARR = 2;
+        out->pwm->timer->CCER |= out->pwm->en;
+        if(IS_TIM_BREAK_INSTANCE(out->pwm->timer))
+            out->pwm->timer->BDTR |= TIM_BDTR_OSSR|TIM_BDTR_OSSI|TIM_BDTR_MOE;
+        out->pwm->timer->EGR = TIM_EGR_UG;
+        out->pwm->timer->SR = 0;
+    }
+}
+
+#endif // STEP_OPM_ENABLE
+
+#if STEP_LOOPBACK_ENABLE
+
+// Returns the axes with the primary motor step output driven by the stepper interrupt,
+// excludes motors disabled for auto squaring and motors currently driven by step injection.
+ISR_CODE axes_signals_t stepper_loopback_axes (void)
+{
+    axes_signals_t axes = { .bits = AXES_BITMASK };
+
+#ifdef SQUARING_ENABLED
+    axes.bits &= motors_1.bits;
+#endif
+#if STEP_INJECT_ENABLE
+    axes.bits &= ~step_pulse.inject.axes.bits;
+#endif
+
+    return axes;
+}
+
+#endif // STEP_LOOPBACK_ENABLE
+
 #if STEP_INJECT_ENABLE
 
 static inline __attribute__((always_inline)) void inject_step (axes_signals_t step_out, axes_signals_t axes)
@@ -1167,6 +1752,9 @@ void stepperOutputStep (axes_signals_t step_out, axes_signals_t dir_out)
         axes_signals_t axes = { .bits = (step_out.bits & AXES_BITMASK) };
 
         step_pulse.inject.out = step_out;
+#if STEP_LOOPBACK_ENABLE
+        step_loopback_injected(step_out);
+#endif
         step_pulse.inject.axes.bits = step_pulse.inject.claimed.bits | step_out.bits;
         dir_out.bits ^= settings.steppers.dir_invert.bits;
 
@@ -1274,9 +1862,124 @@ static void limitsEnable (bool on, axes_signals_t homing_cycle)
     } while(idx);
 }
 
+#if INPUT_GATHER_ENABLE
+
+typedef struct {
+    GPIO_TypeDef *port;
+    uint8_t n_pins;
+    uint8_t src[16];    // port pin number
+    uint8_t dst[16];    // bit number in gathered value
+} input_gather_port_t;
+
+typedef struct {
+    uint8_t n_ports;
+    uint32_t mask;      // bits present in gathered value
+    input_gather_port_t port[INPUT_GATHER_MAX_PORTS];
+} input_gather_t;
+
+// Limit bits are gathered as min in bits 0-7, max in bits 8-15 and min2 in bits 16-23.
+DTCM_DATA static input_gather_t limit_gather = {0}, control_gather = {0};
+
+// Reads the IDR of each port used once and assembles the signal bits from it.
+ISR_CODE static inline uint32_t input_gather (const input_gather_t *gather)
+{
+    uint32_t idr, value = 0;
+    uint_fast8_t n_ports = gather->n_ports, n_pins;
+    const input_gather_port_t *port = gather->port;
+
+    while(n_ports--) {
+        idr = port->port->IDR;
+        for(n_pins = 0; n_pins < port->n_pins; n_pins++)
+            value |= ((idr >> port->src[n_pins]) & 1) << port->dst[n_pins];
+        port++;
+    }
+
+    return value;
+}
+
+static bool input_gather_add (input_gather_t *gather, GPIO_TypeDef *port, uint8_t pin, uint8_t bit)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < gather->n_ports && gather->port[idx].port != port; idx++);
+
+    if(idx == gather->n_ports) {
+        if(idx == INPUT_GATHER_MAX_PORTS)
+            return false;
+        gather->port[gather->n_ports++].port = port;
+    }
+
+    gather->port[idx].src[gather->port[idx].n_pins] = pin;
+    gather->port[idx].dst[gather->port[idx].n_pins++] = bit;
+    gather->mask |= 1UL << bit;
+
+    return true;
+}
+
+// Build gather tables for limit and control inputs, on failure the pins are read one by one.
+static void input_gather_init (void)
+{
+    bool ok = true;
+    uint_fast8_t idx;
+    input_signal_t *limit;
+
+    for(idx = 0; ok && idx < limit_inputs.n_pins; idx++) {
+
+        limit = &limit_inputs.pins.inputs[idx];
+
+        uint_fast8_t bit = __builtin_ctz(xbar_fn_to_axismask(limit->id).mask);
+
+        if(limit->group == PinGroup_LimitMax)
+            bit += 8;
+        else if(limit->id == Input_LimitX_2 || limit->id == Input_LimitY_2 || limit->id == Input_LimitZ_2)
+            bit += 16;
+
+        ok = input_gather_add(&limit_gather, limit->port, limit->pin, bit);
+    }
+
+    if(!ok)
+        limit_gather.n_ports = 0;
+
+    ok = true; // control inputs are gathered independently of the limit inputs
+
+    control_signals_t signal;
+
+#if defined(RESET_PIN)
+    signal.value = 0;
+  #if ESTOP_ENABLE
+    signal.e_stop = On;
+  #else
+    signal.reset = On;
+  #endif
+    ok = ok && input_gather_add(&control_gather, RESET_PORT, RESET_PIN, __builtin_ctz(signal.value));
+#endif
+#ifdef FEED_HOLD_PIN
+    signal.value = 0;
+    signal.feed_hold = On;
+    ok = ok && input_gather_add(&control_gather, FEED_HOLD_PORT, FEED_HOLD_PIN, __builtin_ctz(signal.value));
+#endif
+#ifdef CYCLE_START_PIN
+    signal.value = 0;
+    signal.cycle_start = On;
+    ok = ok && input_gather_add(&control_gather, CYCLE_START_PORT, CYCLE_START_PIN, __builtin_ctz(signal.value));
+#endif
+#ifdef SAFETY_DOOR_PIN
+    signal.value = 0;
+    signal.safety_door_ajar = On;
+    ok = ok && input_gather_add(&control_gather, SAFETY_DOOR_PORT, SAFETY_DOOR_PIN, __builtin_ctz(signal.value));
+#endif
+
+    UNUSED(signal);
+
+    if(!ok)
+        control_gather.n_ports = 0;
+}
+
+#endif // INPUT_GATHER_ENABLE
+
 // Returns limit state as an axes_signals_t variable.
 // Each bitfield bit indicates an axis limit, where triggered is 1 and not triggered is 0.
-inline static limit_signals_t limitsGetState()
+inline static limit_signals_t limitsGetStatePins (void)
 {
     limit_signals_t signals = {0};
 
@@ -1380,17 +2083,56 @@ inline static limit_signals_t limitsGetState()
 #ifdef DUAL_LIMIT_SWITCHES
         signals.min2.mask ^= settings.limits.invert.mask;
 #endif
-#ifdef MAX_LIMIT_SWITCHES
-        signals.max.value ^= settings.limits.invert.mask;
+#ifdef MAX_LIMIT_SWITCHES
+        signals.max.value ^= settings.limits.invert.mask;
+#endif
+    }
+
+    return signals;
+}
+
+inline static limit_signals_t limitsGetState (void)
+{
+#if INPUT_GATHER_ENABLE
+    if(limit_gather.n_ports) {
+
+        limit_signals_t signals = {0};
+        uint32_t invert = settings.limits.invert.mask;
+
+        invert = (invert | (invert << 8) | (invert << 16)) & limit_gather.mask;
+
+        uint32_t value = input_gather(&limit_gather) ^ invert;
+
+        signals.min.mask = (uint8_t)value;
+        signals.max.mask = (uint8_t)(value >> 8);
+        signals.min2.mask = (uint8_t)(value >> 16);
+
+        return signals;
+    }
+#endif
+
+    return limitsGetStatePins();
+}
+
+#if INPUT_GATHER_ENABLE
+
+inline static control_signals_t systemGetStateGather (void)
+{
+    control_signals_t signals;
+
+    signals.value = (input_gather(&control_gather) ^ settings.control_invert.mask) & control_gather.mask;
+#ifdef SAFETY_DOOR_PIN
+    if(debounce.safety_door)
+        signals.safety_door_ajar = On;
 #endif
-    }
 
     return signals;
 }
 
-// Returns system state as a control_signals_t variable.
-// Each bitfield bit indicates a control signal, where triggered is 1 and not triggered is 0.
-static control_signals_t systemGetState (void)
+#endif // INPUT_GATHER_ENABLE
+
+// Returns the board map control input states, triggered is 1 and not triggered is 0.
+inline static control_signals_t systemGetStatePins (void)
 {
     control_signals_t signals = { settings.control_invert.mask };
 
@@ -1416,9 +2158,96 @@ static control_signals_t systemGetState (void)
     if(settings.control_invert.mask)
         signals.value ^= settings.control_invert.mask;
 
-    return aux_ctrl_scan_status(signals);
+    return signals;
+}
+
+// Returns system state as a control_signals_t variable.
+// Each bitfield bit indicates a control signal, where triggered is 1 and not triggered is 0.
+static control_signals_t systemGetState (void)
+{
+#if INPUT_GATHER_ENABLE
+    if(control_gather.n_ports)
+        return aux_ctrl_scan_status(systemGetStateGather());
+#endif
+
+    return aux_ctrl_scan_status(systemGetStatePins());
+}
+
+#if INPUT_GATHER_ENABLE
+
+static void input_gather_report (const char *inputs, uint_fast8_t n_ports, uint32_t t_gather, uint32_t t_pins)
+{
+    hal.stream.write("[INB:");
+    hal.stream.write(inputs);
+    hal.stream.write("|ports:");
+    hal.stream.write(uitoa(n_ports));
+    hal.stream.write("|gather:");
+    hal.stream.write(uitoa(t_gather / 1000));
+    hal.stream.write("|pins:");
+    hal.stream.write(uitoa(t_pins / 1000));
+    hal.stream.write("]" ASCII_EOL);
+}
+
+// $INB - output mean cycle count of limit and control input reads with gathered and pin by pin reads.
+// Probe inputs are not included, each probe is a single pin read by probeGetState() and is not gathered.
+static status_code_t input_gather_benchmark (sys_state_t state, char *args)
+{
+    uint_fast16_t idx;
+    uint32_t t_gather, t_pins;
+    volatile uint32_t sink;
+
+    if(state != STATE_IDLE)
+        return Status_IdleError;
+
+    if(limit_gather.n_ports == 0)
+        hal.stream.write("[INB:limits|gather not available]" ASCII_EOL);
+    else {
+
+        __disable_irq();
+
+        t_gather = DWT->CYCCNT;
+        for(idx = 0; idx < 1000; idx++)
+            sink = limitsGetState().min.mask;
+        t_gather = DWT->CYCCNT - t_gather;
+
+        t_pins = DWT->CYCCNT;
+        for(idx = 0; idx < 1000; idx++)
+            sink = limitsGetStatePins().min.mask;
+        t_pins = DWT->CYCCNT - t_pins;
+
+        __enable_irq();
+
+        input_gather_report("limits", limit_gather.n_ports, t_gather, t_pins);
+    }
+
+    if(control_gather.n_ports == 0)
+        hal.stream.write("[INB:control|gather not available]" ASCII_EOL);
+    else {
+
+        __disable_irq();
+
+        t_gather = DWT->CYCCNT;
+        for(idx = 0; idx < 1000; idx++)
+            sink = systemGetStateGather().value;
+        t_gather = DWT->CYCCNT - t_gather;
+
+        t_pins = DWT->CYCCNT;
+        for(idx = 0; idx < 1000; idx++)
+            sink = systemGetStatePins().value;
+        t_pins = DWT->CYCCNT - t_pins;
+
+        __enable_irq();
+
+        input_gather_report("control", control_gather.n_ports, t_gather, t_pins);
+    }
+
+    UNUSED(sink);
+
+    return Status_OK;
 }
 
+#endif // INPUT_GATHER_ENABLE
+
 #if DRIVER_PROBES
 
 // Returns the probe triggered pin state.
@@ -1444,6 +2273,22 @@ static void mpg_enable (void *data)
 
 #endif // MPG_ENABLE
 
+#if INPUT_EVENTS_ENABLE
+
+// Foreground processing of input events posted from interrupt context.
+static void input_event_handler (input_event_t *event)
+{
+#if SDCARD_ENABLE && defined(SD_DETECT_PIN)
+    if(event->input->group & PinGroup_SdCard)
+        sdcard_detect(!event->state);
+    else
+#endif
+    if(event->input->interrupt_callback)
+        event->input->interrupt_callback(event->input->user_port, event->state);
+}
+
+#endif // INPUT_EVENTS_ENABLE
+
 static void aux_irq_handler (uint8_t port, bool state)
 {
     aux_ctrl_t *aux_in;
@@ -1518,17 +2363,29 @@ static bool aux_claim_explicit (aux_ctrl_t *aux_ctrl)
 #if PROBE_ENABLE
             case Input_Probe:
                 hal.driver_cap.probe = probe_add(Probe_Default, aux_ctrl->port, pin->cap.irq_mode, aux_ctrl->input, probeGetState);
+#if PROBE_LATCH_ENABLE
+                if(hal.driver_cap.probe)
+                    probe_latch_add(Probe_Default, (input_signal_t *)aux_ctrl->input);
+#endif
                 break;
 #endif
 #if PROBE2_ENABLE
             case Input_Probe2:
                 hal.driver_cap.probe2 = probe_add(Probe_2, aux_ctrl->port, pin->cap.irq_mode, aux_ctrl->input, probeGetState);
+#if PROBE_LATCH_ENABLE
+                if(hal.driver_cap.probe2)
+                    probe_latch_add(Probe_2, (input_signal_t *)aux_ctrl->input);
+#endif
                 break;
 
 #endif
 #if TOOLSETTER_ENABLE
             case Input_Toolsetter:
                 hal.driver_cap.toolsetter = probe_add(Probe_Toolsetter, aux_ctrl->port, pin->cap.irq_mode, aux_ctrl->input, probeGetState);
+#if PROBE_LATCH_ENABLE
+                if(hal.driver_cap.toolsetter)
+                    probe_latch_add(Probe_Toolsetter, (input_signal_t *)aux_ctrl->input);
+#endif
                 break;
 #endif
 #if SAFETY_DOOR_ENABLE || (defined(RESET_PIN) && !ESTOP_ENABLE)
@@ -1609,6 +2466,21 @@ static void aux_assign_irq (void)
             }
         }
     }
+
+#if DMA_SAMPLER_ENABLE
+
+    // Plain aux inputs left without an EXTI line are handed over to the DMA sampler
+
+    for(i = 0; i < sizeof(inputpin) / sizeof(input_signal_t); i++) {
+
+        input = &inputpin[i];
+
+        if(input->group == PinGroup_AuxInput && input->cap.irq_mode == IRQ_Mode_None &&
+            input->id >= Input_Aux0 && input->id <= Input_AuxMax && dma_sampler_add(input))
+            input->cap.irq_mode = IRQ_Mode_Edges;
+    }
+
+#endif
 }
 
 #if xSPINDLE_ENCODER_ENABLE
@@ -1801,6 +2673,11 @@ static uint32_t getElapsedTicks (void)
 
 void gpio_irq_enable (const input_signal_t *input, pin_irq_mode_t irq_mode)
 {
+#if DMA_SAMPLER_ENABLE
+    if(dma_sampler_irq_enable(input, irq_mode))
+        return;
+#endif
+
     if(irq_mode == IRQ_Mode_Rising) {
         EXTI->RTSR |= input->bit;
         EXTI->FTSR &= ~input->bit;
@@ -1817,6 +2694,79 @@ void gpio_irq_enable (const input_signal_t *input, pin_irq_mode_t irq_mode)
         EXTI->IMR |= input->bit;    // Enable pin interrupt
 }
 
+// Calculates the step pulse timings and selects the pulse start handler, called on settings changes and by the host step timing simulator.
+static void step_pulse_init (settings_t *settings)
+{
+    float sl = (float)hal.f_step_timer / 1000000.0f;
+
+    if(hal.driver_cap.step_pulse_delay && settings->steppers.pulse_delay_microseconds > 0.0f) {
+        step_pulse.t_on = (uint32_t)ceilf(sl * (max(STEP_PULSE_TOFF_MIN, settings->steppers.pulse_delay_microseconds) - STEP_PULSE_TOFF_LATENCY));
+        hal.stepper.pulse_start = stepperPulseStartDelayed;
+    } else {
+        step_pulse.t_on = 0;
+        hal.stepper.pulse_start = stepperPulseStart;
+    }
+
+    step_pulse.t_min_period = (uint32_t)ceilf(sl * (settings->steppers.pulse_microseconds + STEP_PULSE_TOFF_MIN));
+    step_pulse.t_off = (uint32_t)ceilf(sl * (settings->steppers.pulse_microseconds - STEP_PULSE_TOFF_LATENCY));
+    step_pulse.t_off_min = (uint32_t)ceilf(sl * (STEP_PULSE_TOFF_MIN - STEP_PULSE_TON_LATENCY));
+    step_pulse.t_on_off_min = step_pulse.t_off + step_pulse.t_off_min;
+    step_pulse.t_dly_off_min = step_pulse.t_on + step_pulse.t_on_off_min;
+
+#if STEP_TRACE_ENABLE
+    step_trace.pulse_hw = false;
+#endif
+
+#if STEP_DMA_ENABLE
+    if(step_dma.enabled) {
+
+        step_dma.t_on = 1;
+        step_dma.t_len = (uint32_t)ceilf(sl * settings->steppers.pulse_microseconds);
+        step_dma.t_dly_on = hal.driver_cap.step_pulse_delay && settings->steppers.pulse_delay_microseconds > 0.0f
+                             ? (uint32_t)ceilf(sl * settings->steppers.pulse_delay_microseconds)
+                             : step_dma.t_on;
+        step_dma.invert = step_dma.map[settings->steppers.step_invert.bits & AXES_BITMASK];
+#ifdef SQUARING_ENABLED
+        step_dma.invert |= step_dma.map2[settings->steppers.step_invert.bits & 0b111];
+#endif
+        step_pulse.t_min_period = step_dma.t_dly_on + step_dma.t_len + (uint32_t)ceilf(sl * STEP_PULSE_TOFF_MIN);
+        hal.max_step_rate = hal.f_step_timer / step_pulse.t_min_period;
+        hal.stepper.pulse_start = stepperPulseStartDMA;
+#if STEP_TRACE_ENABLE
+        step_trace.pulse_hw = true;
+#endif
+    }
+#endif
+
+#if STEP_OPM_ENABLE
+    if(step_opm.enabled) {
+
+        uint_fast8_t idx;
+
+        step_opm.t_on = 1;
+        step_opm.t_len = (uint32_t)ceilf(sl * settings->steppers.pulse_microseconds);
+        step_opm.t_dly_on = hal.driver_cap.step_pulse_delay && settings->steppers.pulse_delay_microseconds > 0.0f
+                             ? (uint32_t)ceilf(sl * settings->steppers.pulse_delay_microseconds)
+                             : step_opm.t_on;
+        step_opm.t_cur = 0; // force reload of compare and reload registers
+
+        for(idx = 0; idx < step_opm.n_out; idx++) {
+            if(settings->steppers.step_invert.bits & step_opm.out[idx].axis.bits)
+                step_opm.out[idx].pwm->timer->CCER |= step_opm.out[idx].pwm->pol;
+            else
+                step_opm.out[idx].pwm->timer->CCER &= ~step_opm.out[idx].pwm->pol;
+        }
+
+        step_pulse.t_min_period = step_opm.t_dly_on + step_opm.t_len + (uint32_t)ceilf(sl * STEP_PULSE_TOFF_MIN);
+        hal.max_step_rate = hal.f_step_timer / step_pulse.t_min_period;
+        hal.stepper.pulse_start = stepperPulseStartOPM;
+#if STEP_TRACE_ENABLE
+        step_trace.pulse_hw = true;
+#endif
+    }
+#endif
+}
+
 // Configures peripherals when settings are initialized or changed
 void settings_changed (settings_t *settings, settings_changed_flags_t changed)
 {
@@ -1831,27 +2781,21 @@ void settings_changed (settings_t *settings, settings_changed_flags_t changed)
             .Speed = GPIO_SPEED_FREQ_HIGH
         };
 
+#if STEP_PORTMAP_ENABLE
+        stepdir_portmap_init(settings);
+#endif
+
         hal.stepper.go_idle(true);
 
 #ifdef SQUARING_ENABLED
         hal.stepper.disable_motors((axes_signals_t){0}, SquaringMode_Both);
 #endif
 
-        float sl = (float)hal.f_step_timer / 1000000.0f;
-
-        if(hal.driver_cap.step_pulse_delay && settings->steppers.pulse_delay_microseconds > 0.0f) {
-            step_pulse.t_on = (uint32_t)ceilf(sl * (max(STEP_PULSE_TOFF_MIN, settings->steppers.pulse_delay_microseconds) - STEP_PULSE_TOFF_LATENCY));
-            hal.stepper.pulse_start = stepperPulseStartDelayed;
-        } else {
-            step_pulse.t_on = 0;
-            hal.stepper.pulse_start = stepperPulseStart;
-        }
+        step_pulse_init(settings);
 
-        step_pulse.t_min_period = (uint32_t)ceilf(sl * (settings->steppers.pulse_microseconds + STEP_PULSE_TOFF_MIN));
-        step_pulse.t_off = (uint32_t)ceilf(sl * (settings->steppers.pulse_microseconds - STEP_PULSE_TOFF_LATENCY));
-        step_pulse.t_off_min = (uint32_t)ceilf(sl * (STEP_PULSE_TOFF_MIN - STEP_PULSE_TON_LATENCY));
-        step_pulse.t_on_off_min = step_pulse.t_off + step_pulse.t_off_min;
-        step_pulse.t_dly_off_min = step_pulse.t_on + step_pulse.t_on_off_min;
+#if STEP_LOOPBACK_ENABLE
+        step_loopback_attach(settings);
+#endif
 
 #if STEP_INJECT_ENABLE
 
@@ -2005,8 +2949,13 @@ void settings_changed (settings_t *settings, settings_changed_flags_t changed)
                     break;
             }
 
+#if DEBOUNCE_TIMER_ENABLE && DEBOUNCE_LIMIT_US > 0
+            if(input->group & (PinGroup_Limit|PinGroup_LimitMax))
+                input->mode.debounce = On;
+#endif
+
             if(input->group == PinGroup_AuxInput) {
-                if(input->cap.irq_mode != IRQ_Mode_None) {
+                if(input->cap.irq_mode != IRQ_Mode_None && !DMA_SAMPLED(input)) {
                     // Map interrupt to pin
                     uint32_t extireg = SYSCFG->EXTICR[input->pin >> 2] & ~(0b1111 << ((input->pin & 0b11) << 2));
                     extireg |= ((uint32_t)(GPIO_GET_INDEX(input->port)) << ((input->pin & 0b11) << 2));
@@ -2017,7 +2966,7 @@ void settings_changed (settings_t *settings, settings_changed_flags_t changed)
             GPIO_Init.Pin = input->bit;
             GPIO_Init.Pull = input->mode.pull_mode == PullMode_Up ? GPIO_PULLUP : GPIO_NOPULL;
 
-            switch(input->mode.irq_mode) {
+            switch(DMA_SAMPLED(input) ? IRQ_Mode_None : input->mode.irq_mode) {
                 case IRQ_Mode_Rising:
                     GPIO_Init.Mode = GPIO_MODE_IT_RISING;
                     break;
@@ -2033,6 +2982,9 @@ void settings_changed (settings_t *settings, settings_changed_flags_t changed)
             }
             HAL_GPIO_Init(input->port, &GPIO_Init);
 
+            if(DMA_SAMPLED(input))
+                gpio_irq_enable(input, input->mode.irq_mode); // select the edges reported by the sampler
+
         } while(i);
 
         uint32_t irq_mask = DRIVER_IRQMASK|aux_irq;
@@ -2326,6 +3278,32 @@ static bool driver_setup (settings_t *settings)
     HAL_NVIC_SetPriority(STEPPER_TIMER_IRQn, 0, 0);
     NVIC_EnableIRQ(STEPPER_TIMER_IRQn);
 
+#if DEBOUNCE_TIMER_ENABLE
+
+ // Debounce sampling timer init, started by pin_filter_start() and stopped when all inputs has settled
+
+    DEBOUNCE_TIMER_CLKEN();
+    DEBOUNCE_TIMER->CR1 = 0;
+    DEBOUNCE_TIMER->PSC = HAL_RCC_GetPCLK1Freq() * 2 / 1000000UL - 1;
+    DEBOUNCE_TIMER->ARR = DEBOUNCE_SAMPLE_US - 1;
+    DEBOUNCE_TIMER->EGR = TIM_EGR_UG;
+    DEBOUNCE_TIMER->SR = ~TIM_SR_UIF;
+    DEBOUNCE_TIMER->DIER = TIM_DIER_UIE;
+
+    HAL_NVIC_SetPriority(DEBOUNCE_TIMER_IRQn, 1, 0);
+    NVIC_EnableIRQ(DEBOUNCE_TIMER_IRQn);
+
+#endif
+
+#if STEP_DMA_ENABLE
+    step_dma.enabled = stepper_dma_init();
+#endif
+
+#if STEP_OPM_ENABLE
+    if(step_opm.enabled)
+        stepper_opm_init();
+#endif
+
 #if SDCARD_SDIO
 
     sdcard_events_t *card = sdcard_init();
@@ -2420,11 +3398,9 @@ static bool get_rtc_time (struct tm *time)
 uint32_t get_free_mem (void)
 {
     extern uint8_t _end; /* Symbol defined in the linker script */
-    extern uint8_t _estack; /* Symbol defined in the linker script */
-    extern uint32_t _Min_Stack_Size; /* Symbol defined in the linker script */
-    const uint32_t stack_limit = (uint32_t)&_estack - (uint32_t)&_Min_Stack_Size;
+    extern uint8_t _eheap; /* Symbol defined in the linker script */
 
-    return stack_limit - (uint32_t)&_end - mallinfo().uordblks;
+    return (uint32_t)&_eheap - (uint32_t)&_end - mallinfo().uordblks;
 }
 
 #if USB_SERIAL_CDC
@@ -2605,6 +3581,26 @@ bool driver_init (void)
 
     serialRegisterStreams();
 
+#if ISR_PROFILE_ENABLE
+    isr_profile_init();
+#endif
+
+#if STEP_TRACE_ENABLE
+    step_trace_init();
+#endif
+
+#if TRIP_LATENCY_ENABLE
+    trip_latency_init();
+#endif
+
+#if STREAM_SPAN_ENABLE
+    stream_span_init();
+#endif
+
+#if STREAM_BENCH_ENABLE
+    stream_bench_init();
+#endif
+
 #if USB_SERIAL_CDC
 
     static const sys_command_t boot_command_list[] = {
@@ -2674,7 +3670,7 @@ bool driver_init (void)
                 aux_ctrl_remap_explicit((aux_gpio_t){ .port = input->port, .pin = input->pin }, input->user_port, input);
             }
 
-            if((input->cap.debounce = input->cap.irq_mode != IRQ_Mode_None)) {
+            if((input->cap.debounce = input->cap.irq_mode != IRQ_Mode_None && !DMA_SAMPLED(input))) {
                 aux_irq |= input->bit;
                 pin_irq[__builtin_ffs(input->bit) - 1] = input;
             }
@@ -2696,6 +3692,30 @@ bool driver_init (void)
         }
     }
 
+#if INPUT_GATHER_ENABLE
+
+    static const sys_command_t gather_command_list[] = {
+        {"INB", input_gather_benchmark, { .allow_blocking = On, .noargs = On }, { .str = "output cycle counts for gathered and pin by pin limit and control input reads" } }
+    };
+
+    static sys_commands_t gather_commands = {
+        .n_commands = sizeof(gather_command_list) / sizeof(sys_command_t),
+        .commands = gather_command_list
+    };
+
+    input_gather_init();
+    system_register_commands(&gather_commands);
+
+#endif
+
+#if INPUT_EVENTS_ENABLE
+    input_events_init(input_event_handler);
+#endif
+
+#if DMA_SAMPLER_ENABLE
+    dma_sampler_init();
+#endif
+
     output_signal_t *output;
     for(i = 0 ; i < sizeof(outputpin) / sizeof(output_signal_t); i++) {
         output = &outputpin[i];
@@ -2714,6 +3734,14 @@ bool driver_init (void)
         }
     }
 
+#if STEP_OPM_ENABLE
+    step_opm.enabled = stepper_opm_claim();
+#endif
+
+#if STEP_LOOPBACK_ENABLE
+    step_loopback_init();
+#endif
+
     if(aux_inputs.n_pins || aux_outputs.n_pins)
         ioports_init(&aux_inputs, &aux_outputs);
 
@@ -2796,6 +3824,8 @@ bool driver_init (void)
 // Main stepper driver
 ISR_CODE void STEPPER_TIMER_IRQHandler (void)
 {
+    ISR_PROFILE_ENTER();
+
 //    DIGITAL_OUT(AUXOUTPUT0_PORT, 1<<AUXOUTPUT0_PIN, 1);
 
     // Delayed step pulse handler
@@ -2825,10 +3855,58 @@ ISR_CODE void STEPPER_TIMER_IRQHandler (void)
         hal.stepper.interrupt_callback();
     }
 
+    ISR_PROFILE_EXIT(ISR_Stepper);
+
 //    DIGITAL_OUT(AUXOUTPUT0_PORT, 1<<AUXOUTPUT0_PIN, 0);
 }
 
-void core_pin_debounce (void *pin)
+#if DEBOUNCE_TIMER_ENABLE
+
+// Returns the number of samples an input level must be stable for, looked up by the input function
+// since aux inputs may be mapped to control functions after the pin interrupts are set up.
+static inline uint16_t pin_filter_samples (input_signal_t *input)
+{
+    switch(input->id) {
+
+        case Input_EStop:
+            return DEBOUNCE_SAMPLES(DEBOUNCE_ESTOP_US);
+
+        case Input_Reset:
+            return DEBOUNCE_SAMPLES(DEBOUNCE_RESET_US);
+
+        case Input_FeedHold:
+            return DEBOUNCE_SAMPLES(DEBOUNCE_FEED_HOLD_US);
+
+        case Input_CycleStart:
+            return DEBOUNCE_SAMPLES(DEBOUNCE_CYCLE_START_US);
+
+        case Input_SafetyDoor:
+            return DEBOUNCE_SAMPLES(DEBOUNCE_SAFETY_DOOR_US);
+
+        default:
+            break;
+    }
+
+    return input->group & (PinGroup_Limit|PinGroup_LimitMax) ? DEBOUNCE_SAMPLES(DEBOUNCE_LIMIT_US) : DEBOUNCE_SAMPLES(DEBOUNCE_INPUT_US);
+}
+
+// Mask the EXTI line and hand the input over to the sampling timer.
+static inline void pin_filter_start (input_signal_t *input)
+{
+    uint32_t line = __builtin_ffs(input->bit) - 1;
+
+    EXTI->IMR &= ~input->bit; // Disable pin interrupt
+
+    pin_filter.rail[line] = pin_filter_samples(input) * 2;
+    pin_filter.count[line] = pin_filter.rail[line] >> 1;
+    pin_filter.active |= input->bit;
+
+    DEBOUNCE_TIMER->CR1 |= TIM_CR1_CEN;
+}
+
+#endif
+
+ISR_CODE void core_pin_debounce (void *pin)
 {
     input_signal_t *input = (input_signal_t *)pin;
 
@@ -2836,15 +3914,24 @@ void core_pin_debounce (void *pin)
          DIGITAL_IN(input->port, input->bit) == (input->mode.irq_mode == IRQ_Mode_Falling ? 0 : 1)) {
 
         if(input->group & PinGroup_Control) {
+#if TRIP_LATENCY_ENABLE
+            if(input->id == Input_EStop || input->id == Input_Reset)
+                TRIP_LATENCY_START();
+#endif
             hal.control.interrupt_callback(systemGetState());
         }
         if(input->group & (PinGroup_Limit|PinGroup_LimitMax)) {
             limit_signals_t state = limitsGetState();
-            if(limit_signals_merge(state).value) // TODO: add check for limit switches having same state as when limit_isr were invoked?
+            if(limit_signals_merge(state).value) { // TODO: add check for limit switches having same state as when limit_isr were invoked?
+                TRIP_LATENCY_START();
                 hal.limits.interrupt_callback(state);
+            }
         }
 #if SDCARD_ENABLE && defined(SD_DETECT_PIN)
         if(input->group & PinGroup_SdCard)
+  #if INPUT_EVENTS_ENABLE
+            if(!input_event_post(input, DIGITAL_IN(SD_DETECT_PORT, SD_DETECT_BIT)))
+  #endif
             sdcard_detect(!DIGITAL_IN(SD_DETECT_PORT, SD_DETECT_BIT)); // TODO: add check for having same state as when isr were invoked?
 #endif
     }
@@ -2852,7 +3939,24 @@ void core_pin_debounce (void *pin)
     EXTI->IMR |= input->bit; // Reenable pin interrupt
 }
 
-static inline void core_pin_irq (uint32_t bits)
+// Limit inputs that are not debounced goes straight to the limit callback.
+static inline __attribute__((always_inline)) void limit_pin_irq (input_signal_t *input)
+{
+    if(input->mode.irq_mode == IRQ_Mode_Change ||
+         DIGITAL_IN(input->port, input->bit) == (input->mode.irq_mode == IRQ_Mode_Falling ? 0 : 1)) {
+
+        limit_signals_t state = limitsGetState();
+
+        if(limit_signals_merge(state).value) {
+            TRIP_LATENCY_START();
+            hal.limits.interrupt_callback(state);
+        }
+    }
+}
+
+// NOTE: always inlined, when called with a constant single bit the loop, the pin_irq[] index
+//       and the limit input test are resolved at compile time.
+static inline __attribute__((always_inline)) void core_pin_irq (uint32_t bits)
 {
     uint32_t bit;
     input_signal_t *input;
@@ -2863,15 +3967,33 @@ static inline void core_pin_irq (uint32_t bits)
         bits &= ~bit;
 
         if((input = pin_irq[__builtin_ffs(bit) - 1])) {
+            if((LIMIT_MASK & bit) && !input->mode.debounce)
+                limit_pin_irq(input);
+            else
+#if DEBOUNCE_TIMER_ENABLE
+            if(input->mode.debounce)
+                pin_filter_start(input);
+            else
+#else
             if(input->mode.debounce && task_add_delayed(core_pin_debounce, input, 40)) {
                 EXTI->IMR &= ~input->bit; // Disable pin interrupt
             } else
+#endif
                 core_pin_debounce(input);
         }
     }
 }
 
-void aux_pin_debounce (void *pin)
+// E-stop and reset trips are timed from when the level is accepted, after debouncing if enabled.
+static inline __attribute__((always_inline)) void aux_trip_latency_start (input_signal_t *input)
+{
+#if TRIP_LATENCY_ENABLE
+    if(input->id == Input_EStop || input->id == Input_Reset)
+        TRIP_LATENCY_START();
+#endif
+}
+
+ISR_CODE void aux_pin_debounce (void *pin)
 {
     input_signal_t *input = (input_signal_t *)pin;
 
@@ -2881,154 +4003,282 @@ void aux_pin_debounce (void *pin)
 #endif
 
     if(input->mode.irq_mode == IRQ_Mode_Change ||
-          DIGITAL_IN(input->port, input->bit) == (input->mode.irq_mode == IRQ_Mode_Falling ? 0 : 1))
+          DIGITAL_IN(input->port, input->bit) == (input->mode.irq_mode == IRQ_Mode_Falling ? 0 : 1)) {
+        aux_trip_latency_start(input);
         ioports_event(input);
+    }
 
     EXTI->IMR |= input->bit; // Reenable pin interrupt
 }
 
-static inline void aux_pin_irq (uint32_t bits)
+#if DEBOUNCE_TIMER_ENABLE
+
+// Samples all inputs being debounced, inputs that has settled are passed on to the ordinary handlers
+// which checks the level against the interrupt mode and reenables the EXTI line.
+ISR_CODE void DEBOUNCE_TIMER_IRQHandler (void)
+{
+    uint32_t bits = pin_filter.active, bit, line, settled = 0;
+    input_signal_t *input;
+
+    ISR_PROFILE_ENTER();
+
+    DEBOUNCE_TIMER->SR = ~TIM_SR_UIF;
+
+    while(bits) {
+
+        bit = bits & -bits; // isolate the lowest set bit
+        bits &= ~bit;
+        line = __builtin_ffs(bit) - 1;
+        input = pin_irq[line];
+
+        if(DIGITAL_IN(input->port, input->bit)) {
+            if(++pin_filter.count[line] == pin_filter.rail[line])
+                settled |= bit;
+        } else if(--pin_filter.count[line] == 0)
+            settled |= bit;
+    }
+
+    if(settled) {
+
+        __disable_irq();
+        if(!(pin_filter.active &= ~settled))
+            DEBOUNCE_TIMER->CR1 &= ~TIM_CR1_CEN;
+        __enable_irq();
+
+        while(settled) {
+
+            bit = settled & -settled;
+            settled &= ~bit;
+            input = pin_irq[__builtin_ffs(bit) - 1];
+
+            if(input->group == PinGroup_AuxInput)
+                aux_pin_debounce(input);
+            else
+                core_pin_debounce(input);
+        }
+    }
+
+    ISR_PROFILE_EXIT(ISR_Debounce);
+}
+
+#endif // DEBOUNCE_TIMER_ENABLE
+
+// NOTE: always inlined, see core_pin_irq().
+static inline __attribute__((always_inline)) void aux_pin_irq (uint32_t bits)
 {
     uint32_t bit;
     input_signal_t *input;
 
+    PROBE_LATCH_ENTRY();
+
     while(bits) {
 
         bit = bits & -bits; // isolate the lowest set bit
         bits &= ~bit;
 
         if((input = pin_irq[__builtin_ffs(bit) - 1]) && input->group == PinGroup_AuxInput) {
+            PROBE_LATCH_EVENT(input);
+#if DEBOUNCE_TIMER_ENABLE
+            if(input->mode.debounce) {
+                pin_filter_start(input);
+#else
             if(input->mode.debounce && task_add_delayed(aux_pin_debounce, input, 40)) {
                 EXTI->IMR &= ~input->bit; // Disable pin interrupt
+#endif
     #if SAFETY_DOOR_ENABLE
                 if(input->id == Input_SafetyDoor)
                     debounce.safety_door = input->mode.debounce;
     #endif
-            } else
+            } else {
+                aux_trip_latency_start(input);
                 ioports_event(input);
+            }
         }
     }
 }
 
+// Per line handlers for the shared EXTI vectors, dispatched via jump tables indexed by line number.
+// Each handler calls core_pin_irq() or aux_pin_irq() with a constant bit, see the notes above.
+
+#define EXTI_LINE_IRQ(n) \
+ISR_CODE static void exti_line##n##_irq (void) \
+{ \
+    if((LIMIT_MASK|SD_DETECT_BIT) & (1<<n)) \
+        core_pin_irq(1<<n); \
+    else if(AUXINPUT_MASK & (1<<n)) \
+        aux_pin_irq(1<<n); \
+}
+
+#if (LIMIT_MASK|SD_DETECT_BIT|AUXINPUT_MASK) & 0x03E0
+
+EXTI_LINE_IRQ(5)
+EXTI_LINE_IRQ(6)
+EXTI_LINE_IRQ(7)
+EXTI_LINE_IRQ(8)
+EXTI_LINE_IRQ(9)
+
+static void (* const exti9_5_line_irq[])(void) = {
+    exti_line5_irq, exti_line6_irq, exti_line7_irq, exti_line8_irq, exti_line9_irq
+};
+
+#endif
+
+#if (LIMIT_MASK|SD_DETECT_BIT|AUXINPUT_MASK) & 0xFC00
+
+EXTI_LINE_IRQ(10)
+EXTI_LINE_IRQ(11)
+EXTI_LINE_IRQ(12)
+EXTI_LINE_IRQ(13)
+EXTI_LINE_IRQ(14)
+EXTI_LINE_IRQ(15)
+
+static void (* const exti15_10_line_irq[])(void) = {
+    exti_line10_irq, exti_line11_irq, exti_line12_irq, exti_line13_irq, exti_line14_irq, exti_line15_irq
+};
+
+#endif
+
 #if (DRIVER_IRQMASK|AUXINPUT_MASK) & (1<<0)
 
-void EXTI0_IRQHandler(void)
+ISR_CODE void EXTI0_IRQHandler (void)
 {
+    ISR_PROFILE_ENTER();
+
     uint32_t ifg = __HAL_GPIO_EXTI_GET_IT(1<<0);
 
     if(ifg) {
         __HAL_GPIO_EXTI_CLEAR_IT(ifg);
 #if (LIMIT_MASK|SD_DETECT_BIT) & (1<<0)
-        core_pin_irq(ifg);
+        core_pin_irq(1<<0);
 #elif SPI_IRQ_BIT & (1<<0)
         if(spi_irq.callback)
             spi_irq.callback(0, DIGITAL_IN(SPI_IRQ_PORT, SPI_IRQ_BIT) == 0);
 #elif AUXINPUT_MASK & (1<<0)
-        aux_pin_irq(ifg);
+        aux_pin_irq(1<<0);
 #elif SPINDLE_INDEX_BIT & (1<<0)
         spindle_encoder_index_event();
 #endif
     }
+
+    ISR_PROFILE_EXIT(ISR_EXTI0);
 }
 
 #endif
 
 #if (DRIVER_IRQMASK|AUXINPUT_MASK) & (1<<1)
 
-void EXTI1_IRQHandler(void)
+ISR_CODE void EXTI1_IRQHandler (void)
 {
+    ISR_PROFILE_ENTER();
+
     uint32_t ifg = __HAL_GPIO_EXTI_GET_IT(1<<1);
 
     if(ifg) {
         __HAL_GPIO_EXTI_CLEAR_IT(ifg);
 #if (LIMIT_MASK|SD_DETECT_BIT) & (1<<1)
-        core_pin_irq(ifg);
+        core_pin_irq(1<<1);
 #elif SPI_IRQ_BIT & (1<<1)
         if(spi_irq.callback)
             spi_irq.callback(0, DIGITAL_IN(SPI_IRQ_PORT, SPI_IRQ_BIT) == 0);
 #elif AUXINPUT_MASK & (1<<1)
-        aux_pin_irq(ifg);
+        aux_pin_irq(1<<1);
 #elif SPINDLE_INDEX_BIT & (1<<1)
         spindle_encoder_index_event();
 #endif
     }
+
+    ISR_PROFILE_EXIT(ISR_EXTI1);
 }
 
 #endif
 
 #if (DRIVER_IRQMASK|AUXINPUT_MASK) & (1<<2)
 
-void EXTI2_IRQHandler(void)
+ISR_CODE void EXTI2_IRQHandler (void)
 {
+    ISR_PROFILE_ENTER();
+
     uint32_t ifg = __HAL_GPIO_EXTI_GET_IT(1<<2);
 
     if(ifg) {
         __HAL_GPIO_EXTI_CLEAR_IT(ifg);
 #if (LIMIT_MASK|SD_DETECT_BIT) & (1<<2)
-        core_pin_irq(ifg);
+        core_pin_irq(1<<2);
 #elif SPI_IRQ_BIT & (1<<2)
         if(spi_irq.callback)
             spi_irq.callback(0, DIGITAL_IN(SPI_IRQ_PORT, SPI_IRQ_BIT) == 0);
 #elif AUXINPUT_MASK & (1<<2)
-        aux_pin_irq(ifg);
+        aux_pin_irq(1<<2);
 #elif SPINDLE_INDEX_BIT & (1<<2)
         spindle_encoder_index_event();
 #endif
     }
+
+    ISR_PROFILE_EXIT(ISR_EXTI2);
 }
 
 #endif
 
 #if (DRIVER_IRQMASK|AUXINPUT_MASK) & (1<<3)
 
-void EXTI3_IRQHandler(void)
+ISR_CODE void EXTI3_IRQHandler (void)
 {
+    ISR_PROFILE_ENTER();
+
     uint32_t ifg = __HAL_GPIO_EXTI_GET_IT(1<<3);
 
     if(ifg) {
         __HAL_GPIO_EXTI_CLEAR_IT(ifg);
 #if (LIMIT_MASK|SD_DETECT_BIT) & (1<<3)
-        core_pin_irq(ifg);
+        core_pin_irq(1<<3);
 #elif SPI_IRQ_BIT & (1<<3)
         if(spi_irq.callback)
             spi_irq.callback(0, DIGITAL_IN(SPI_IRQ_PORT, SPI_IRQ_BIT) == 0);
 #elif AUXINPUT_MASK & (1<<3)
-        aux_pin_irq(ifg);
+        aux_pin_irq(1<<3);
 #elif SPINDLE_INDEX_BIT & (1<<3)
         spindle_encoder_index_event();
 #endif
     }
+
+    ISR_PROFILE_EXIT(ISR_EXTI3);
 }
 
 #endif
 
 #if (DRIVER_IRQMASK|AUXINPUT_MASK) & (1<<4)
 
-void EXTI4_IRQHandler(void)
+ISR_CODE void EXTI4_IRQHandler (void)
 {
+    ISR_PROFILE_ENTER();
+
     uint32_t ifg = __HAL_GPIO_EXTI_GET_IT(1<<4);
 
     if(ifg) {
         __HAL_GPIO_EXTI_CLEAR_IT(ifg);
 #if (LIMIT_MASK|SD_DETECT_BIT) & (1<<4)
-        core_pin_irq(ifg);
+        core_pin_irq(1<<4);
 #elif SPI_IRQ_BIT & (1<<4)
         if(spi_irq.callback)
             spi_irq.callback(0, DIGITAL_IN(SPI_IRQ_PORT, SPI_IRQ_BIT) == 0);
 #elif AUXINPUT_MASK & (1<<4)
-        aux_pin_irq(ifg);
+        aux_pin_irq(1<<4);
 #elif SPINDLE_INDEX_BIT & (1<<4)
         spindle_encoder_index_event();
 #endif
     }
+
+    ISR_PROFILE_EXIT(ISR_EXTI4);
 }
 
 #endif
 
 #if ((DRIVER_IRQMASK|AUXINPUT_MASK) & 0x03E0)
 
-void EXTI9_5_IRQHandler(void)
+ISR_CODE void EXTI9_5_IRQHandler (void)
 {
+    ISR_PROFILE_ENTER();
+
     uint32_t ifg = __HAL_GPIO_EXTI_GET_IT(0x03E0);
 
     if(ifg) {
@@ -3041,23 +4291,30 @@ void EXTI9_5_IRQHandler(void)
 #if SPINDLE_INDEX_BIT & 0x03E0
         spindle_encoder_index_event();
 #endif
-#if (LIMIT_MASK|SD_DETECT_BIT) & 0x03E0
-        if(ifg & (LIMIT_MASK|SD_DETECT_BIT))
-            core_pin_irq(ifg & (LIMIT_MASK|SD_DETECT_BIT));
-#endif
-#if AUXINPUT_MASK & 0x03E0
-        if(ifg & aux_irq)
-            aux_pin_irq(ifg & aux_irq);
+#if ((LIMIT_MASK|SD_DETECT_BIT|AUXINPUT_MASK) & 0x03E0)
+  #if AUXINPUT_MASK & 0x03E0
+        uint32_t lines = ifg & (LIMIT_MASK|SD_DETECT_BIT|aux_irq);
+  #else
+        uint32_t lines = ifg & (LIMIT_MASK|SD_DETECT_BIT);
+  #endif
+        while(lines) {
+            exti9_5_line_irq[__builtin_ctz(lines) - 5]();
+            lines &= lines - 1; // clear the lowest set bit
+        }
 #endif
     }
+
+    ISR_PROFILE_EXIT(ISR_EXTI9_5);
 }
 
 #endif
 
 #if (DRIVER_IRQMASK|AUXINPUT_MASK) & (0xFC00)
 
-void EXTI15_10_IRQHandler(void)
+ISR_CODE void EXTI15_10_IRQHandler (void)
 {
+    ISR_PROFILE_ENTER();
+
     uint32_t ifg = __HAL_GPIO_EXTI_GET_IT(0xFC00);
 
     if(ifg) {
@@ -3071,15 +4328,20 @@ void EXTI15_10_IRQHandler(void)
         if(ifg & SPINDLE_INDEX_BIT)
             spindle_encoder_index_event();
 #endif
-#if (LIMIT_MASK|SD_DETECT_BIT) & 0xFC00
-        if(ifg & (LIMIT_MASK|SD_DETECT_BIT))
-            core_pin_irq(ifg & (LIMIT_MASK|SD_DETECT_BIT));
-#endif
-#if AUXINPUT_MASK & 0xFC00
-        if(ifg & aux_irq)
-            aux_pin_irq(ifg & aux_irq);
+#if ((LIMIT_MASK|SD_DETECT_BIT|AUXINPUT_MASK) & 0xFC00)
+  #if AUXINPUT_MASK & 0xFC00
+        uint32_t lines = ifg & (LIMIT_MASK|SD_DETECT_BIT|aux_irq);
+  #else
+        uint32_t lines = ifg & (LIMIT_MASK|SD_DETECT_BIT);
+  #endif
+        while(lines) {
+            exti15_10_line_irq[__builtin_ctz(lines) - 10]();
+            lines &= lines - 1; // clear the lowest set bit
+        }
 #endif
     }
+
+    ISR_PROFILE_EXIT(ISR_EXTI15_10);
 }
 
 #endif
@@ -37,14 +37,6 @@ typedef struct {
     TIM_TypeDef *timer;
 } stm32_qei_hw_t;
 
-typedef struct {
-    uint8_t pin;
-    uint8_t af;
-    bool ecm; // external clock mode
-    GPIO_TypeDef *port;
-    TIM_TypeDef *timer;
-} stm32_pcnt_hw_t;
-
 typedef struct {
     encoder_t encoder;
     encoder_data_t data;
@@ -84,29 +76,10 @@ static struct {
 #define TIMESTAMP               (*timestamp.cnt | timestamp.count_h)
 #define TIMESTAMP_RESOLUTION    1 // microseconds
 
-#ifdef SPINDLE_PULSE_PIN
-
-static const stm32_pcnt_hw_t counters[] = {
-#ifdef TIM8
-    { .port = GPIOA, .pin = 0, .af = GPIO_AF3_TIM8, .timer = timer(8), .ecm = false },
-#endif
-#if !IS_TIMER_CLAIMED(TIM2_BASE)
-    { .port = GPIOA, .pin = 5, .af = GPIO_AF1_TIM2, .timer = timer(2), .ecm = false },
-#endif
-#if !IS_TIMER_CLAIMED(TIM1_BASE)
-    { .port = GPIOA, .pin = 12, .af = GPIO_AF1_TIM1, .timer = timer(1), .ecm = false },
-#endif
-#if !IS_TIMER_CLAIMED(TIM3_BASE)
-    { .port = GPIOB, .pin = 4, .af = GPIO_AF2_TIM3, .timer = timer(3), .ecm = true },
-    { .port = GPIOD, .pin = 2, .af = GPIO_AF2_TIM3, .timer = timer(3), .ecm = false }
-#endif
-};
-
-#endif
 
-static spindle_encoder_hw_t sp_encoder;
-static spindle_data_t spindle_data;
-static spindle_encoder_t spindle_encoder = {
+DTCM_DATA static spindle_encoder_hw_t sp_encoder;
+DTCM_DATA static spindle_data_t spindle_data;
+DTCM_INIT_DATA static spindle_encoder_t spindle_encoder = {
     .tics_per_irq = 4
 };
 static on_spindle_programmed_ptr on_spindle_programmed = NULL;
@@ -538,60 +511,55 @@ void driver_encoders_init (void)
 
 #ifdef SPINDLE_PULSE_PIN
 
-    uint_fast8_t idx = sizeof(counters) / sizeof(stm32_pcnt_hw_t);
-
-    if(idx) do {
-        idx--;
-        if(counters[idx].port == SPINDLE_PULSE_PORT && counters[idx].pin == SPINDLE_PULSE_PIN && (timer = timer_claim(counters[idx].timer))) {
+    const stm32_pcnt_hw_t *counter;
 
-            sp_encoder.timer = counters[idx].timer;
+    if((counter = pcnt_claim(SPINDLE_PULSE_PORT, SPINDLE_PULSE_PIN, &timer))) {
 
-            timer_clk_enable(sp_encoder.timer);
+        sp_encoder.timer = counter->timer;
 
-            sp_encoder.cr1 = &sp_encoder.timer->CR1;
-            sp_encoder.cnt = &sp_encoder.timer->CNT;
-            sp_encoder.ccr = &sp_encoder.timer->CCR1;
-            sp_encoder.timer->PSC = 0;
-            sp_encoder.timer->ARR = 65535;
- //           sp_encoder.timer->CCER = TIM_CCER_CC1E;
-            sp_encoder.timer->SMCR = counters[idx].ecm ? (TIM_SMCR_SMS_0|TIM_SMCR_SMS_1|TIM_SMCR_SMS_2|TIM_SMCR_ETF_2|TIM_SMCR_ETF_3|TIM_SMCR_TS_0|TIM_SMCR_TS_2) : TIM_SMCR_ECE;
+        timer_clk_enable(sp_encoder.timer);
 
-            HAL_NVIC_EnableIRQ(RPM_COUNTER_IRQn);
-            GPIO_InitTypeDef GPIO_Init = {
-                .Speed = GPIO_SPEED_FREQ_LOW,
-                .Mode = GPIO_MODE_AF_PP,
-                .Pin = (1 << SPINDLE_PULSE_PIN),
-                .Pull = GPIO_NOPULL,
-                .Speed = GPIO_SPEED_FREQ_LOW,
-                .Alternate = counters[idx].af
-            };
+        sp_encoder.cr1 = &sp_encoder.timer->CR1;
+        sp_encoder.cnt = &sp_encoder.timer->CNT;
+        sp_encoder.ccr = &sp_encoder.timer->CCR1;
+        sp_encoder.timer->PSC = 0;
+        sp_encoder.timer->ARR = 65535;
+//        sp_encoder.timer->CCER = TIM_CCER_CC1E;
+        sp_encoder.timer->SMCR = counter->ecm ? (TIM_SMCR_SMS_0|TIM_SMCR_SMS_1|TIM_SMCR_SMS_2|TIM_SMCR_ETF_2|TIM_SMCR_ETF_3|TIM_SMCR_TS_0|TIM_SMCR_TS_2) : TIM_SMCR_ECE;
 
-            HAL_GPIO_Init(SPINDLE_PULSE_PORT, &GPIO_Init);
+        HAL_NVIC_EnableIRQ(RPM_COUNTER_IRQn);
+        GPIO_InitTypeDef GPIO_Init = {
+            .Speed = GPIO_SPEED_FREQ_LOW,
+            .Mode = GPIO_MODE_AF_PP,
+            .Pin = (1 << SPINDLE_PULSE_PIN),
+            .Pull = GPIO_NOPULL,
+            .Speed = GPIO_SPEED_FREQ_LOW,
+            .Alternate = counter->af
+        };
 
-            timer_cfg_t cfg = {
-                .context = &sp_encoder,
-                .timeout_callback = timer_get_resolution(sp_encoder.timer) == Timer_16bit ? spindle_encoder_overflow : NULL,
-                .irq0_callback = spindle_encoder_irq
-            };
+        HAL_GPIO_Init(SPINDLE_PULSE_PORT, &GPIO_Init);
 
-            timerCfg(timer, &cfg);
+        timer_cfg_t cfg = {
+            .context = &sp_encoder,
+            .timeout_callback = timer_get_resolution(sp_encoder.timer) == Timer_16bit ? spindle_encoder_overflow : NULL,
+            .irq0_callback = spindle_encoder_irq
+        };
 
-            static const periph_pin_t ssp = {
-                .function = Input_SpindlePulse,
-                .group = PinGroup_SpindlePulse,
-                .port = SPINDLE_PULSE_PORT,
-                .pin = SPINDLE_PULSE_PIN,
-                .mode = { .mask = PINMODE_NONE }
-            };
+        timerCfg(timer, &cfg);
 
-            hal.periph_port.register_pin(&ssp);
+        static const periph_pin_t ssp = {
+            .function = Input_SpindlePulse,
+            .group = PinGroup_SpindlePulse,
+            .port = SPINDLE_PULSE_PORT,
+            .pin = SPINDLE_PULSE_PIN,
+            .mode = { .mask = PINMODE_NONE }
+        };
 
-            sp_encoder.settings_changed = hal.settings_changed;
-            hal.settings_changed = spindle_encoder_cfg;
+        hal.periph_port.register_pin(&ssp);
 
-            break;
-        }
-    } while(idx);
+        sp_encoder.settings_changed = hal.settings_changed;
+        hal.settings_changed = spindle_encoder_cfg;
+    }
 
 #endif // SPINDLE_PULSE_PIN
 #endif // SPINDLE_ENCODER_ENABLE
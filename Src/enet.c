@@ -262,7 +262,10 @@ static void enet_poll (void *data)
     static uint32_t ms = 0;
 
     sys_check_timeouts();
+
+    ISR_PROFILE_ENTER();
     ethernetif_input(netif_default);
+    ISR_PROFILE_EXIT(ISR_EthInput);
 
     if(network_status.link_up) switch(++ms) {
 #if TELNET_ENABLE
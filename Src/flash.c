@@ -70,6 +70,8 @@ bool memcpy_to_flash (uint8_t *source)
         }
 
         HAL_FLASH_Lock();
+
+        cache_invalidate(&_EEPROM_Emul_Start, hal.nvs.size);
     }
 
     return status == HAL_OK;
@@ -0,0 +1,154 @@
+/*
+
+  input_events.c - interrupt to foreground input event rings for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if INPUT_EVENTS_ENABLE
+
+#include "grbl/hal.h"
+#include "grbl/task.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+// One ring per interrupt preemption level: priority 0 (EXTI, stepper) and lower priorities (debounce timer, serial, USB).
+// Handlers at the same preemption level cannot interrupt each other so each ring has a single producer,
+// the foreground task is the single consumer.
+#define INPUT_EVENTS_RINGS 2
+
+typedef struct {
+    volatile uint_fast16_t head;
+    volatile uint_fast16_t tail;
+    volatile bool scheduled;
+    uint32_t posted;
+    uint32_t high_water;
+    uint32_t dropped;
+    input_event_t event[INPUT_EVENTS_RING_SIZE];
+} input_event_ring_t;
+
+DTCM_DATA static input_event_ring_t ring[INPUT_EVENTS_RINGS] = {};
+static input_event_handler_ptr event_handler = NULL;
+static const input_event_t *current = NULL;
+
+static void input_events_process (void *data)
+{
+    input_event_ring_t *events = (input_event_ring_t *)data;
+    uint_fast16_t tail = events->tail;
+
+    events->scheduled = false;
+
+    while(tail != events->head) {
+        current = &events->event[tail];
+        event_handler(&events->event[tail]);
+        events->tail = tail = (tail + 1) & (INPUT_EVENTS_RING_SIZE - 1);
+    }
+
+    current = NULL;
+}
+
+// Posts an event to the ring for the preemption level of the calling interrupt handler.
+// Returns false when called from the foreground, the caller should then process the event immediately.
+ISR_CODE bool input_event_post (input_signal_t *input, bool state)
+{
+    uint32_t ipsr = __get_IPSR(), count;
+
+    if(ipsr == 0 || event_handler == NULL)
+        return false;
+
+    input_event_ring_t *events = &ring[NVIC_GetPriority((IRQn_Type)((int32_t)ipsr - 16)) ? 1 : 0];
+    uint_fast16_t head = events->head, next = (head + 1) & (INPUT_EVENTS_RING_SIZE - 1);
+
+    if(next == events->tail)
+        events->dropped++;
+    else {
+        events->event[head].timestamp = DWT->CYCCNT;
+        events->event[head].input = input;
+        events->event[head].state = state;
+        events->head = next;
+        events->posted++;
+        if((count = (next - events->tail) & (INPUT_EVENTS_RING_SIZE - 1)) > events->high_water)
+            events->high_water = count;
+        if(!events->scheduled)
+            events->scheduled = task_add_immediate(input_events_process, events);
+    }
+
+    return true;
+}
+
+// Returns the event being processed when called from an input callback, NULL otherwise.
+const input_event_t *input_event_current (void)
+{
+    return current;
+}
+
+// $IEV - report posted, high-water mark and dropped counts for each ring.
+// $IEV=R - reset counters.
+static status_code_t input_events_report (sys_state_t state, char *args)
+{
+    uint_fast8_t idx;
+
+    if(args) {
+        if(!(*args == 'R' || *args == 'r') || args[1] != '\0')
+            return Status_InvalidStatement;
+
+        for(idx = 0; idx < INPUT_EVENTS_RINGS; idx++) {
+            __disable_irq();
+            ring[idx].posted = ring[idx].high_water = ring[idx].dropped = 0;
+            __enable_irq();
+        }
+
+        return Status_OK;
+    }
+
+    for(idx = 0; idx < INPUT_EVENTS_RINGS; idx++) {
+        hal.stream.write("[IEV:");
+        hal.stream.write(uitoa(idx));
+        hal.stream.write("|size:");
+        hal.stream.write(uitoa(INPUT_EVENTS_RING_SIZE - 1));
+        hal.stream.write("|n:");
+        hal.stream.write(uitoa(ring[idx].posted));
+        hal.stream.write("|hwm:");
+        hal.stream.write(uitoa(ring[idx].high_water));
+        hal.stream.write("|drop:");
+        hal.stream.write(uitoa(ring[idx].dropped));
+        hal.stream.write("]" ASCII_EOL);
+    }
+
+    return Status_OK;
+}
+
+void input_events_init (input_event_handler_ptr handler)
+{
+    static const sys_command_t input_events_command_list[] = {
+        {"IEV", input_events_report, { .allow_blocking = On }, { .str = "output input event ring statistics, $IEV=R to reset" } }
+    };
+
+    static sys_commands_t input_events_commands = {
+        .n_commands = sizeof(input_events_command_list) / sizeof(sys_command_t),
+        .commands = input_events_command_list
+    };
+
+    event_handler = handler;
+
+    system_register_commands(&input_events_commands);
+}
+
+#endif // INPUT_EVENTS_ENABLE
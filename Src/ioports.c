@@ -27,11 +27,22 @@
 
 #include "main.h"
 #include "grbl/protocol.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
 
 static io_ports_data_t digital;
 static input_signal_t *aux_in;
 static output_signal_t *aux_out;
-static volatile uint32_t event_bits;
+static volatile struct {
+    bool pending;
+    uint32_t t;                     // DWT cycle counter at last event
+} *event = NULL;                    // indexed by aux port, pin numbers are shared by ports and by DMA sampled and EXTI inputs
+static struct {
+    uint8_t port;
+    bool detected;
+    uint32_t t_start;
+    uint32_t t_edge;
+} last_wait = {};
 
 static void digital_out_pwm (struct xbar *output, float value)
 {
@@ -180,55 +191,52 @@ static float digital_in_state (xbar_t *input)
     return value;
 }
 
-inline static __attribute__((always_inline)) int32_t get_input (const input_signal_t *input, wait_mode_t wait_mode, float timeout)
+// Edge waits block on the event flag of the port set by ioports_event() and level waits poll the pin, both until a deadline
+// measured with the DWT cycle counter. Realtime commands are serviced every millisecond while waiting.
+inline static __attribute__((always_inline)) int32_t get_input (uint8_t port, wait_mode_t wait_mode, float timeout)
 {
+    const input_signal_t *input = &aux_in[port];
+
     if(wait_mode == WaitMode_Immediate)
         return DIGITAL_IN(input->port, input->bit) ^ input->mode.inverted;
 
     int32_t value = -1;
-    uint_fast16_t delay = (uint_fast16_t)ceilf((1000.0f / 50.0f) * timeout) + 1;
-
-    if(wait_mode == WaitMode_Rise || wait_mode == WaitMode_Fall) {
-
-        pin_irq_mode_t irq_mode = wait_mode == WaitMode_Rise ? IRQ_Mode_Rising : IRQ_Mode_Falling;
-
-        if(input->cap.irq_mode & irq_mode) {
-
-            event_bits &= ~input->bit;
-            gpio_irq_enable(input, irq_mode);
+    bool edge = wait_mode == WaitMode_Rise || wait_mode == WaitMode_Fall, wait_for = wait_mode != WaitMode_Low;
+    uint32_t now, last, t_realtime, ms_cycles = hal.f_mcu * 1000UL;
+    uint64_t elapsed = 0, timeout_cycles = (uint64_t)(timeout * 1000000.0f) * hal.f_mcu;
+    pin_irq_mode_t irq_mode = wait_mode == WaitMode_Rise ? IRQ_Mode_Rising : IRQ_Mode_Falling;
+
+    if(edge) {
+        if(!(input->cap.irq_mode & irq_mode) || event == NULL)
+            return value;
+        event[port].pending = false;
+        gpio_irq_enable(input, irq_mode);
+    }
 
-            do {
-                if(event_bits & input->bit) {
-                    value = DIGITAL_IN(input->port, input->bit) ^ input->mode.inverted;
-                    break;
-                }
-                if(delay) {
-                    protocol_execute_realtime();
-                    hal.delay_ms(50, NULL);
-                } else
-                    break;
-            } while(--delay && !sys.abort);
+    last_wait.port = input->user_port;
+    last_wait.t_start = last = t_realtime = DWT->CYCCNT;
+    last_wait.detected = false;
 
-            gpio_irq_enable(input, input->mode.irq_mode);    // Restore pin interrupt status
+    do {
+        if(edge ? event[port].pending : (DIGITAL_IN(input->port, input->bit) ^ input->mode.inverted) == wait_for) {
+            last_wait.t_edge = edge ? event[port].t : DWT->CYCCNT;
+            last_wait.detected = true;
+            value = DIGITAL_IN(input->port, input->bit) ^ input->mode.inverted;
+            break;
         }
+        now = DWT->CYCCNT;
+        elapsed += now - last;
+        last = now;
+        if(elapsed >= timeout_cycles)
+            break;
+        if(now - t_realtime >= ms_cycles) {
+            t_realtime = now;
+            protocol_execute_realtime();
+        }
+    } while(!sys.abort);
 
-    } else {
-
-        bool wait_for = wait_mode != WaitMode_Low;
-
-        do {
-            if((DIGITAL_IN(input->port, input->bit) ^ input->mode.inverted) == wait_for) {
-                value = DIGITAL_IN(input->port, input->bit) ^ input->mode.inverted;
-                break;
-            }
-            if(delay) {
-                protocol_execute_realtime();
-                hal.delay_ms(50, NULL);
-            } else
-                break;
-        } while(--delay && !sys.abort);
-
-    }
+    if(edge)
+        gpio_irq_enable(input, input->mode.irq_mode);    // Restore pin interrupt status
 
     return value;
 }
@@ -238,7 +246,7 @@ static int32_t wait_on_input (uint8_t port, wait_mode_t wait_mode, float timeout
     int32_t value = -1;
 
     if(port < digital.in.n_ports)
-        value = get_input(&aux_in[port], wait_mode, timeout);
+        value = get_input(port, wait_mode, timeout);
 
     return value;
 }
@@ -246,9 +254,17 @@ static int32_t wait_on_input (uint8_t port, wait_mode_t wait_mode, float timeout
 void ioports_event (input_signal_t *input)
 {
     if(input) {
-        event_bits |= input->bit;
-        if(input->interrupt_callback)
+        if(event && input >= aux_in && input < aux_in + digital.in.n_ports) {
+            event[input - aux_in].t = DWT->CYCCNT;
+            event[input - aux_in].pending = true;
+        }
+        if(input->interrupt_callback) {
+#if INPUT_EVENTS_ENABLE
+            if(input_event_deferred(input) && input_event_post(input, DIGITAL_IN(input->port, input->bit)))
+                return;
+#endif
             input->interrupt_callback(input->user_port, DIGITAL_IN(input->port, input->bit));
+        }
     }
 }
 
@@ -269,7 +285,7 @@ static bool register_interrupt_handler (uint8_t port, uint8_t user_port, pin_irq
 
         if(irq_mode == IRQ_Mode_None || !ok) {
             hal.irq_disable();
-            EXTI->IMR &= ~input->bit;     // Disable pin interrupt
+            gpio_irq_enable(input, IRQ_Mode_None); // Disable pin interrupt, leaves the EXTI line alone for DMA sampled inputs
             input->mode.irq_mode = IRQ_Mode_None;
             input->interrupt_callback = NULL;
             hal.irq_enable();
@@ -325,6 +341,31 @@ static void set_pin_description (io_port_direction_t dir, uint8_t port, const ch
         aux_out[port].description = s;
 }
 
+// Returns the time in microseconds from the start of the last wait_on_input() call to the edge or level
+// being detected, -1 if the wait timed out.
+int32_t ioports_wait_response_us (uint8_t *port)
+{
+    if(port)
+        *port = last_wait.port;
+
+    return last_wait.detected ? (int32_t)((last_wait.t_edge - last_wait.t_start) / hal.f_mcu) : -1;
+}
+
+// $WOI - report the port and response time in microseconds of the last M66 wait.
+static status_code_t wait_on_input_report (sys_state_t state, char *args)
+{
+    uint8_t port;
+    int32_t response = ioports_wait_response_us(&port);
+
+    hal.stream.write("[WOI:");
+    hal.stream.write(uitoa(port));
+    hal.stream.write("|");
+    hal.stream.write(response < 0 ? "timeout" : uitoa((uint32_t)response));
+    hal.stream.write(response < 0 ? "]" ASCII_EOL : "us]" ASCII_EOL);
+
+    return Status_OK;
+}
+
 void ioports_init (pin_group_pins_t *aux_inputs, pin_group_pins_t *aux_outputs)
 {
     aux_in = aux_inputs->pins.inputs;
@@ -333,6 +374,9 @@ void ioports_init (pin_group_pins_t *aux_inputs, pin_group_pins_t *aux_outputs)
     digital.in.n_ports = aux_inputs->n_pins;
     digital.out.n_ports = aux_outputs->n_pins;
 
+    if(digital.in.n_ports)
+        event = calloc(digital.in.n_ports, sizeof(*event));
+
     io_digital_t ports = {
         .ports = &digital,
         .digital_out = digital_out,
@@ -342,5 +386,16 @@ void ioports_init (pin_group_pins_t *aux_inputs, pin_group_pins_t *aux_outputs)
         .register_interrupt_handler = register_interrupt_handler
     };
 
+    static const sys_command_t wait_command_list[] = {
+        {"WOI", wait_on_input_report, { .allow_blocking = On, .noargs = On }, { .str = "output response time of the last M66 wait" } }
+    };
+
+    static sys_commands_t wait_commands = {
+        .n_commands = sizeof(wait_command_list) / sizeof(sys_command_t),
+        .commands = wait_command_list
+    };
+
     ioports_add_digital(&ports);
+
+    system_register_commands(&wait_commands);
 }
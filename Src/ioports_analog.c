@@ -280,6 +280,284 @@ static bool analog_out (uint8_t port, float value)
 
 #endif // AUX_ANALOG_OUT
 
+#if FREQ_METER_ENABLE
+
+#include <string.h>
+#include <stddef.h>
+
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+// The timer is run in PWM input mode, both capture channels are connected to the pin input and the counter is reset
+// on the rising edge. The capture event on the rising edge triggers a two word DMA burst from CCR1 and CCR2 to the ring.
+
+#define FREQ_METER_MAX          3
+#define FREQ_METER_DMA_FLAGS    (DMA_LISR_FEIF0|DMA_LISR_DMEIF0|DMA_LISR_TEIF0|DMA_LISR_HTIF0|DMA_LISR_TCIF0)
+#define FREQ_METER_IC_FILTER    3 // fCK_INT, N = 8
+
+typedef struct {
+    TIM_TypeDef *timer;
+    uint8_t ch;
+    DMA_TypeDef *dma;
+    DMA_Stream_TypeDef *stream;
+    uint8_t stream_n;
+    uint32_t request;
+} freq_dma_map_t;
+
+typedef struct {
+    uint32_t ccr1;
+    uint32_t ccr2;
+} freq_sample_t;
+
+typedef struct {
+    uint8_t port;
+    input_signal_t *input;
+    const freq_dma_map_t *map;
+    uint32_t tick_hz;
+    freq_sample_t *ring;
+} freq_meter_t;
+
+// Only one channel per timer can be used so TIM1 channels share a stream.
+static const freq_dma_map_t freq_dma_map[] = {
+#if !(SERIAL_TX_DMA_ENABLE && SERIAL_USES_USART(6))
+    { .timer = TIM1, .ch = 1, .dma = DMA2, .stream = DMA2_Stream6, .stream_n = 6, .request = DMA_CHANNEL_0 },
+    { .timer = TIM1, .ch = 2, .dma = DMA2, .stream = DMA2_Stream6, .stream_n = 6, .request = DMA_CHANNEL_0 },
+#endif
+#if !(SERIAL_RX_DMA_ENABLE && SERIAL_USES_USART(2))
+    { .timer = TIM2, .ch = 1, .dma = DMA1, .stream = DMA1_Stream5, .stream_n = 5, .request = DMA_CHANNEL_3 },
+#endif
+#if !(SERIAL_TX_DMA_ENABLE && SERIAL_USES_USART(2)) && !(SERIAL_RX_DMA_ENABLE && SERIAL_USES_USART(8))
+    { .timer = TIM2, .ch = 2, .dma = DMA1, .stream = DMA1_Stream6, .stream_n = 6, .request = DMA_CHANNEL_3 },
+#endif
+#if !(SPI_ENABLE && SPI_PORT == 2) && !(defined(NEOPIXEL_SPI) && NEOPIXEL_SPI == 2) && !(SERIAL_TX_DMA_ENABLE && SERIAL_USES_USART(4))
+    { .timer = TIM3, .ch = 1, .dma = DMA1, .stream = DMA1_Stream4, .stream_n = 4, .request = DMA_CHANNEL_5 },
+#endif
+#if !(SERIAL_RX_DMA_ENABLE && SERIAL_USES_USART(2))
+    { .timer = TIM3, .ch = 2, .dma = DMA1, .stream = DMA1_Stream5, .stream_n = 5, .request = DMA_CHANNEL_5 }
+#endif
+};
+
+static uint_fast8_t n_meters = 0;
+static uint16_t streams_claimed = 0;
+static freq_meter_t meters[FREQ_METER_MAX];
+static DMA_DATA freq_sample_t freq_ring[FREQ_METER_MAX][FREQ_METER_RING_SIZE];
+
+static inline uint32_t freq_dma_flags (const freq_dma_map_t *map)
+{
+    static const uint8_t shift[] = { 0, 6, 16, 22 };
+
+    return ((map->stream_n < 4 ? map->dma->LISR : map->dma->HISR) >> shift[map->stream_n & 0x03]) & FREQ_METER_DMA_FLAGS;
+}
+
+static inline void freq_dma_flags_clear (const freq_dma_map_t *map)
+{
+    static const uint8_t shift[] = { 0, 6, 16, 22 };
+
+    if(map->stream_n < 4)
+        map->dma->LIFCR = FREQ_METER_DMA_FLAGS << shift[map->stream_n & 0x03];
+    else
+        map->dma->HIFCR = FREQ_METER_DMA_FLAGS << shift[map->stream_n & 0x03];
+}
+
+static freq_meter_t *freq_meter_get (uint8_t port)
+{
+    freq_meter_t *meter = NULL;
+    uint_fast8_t idx = n_meters;
+
+    if(idx) do {
+        if(meters[--idx].port == port)
+            meter = &meters[idx];
+    } while(idx && meter == NULL);
+
+    return meter;
+}
+
+// (Re)starts the ring from the first entry, the first capture is discarded as the period it covers is unknown.
+static void freq_meter_restart (freq_meter_t *meter)
+{
+    const freq_dma_map_t *map = meter->map;
+
+    map->stream->CR &= ~DMA_SxCR_EN;
+    while(map->stream->CR & DMA_SxCR_EN);
+
+    freq_dma_flags_clear(map);
+    memset(meter->ring, 0, sizeof(freq_sample_t) * FREQ_METER_RING_SIZE);
+
+    map->stream->NDTR = FREQ_METER_RING_SIZE * 2;
+    map->timer->SR = ~TIM_SR_UIF;
+    map->stream->CR |= DMA_SxCR_EN;
+}
+
+// Averages the completed captures in the ring, returns false if the counter has overflowed since the last
+// restart as there is no signal or the frequency is below FREQ_METER_MIN_HZ.
+static bool freq_meter_read (freq_meter_t *meter, float *period_us, float *duty)
+{
+    const freq_dma_map_t *map = meter->map;
+    uint32_t ndtr = map->stream->NDTR, written = FREQ_METER_RING_SIZE * 2 - ndtr, n = 0;
+    uint_fast8_t idx, first = 1, last = written >> 1;
+    uint64_t sum_period = 0, sum_high = 0;
+
+    if(map->timer->SR & TIM_SR_UIF) {
+        freq_meter_restart(meter);
+        *period_us = 0.0f;
+        *duty = DIGITAL_IN(meter->input->port, meter->input->bit) ? 100.0f : 0.0f;
+        return false;
+    }
+
+    if(freq_dma_flags(map) & DMA_LISR_TCIF0) {
+        first = 0;
+        last = FREQ_METER_RING_SIZE;
+    }
+
+    for(idx = first; idx < last; idx++) {
+        // skip the entry being written by an ongoing burst
+        if(!((written & 0x01) && idx == (written >> 1)) && meter->ring[idx].ccr1 && meter->ring[idx].ccr2) {
+            sum_period += map->ch == 1 ? meter->ring[idx].ccr1 : meter->ring[idx].ccr2;
+            sum_high += map->ch == 1 ? meter->ring[idx].ccr2 : meter->ring[idx].ccr1;
+            n++;
+        }
+    }
+
+    if(n == 0 || sum_period == 0) {
+        *period_us = *duty = 0.0f;
+        return false;
+    }
+
+    *period_us = (float)sum_period * 1000000.0f / ((float)meter->tick_hz * (float)n);
+    *duty = (float)sum_high * 100.0f / (float)sum_period;
+
+    return true;
+}
+
+static float freq_meter_value (freq_meter_t *meter)
+{
+    float period_us, duty;
+
+#if FREQ_METER_MODE == 2
+    freq_meter_read(meter, &period_us, &duty);
+
+    return duty;
+#elif FREQ_METER_MODE == 1
+    freq_meter_read(meter, &period_us, &duty);
+
+    return period_us;
+#else
+    return freq_meter_read(meter, &period_us, &duty) ? 1000000.0f / period_us : 0.0f;
+#endif
+}
+
+static bool freq_meter_init (uint8_t port, input_signal_t *input)
+{
+    uint_fast8_t idx = sizeof(freq_dma_map) / sizeof(freq_dma_map_t);
+    const freq_dma_map_t *map = NULL;
+    const pwm_signal_t *pwm;
+    uint8_t ch;
+
+    if(n_meters == FREQ_METER_MAX || (pwm = get_pwm_timer(input->port, input->pin)) == NULL)
+        return false;
+
+    ch = pwm->en == TIM_CCER_CC1E ? 1 : (pwm->en == TIM_CCER_CC2E ? 2 : 0);
+
+    do {
+        idx--;
+        if(freq_dma_map[idx].timer == pwm->timer && freq_dma_map[idx].ch == ch)
+            map = &freq_dma_map[idx];
+    } while(idx && map == NULL);
+
+    if(map == NULL || (streams_claimed & (1 << (map->stream_n + (map->dma == DMA2 ? 8 : 0)))) || !timer_claim(pwm->timer))
+        return false;
+
+    streams_claimed |= 1 << (map->stream_n + (map->dma == DMA2 ? 8 : 0));
+
+    freq_meter_t *meter = &meters[n_meters];
+    TIM_TypeDef *timer = map->timer;
+    uint32_t clock_hz = timer_clk_enable(timer), range = timer_get_resolution(timer) == Timer_16bit ? 0xFFFF : 0xFFFFFFFF,
+             prescaler = (uint32_t)((uint64_t)clock_hz / FREQ_METER_MIN_HZ / ((uint64_t)range + 1)) + 1;
+
+    meter->port = port;
+    meter->input = input;
+    meter->map = map;
+    meter->ring = freq_ring[n_meters++];
+    meter->tick_hz = clock_hz / prescaler;
+
+    // Pull-up for open collector tachometer outputs
+    GPIO_InitTypeDef gpio_init = {
+        .Pin = input->bit,
+        .Mode = GPIO_MODE_AF_PP,
+        .Pull = GPIO_PULLUP,
+        .Speed = GPIO_SPEED_FREQ_LOW,
+        .Alternate = pwm->af
+    };
+
+    HAL_GPIO_Init(input->port, &gpio_init);
+
+    timer->CR1 = TIM_CR1_URS;
+    timer->PSC = prescaler - 1;
+    timer->ARR = range;
+
+    if(ch == 1) {
+        timer->CCMR1 = TIM_CCMR1_CC1S_0|TIM_CCMR1_CC2S_1|(FREQ_METER_IC_FILTER << TIM_CCMR1_IC1F_Pos);
+        timer->CCER = TIM_CCER_CC1E|TIM_CCER_CC2E|TIM_CCER_CC2P;
+        timer->SMCR = TIM_SMCR_TS_2|TIM_SMCR_TS_0|TIM_SMCR_SMS_2; // Reset on TI1FP1
+        timer->DIER = TIM_DIER_CC1DE;
+    } else {
+        timer->CCMR1 = TIM_CCMR1_CC2S_0|TIM_CCMR1_CC1S_1|(FREQ_METER_IC_FILTER << TIM_CCMR1_IC2F_Pos);
+        timer->CCER = TIM_CCER_CC1E|TIM_CCER_CC2E|TIM_CCER_CC1P;
+        timer->SMCR = TIM_SMCR_TS_2|TIM_SMCR_TS_1|TIM_SMCR_SMS_2; // Reset on TI2FP2
+        timer->DIER = TIM_DIER_CC2DE;
+    }
+
+    timer->DCR = (1 << TIM_DCR_DBL_Pos)|(offsetof(TIM_TypeDef, CCR1) >> 2); // 2 transfers from CCR1
+    timer->EGR = TIM_EGR_UG;
+
+    if(map->dma == DMA2)
+        __HAL_RCC_DMA2_CLK_ENABLE();
+    else
+        __HAL_RCC_DMA1_CLK_ENABLE();
+
+    map->stream->CR = 0;
+    while(map->stream->CR & DMA_SxCR_EN);
+
+    map->stream->PAR = (uint32_t)&timer->DMAR;
+    map->stream->M0AR = (uint32_t)meter->ring;
+    map->stream->FCR = 0;
+    map->stream->CR = map->request|DMA_SxCR_PL_0|DMA_SxCR_MSIZE_1|DMA_SxCR_PSIZE_1|DMA_SxCR_MINC|DMA_SxCR_CIRC;
+
+    freq_meter_restart(meter);
+
+    timer->CR1 |= TIM_CR1_CEN;
+
+    return true;
+}
+
+// $FRQ - output frequency, period and duty cycle for all meters.
+static status_code_t freq_meter_report (sys_state_t state, char *args)
+{
+    float period_us, duty;
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < n_meters; idx++) {
+
+        bool ok = freq_meter_read(&meters[idx], &period_us, &duty);
+
+        hal.stream.write("[FRQ:");
+        hal.stream.write(uitoa(meters[idx].port));
+        hal.stream.write("|f:");
+        hal.stream.write(ftoa(ok ? 1000000.0f / period_us : 0.0f, 2));
+        hal.stream.write("|T:");
+        hal.stream.write(ftoa(period_us, 1));
+        hal.stream.write("|D:");
+        hal.stream.write(ftoa(duty, 1));
+        hal.stream.write("|res:");
+        hal.stream.write(uitoa(1000000000UL / meters[idx].tick_hz));
+        hal.stream.write("ns]" ASCII_EOL);
+    }
+
+    return Status_OK;
+}
+
+#endif // FREQ_METER_ENABLE
+
 static inline int32_t adc_read (ADC_HandleTypeDef *adc, uint32_t channel)
 {
     int32_t value = -1;
@@ -300,11 +578,25 @@ static inline int32_t adc_read (ADC_HandleTypeDef *adc, uint32_t channel)
 
 static float analog_in_state (xbar_t *input)
 {
+#if FREQ_METER_ENABLE
+    freq_meter_t *meter;
+
+    if((meter = freq_meter_get(input->id)))
+        return freq_meter_value(meter);
+#endif
+
     return input->id < analog.in.n_ports ? (float)adc_read(aux_in_analog[input->id].adc, aux_in_analog[input->id].channel) : -1.0f;
 }
 
 static int32_t wait_on_input (uint8_t port, wait_mode_t wait_mode, float timeout)
 {
+#if FREQ_METER_ENABLE
+    freq_meter_t *meter;
+
+    if((meter = freq_meter_get(port)))
+        return (int32_t)freq_meter_value(meter);
+#endif
+
     return port < analog.in.n_ports ? adc_read(aux_in_analog[port].adc, aux_in_analog[port].channel) : -1;
 }
 
@@ -460,7 +752,28 @@ void ioports_init_analog (pin_group_pins_t *aux_inputs, pin_group_pins_t *aux_ou
                         break;
                     }
                 } while(j);
+
+#if FREQ_METER_ENABLE
+                if(aux_inputs->pins.inputs[i].adc == NULL)
+                    freq_meter_init(i, &aux_inputs->pins.inputs[i]);
+#endif
             }
+
+#if FREQ_METER_ENABLE
+            if(n_meters) {
+
+                static const sys_command_t freq_meter_command_list[] = {
+                    {"FRQ", freq_meter_report, { .allow_blocking = On, .noargs = On }, { .str = "output frequency, period and duty cycle of timer capture inputs" } }
+                };
+
+                static sys_commands_t freq_meter_commands = {
+                    .n_commands = sizeof(freq_meter_command_list) / sizeof(sys_command_t),
+                    .commands = freq_meter_command_list
+                };
+
+                system_register_commands(&freq_meter_commands);
+            }
+#endif
         }
 
 #if AUX_ANALOG_OUT
@@ -0,0 +1,141 @@
+/*
+
+  isr_profile.c - interrupt handler profiling for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if ISR_PROFILE_ENABLE
+
+#include <string.h>
+
+#include "grbl/hal.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+isr_profile_t isr_profile[ISR_NumHandlers];
+
+static const char *const isr_name[ISR_NumHandlers] = {
+    "STEPPER",
+    "EXTI0",
+    "EXTI1",
+    "EXTI2",
+    "EXTI3",
+    "EXTI4",
+    "EXTI9_5",
+    "EXTI15_10",
+    "SERIAL0",
+    "SERIAL1",
+    "SERIAL2",
+    "SERIAL3",
+    "SERIAL4",
+    "SERIAL5",
+    "SERIAL6",
+    "SERIAL7",
+    "USB",
+    "TIMER",
+    "ETHIN",
+    "DEBOUNCE"
+};
+
+static void isr_profile_reset (void)
+{
+    uint_fast8_t idx = ISR_NumHandlers;
+
+    __disable_irq();
+
+    memset(isr_profile, 0, sizeof(isr_profile));
+    do {
+        isr_profile[--idx].min = UINT32_MAX;
+    } while(idx);
+
+    __enable_irq();
+}
+
+// $ISR - report min, max and mean cycles and histogram for each profiled handler that has been called.
+// $ISR=R - reset statistics.
+static status_code_t isr_profile_report (sys_state_t state, char *args)
+{
+    uint_fast8_t idx, bin;
+    isr_profile_t profile;
+    char buf[24];
+
+    if(args) {
+        if(!(*args == 'R' || *args == 'r') || args[1] != '\0')
+            return Status_InvalidStatement;
+
+        isr_profile_reset();
+
+        return Status_OK;
+    }
+
+    strcpy(buf, "[ISRCLK:");
+    strcat(buf, uitoa(hal.f_mcu));
+    strcat(buf, "MHz]" ASCII_EOL);
+    hal.stream.write(buf);
+
+    for(idx = 0; idx < ISR_NumHandlers; idx++) {
+
+        __disable_irq();
+        memcpy(&profile, &isr_profile[idx], sizeof(isr_profile_t));
+        __enable_irq();
+
+        if(profile.count == 0)
+            continue;
+
+        hal.stream.write("[ISR:");
+        hal.stream.write(isr_name[idx]);
+        hal.stream.write("|n:");
+        hal.stream.write(uitoa(profile.count));
+        hal.stream.write("|min:");
+        hal.stream.write(uitoa(profile.min));
+        hal.stream.write("|max:");
+        hal.stream.write(uitoa(profile.max));
+        hal.stream.write("|mean:");
+        hal.stream.write(uitoa((uint32_t)(profile.total / profile.count)));
+        hal.stream.write("|hist:");
+        for(bin = 0; bin < ISR_PROFILE_BINS; bin++) {
+            if(bin)
+                hal.stream.write(",");
+            hal.stream.write(uitoa(profile.hist[bin]));
+        }
+        hal.stream.write("]" ASCII_EOL);
+    }
+
+    return Status_OK;
+}
+
+void isr_profile_init (void)
+{
+    static const sys_command_t isr_command_list[] = {
+        {"ISR", isr_profile_report, { .allow_blocking = On }, { .str = "output interrupt handler timing statistics, $ISR=R to reset" } }
+    };
+
+    static sys_commands_t isr_commands = {
+        .n_commands = sizeof(isr_command_list) / sizeof(sys_command_t),
+        .commands = isr_command_list
+    };
+
+    isr_profile_reset();
+
+    system_register_commands(&isr_commands);
+}
+
+#endif // ISR_PROFILE_ENABLE
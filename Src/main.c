@@ -21,12 +21,14 @@
 */
 
 #include "main.h"
+#include "cache.h"
 #include "grbl/grbllib.h"
 
 void SystemClock_Config(void);
 
 int main(void)
 {
+    cache_init();
     HAL_Init();
     SystemClock_Config();
 
@@ -123,6 +123,7 @@ static inline void _write (void)
 {
     while(spi_port.State == HAL_SPI_STATE_BUSY_TX);
 
+    cache_clean(neopixel.leds, neopixel.num_bytes);
     HAL_SPI_Transmit_DMA(&spi_port, neopixel.leds, neopixel.num_bytes);
 }
 
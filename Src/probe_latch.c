@@ -0,0 +1,188 @@
+/*
+
+  probe_latch.c - probe position capture from the probe pin interrupt for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if PROBE_LATCH_ENABLE
+
+#include <string.h>
+#include <stdlib.h>
+
+#include "grbl/hal.h"
+#include "grbl/system.h"
+#include "grbl/crossbar.h"
+#include "grbl/nuts_bolts.h"
+
+#define PROBE_LATCH_MAX_INPUTS 3 // Probe, Probe2 and Toolsetter
+
+DTCM_DATA probe_latch_t probe_latch = {};
+
+typedef struct {
+    probe_id_t id;
+    input_signal_t *input;
+} latch_input_t;
+
+static uint_fast8_t n_inputs = 0;
+static uint32_t irq_claimed = 0;
+static probe_id_t probe_selected = Probe_Default;
+static latch_input_t inputs[PROBE_LATCH_MAX_INPUTS];
+static probe_configure_ptr probe_configure = NULL;
+static probe_select_ptr probe_select = NULL;
+
+// Restores the interrupt mode of an input switched to interrupt on any edge for capture.
+static void probe_latch_release (input_signal_t *input)
+{
+    if(irq_claimed & input->bit) {
+        irq_claimed &= ~input->bit;
+        gpio_irq_enable(input, input->mode.irq_mode);
+    }
+}
+
+// Tracks the probe selected by the core, only its input is armed for capture.
+static bool probeLatchSelect (probe_id_t probe_id)
+{
+    bool ok;
+
+    if((ok = probe_select(probe_id)))
+        probe_selected = probe_id;
+
+    return ok;
+}
+
+// Arms capture on the selected probe input when probing starts, if it has no active pin interrupt it is
+// switched to interrupt on any edge while probing. Other probe inputs are disarmed.
+static void probeLatchConfigure (bool is_probe_away, bool probing)
+{
+    uint_fast8_t idx;
+    input_signal_t *input;
+
+    if(probe_configure)
+        probe_configure(is_probe_away, probing);
+
+    if(probing) {
+
+        uint32_t armed = 0;
+
+        probe_latch.triggered = false;
+
+        for(idx = 0; idx < n_inputs; idx++) {
+
+            input = inputs[idx].input;
+
+            if(inputs[idx].id == probe_selected) {
+                if(!(EXTI->IMR & input->bit)) {
+                    irq_claimed |= input->bit;
+                    EXTI->PR = input->bit;
+                    gpio_irq_enable(input, IRQ_Mode_Change);
+                }
+                armed |= input->bit;
+            } else
+                probe_latch_release(input);
+        }
+
+        probe_latch.armed = armed;
+
+    } else {
+
+        probe_latch.armed = 0;
+
+        for(idx = 0; idx < n_inputs; idx++)
+            probe_latch_release(inputs[idx].input);
+
+        irq_claimed = 0;
+
+#if PROBE_LATCH_ENABLE == 2
+        if(probe_latch.triggered && sys.flags.probe_succeeded)
+            memcpy(sys.probe_position, probe_latch.position, sizeof(sys.probe_position));
+#endif
+    }
+}
+
+// $PRL - report the step position latched by the probe interrupt, the cycles from handler entry to snapshot
+// and the difference in steps to the probe position recorded by the core.
+static status_code_t probe_latch_report (sys_state_t state, char *args)
+{
+    uint_fast8_t idx;
+
+    if(!probe_latch.triggered) {
+        hal.stream.write("[PRL:not triggered]" ASCII_EOL);
+        return Status_OK;
+    }
+
+    hal.stream.write("[PRL:");
+    hal.stream.write(xbar_fn_to_pinname(probe_latch.input->id));
+    hal.stream.write("|pos:");
+    for(idx = 0; idx < N_AXIS; idx++) {
+        if(idx)
+            hal.stream.write(",");
+        hal.stream.write(probe_latch.position[idx] < 0 ? "-" : "");
+        hal.stream.write(uitoa((uint32_t)abs(probe_latch.position[idx])));
+    }
+    hal.stream.write("|t:");
+    hal.stream.write(uitoa(probe_latch.t_latch - probe_latch.t_entry));
+    hal.stream.write("|clk:");
+    hal.stream.write(uitoa(hal.f_mcu));
+    hal.stream.write("MHz|delta:");
+    for(idx = 0; idx < N_AXIS; idx++) {
+        int32_t delta = sys.probe_position[idx] - probe_latch.position[idx];
+        if(idx)
+            hal.stream.write(",");
+        hal.stream.write(delta < 0 ? "-" : "");
+        hal.stream.write(uitoa((uint32_t)abs(delta)));
+    }
+    hal.stream.write("]" ASCII_EOL);
+
+    return Status_OK;
+}
+
+// Called after a probe input has been added to the core, the first call hooks into hal.probe.configure.
+// hal.probe.select is hooked on each call since the core may set it when a probe is added.
+void probe_latch_add (probe_id_t probe_id, input_signal_t *input)
+{
+    static const sys_command_t probe_latch_command_list[] = {
+        {"PRL", probe_latch_report, { .allow_blocking = On, .noargs = On }, { .str = "output step position latched by the last probe trigger" } }
+    };
+
+    static sys_commands_t probe_latch_commands = {
+        .n_commands = sizeof(probe_latch_command_list) / sizeof(sys_command_t),
+        .commands = probe_latch_command_list
+    };
+
+    if(n_inputs == PROBE_LATCH_MAX_INPUTS || input->cap.irq_mode == IRQ_Mode_None)
+        return;
+
+    if(n_inputs == 0) {
+        probe_configure = hal.probe.configure;
+        hal.probe.configure = probeLatchConfigure;
+        system_register_commands(&probe_latch_commands);
+    }
+
+    if(hal.probe.select && hal.probe.select != probeLatchSelect) {
+        probe_select = hal.probe.select;
+        hal.probe.select = probeLatchSelect;
+    }
+
+    inputs[n_inputs].id = probe_id;
+    inputs[n_inputs++].input = input;
+}
+
+#endif // PROBE_LATCH_ENABLE
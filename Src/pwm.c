@@ -32,12 +32,13 @@ typedef struct {
 // .en = timerCCEN(CH, ), .pol = timerCCP(CH, ), .ois = timerCR2OIS(CH, ), .ocm = timerOCM(CCR, CH), .ocmc = timerOCM(CCR, CH)
 
 static const pwm_signal_t pwm_pin[] = {
-#if !ETHERNET_ENABLE
+#if !ETHERNET_ENABLE && !IS_TIMER_CLAIMED(TIM1_BASE)
     {
         .port = GPIOA, .pin = 7, .timer = timer(1), .ccr = &timerCCR(1, 1), .ccmr = &timerCCMR(1, 1), .af = timerAF(1, 1),
         .en = timerCCEN(1, N), .pol = timerCCP(1, N), .ois = timerCR2OIS(1, N), .ocm = timerOCM(1, 1), .ocmc = timerOCM(1, 1)
     },
 #endif
+#if !IS_TIMER_CLAIMED(TIM1_BASE)
     {
         .port = GPIOA, .pin = 8, .timer = timer(1), .ccr = &timerCCR(1, 1), .ccmr = &timerCCMR(1, 1), .af = timerAF(1, 1),
         .en = timerCCEN(1, ), .pol = timerCCP(1, ), .ois = timerCR2OIS(1, ), .ocm = timerOCM(1, 1), .ocmc = timerOCM(1, 1)
@@ -46,6 +47,7 @@ static const pwm_signal_t pwm_pin[] = {
         .port = GPIOB, .pin = 0, .timer = timer(1), .ccr = &timerCCR(1, 2), .ccmr = &timerCCMR(1, 1), .af = timerAF(1, 1),
         .en = timerCCEN(2, N), .pol = timerCCP(2, N), .ois = timerCR2OIS(2, N), .ocm = timerOCM(1, 2), .ocmc = timerOCM(1, 2)
     },
+#endif
 #if !IS_TIMER_CLAIMED(TIM2_BASE)
     {
         .port = GPIOA, .pin = 3, .timer = timer(2), .ccr = &timerCCR(2, 4), .ccmr = &timerCCMR(2, 2), .af = timerAF(2, 1),
@@ -81,6 +83,36 @@ static const pwm_signal_t pwm_pin[] = {
         .port = GPIOC, .pin = 8, .timer = timer(3), .ccr = &timerCCR(3, 3), .ccmr = &timerCCMR(3, 2), .af = timerAF(3, 2),
         .en = timerCCEN(3, ), .pol = timerCCP(3, ), .ois = timerCR2OIS(3, ), .ocm = timerOCM(2, 3), .ocmc = timerOCM(2, 3)
     },
+#endif
+#if STEP_OPM_ENABLE && !IS_TIMER_CLAIMED(TIM1_BASE) // TIM1 outputs on GPIOE, only used for one-pulse mode step outputs
+    {
+        .port = GPIOE, .pin = 8, .timer = timer(1), .ccr = &timerCCR(1, 1), .ccmr = &timerCCMR(1, 1), .af = timerAF(1, 1),
+        .en = timerCCEN(1, N), .pol = timerCCP(1, N), .ois = timerCR2OIS(1, N), .ocm = timerOCM(1, 1), .ocmc = timerOCM(1, 1)
+    },
+    {
+        .port = GPIOE, .pin = 9, .timer = timer(1), .ccr = &timerCCR(1, 1), .ccmr = &timerCCMR(1, 1), .af = timerAF(1, 1),
+        .en = timerCCEN(1, ), .pol = timerCCP(1, ), .ois = timerCR2OIS(1, ), .ocm = timerOCM(1, 1), .ocmc = timerOCM(1, 1)
+    },
+    {
+        .port = GPIOE, .pin = 10, .timer = timer(1), .ccr = &timerCCR(1, 2), .ccmr = &timerCCMR(1, 1), .af = timerAF(1, 1),
+        .en = timerCCEN(2, N), .pol = timerCCP(2, N), .ois = timerCR2OIS(2, N), .ocm = timerOCM(1, 2), .ocmc = timerOCM(1, 2)
+    },
+    {
+        .port = GPIOE, .pin = 11, .timer = timer(1), .ccr = &timerCCR(1, 2), .ccmr = &timerCCMR(1, 1), .af = timerAF(1, 1),
+        .en = timerCCEN(2, ), .pol = timerCCP(2, ), .ois = timerCR2OIS(2, ), .ocm = timerOCM(1, 2), .ocmc = timerOCM(1, 2)
+    },
+    {
+        .port = GPIOE, .pin = 12, .timer = timer(1), .ccr = &timerCCR(1, 3), .ccmr = &timerCCMR(1, 2), .af = timerAF(1, 1),
+        .en = timerCCEN(3, N), .pol = timerCCP(3, N), .ois = timerCR2OIS(3, N), .ocm = timerOCM(2, 3), .ocmc = timerOCM(2, 3)
+    },
+    {
+        .port = GPIOE, .pin = 13, .timer = timer(1), .ccr = &timerCCR(1, 3), .ccmr = &timerCCMR(1, 2), .af = timerAF(1, 1),
+        .en = timerCCEN(3, ), .pol = timerCCP(3, ), .ois = timerCR2OIS(3, ), .ocm = timerOCM(2, 3), .ocmc = timerOCM(2, 3)
+    },
+    {
+        .port = GPIOE, .pin = 14, .timer = timer(1), .ccr = &timerCCR(1, 4), .ccmr = &timerCCMR(1, 2), .af = timerAF(1, 1),
+        .en = timerCCEN(4, ), .pol = timerCCP(4, ), .ois = timerCR2OIS(4, ), .ocm = timerOCM(2, 4), .ocmc = timerOCM(2, 4)
+    },
 #endif
     {
         .port = GPIOE, .pin = 5, .timer = timer(9), .ccr = &timerCCR(9, 1), .ccmr = &timerCCMR(9, 1), .af = timerAF(9, 3),
@@ -103,6 +135,21 @@ pwm_claimed_t pwm_claimed[5] = {0};
 
 // TODO: somehow handle frequency/period when two or more PWM outputs share the same timer...
 
+// Returns timer channel for pin, regardless of claimed status.
+const pwm_signal_t *get_pwm_timer (GPIO_TypeDef *port, uint8_t pin)
+{
+    const pwm_signal_t *pwm = NULL;
+    uint_fast8_t i = sizeof(pwm_pin) / sizeof(pwm_signal_t);
+
+    do {
+        i--;
+        if(port == pwm_pin[i].port && pin == pwm_pin[i].pin)
+            pwm = &pwm_pin[i];
+    } while(i && pwm == NULL);
+
+    return pwm;
+}
+
 bool pwm_is_available (GPIO_TypeDef *port, uint8_t pin)
 {
     const pwm_signal_t *pwm = NULL;
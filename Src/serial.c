@@ -24,16 +24,13 @@
 
 #include "main.h"
 #include "driver.h"
+#include "serial.h"
+#include "stream_span.h"
 
 #include "grbl/hal.h"
 #include "grbl/protocol.h"
 
-#ifdef SERIAL_PORT
-static stream_rx_buffer_t rxbuf = {0};
-static stream_tx_buffer_t txbuf = {0};
-static enqueue_realtime_command_ptr enqueue_realtime_command;
-static const io_stream_t *serialInit (uint32_t baud_rate);
-#else
+#ifndef SERIAL_PORT
 #define SERIAL_PORT 0
 #endif
 
@@ -41,10 +38,6 @@ static const io_stream_t *serialInit (uint32_t baud_rate);
 #if !SERIAL_PORT
 #error "Add SERIAL_PORT before adding SERIAL1_PORT!"
 #endif
-static stream_rx_buffer_t rxbuf1 = {0};
-static stream_tx_buffer_t txbuf1 = {0};
-static enqueue_realtime_command_ptr enqueue_realtime_command1;
-static const io_stream_t *serial1Init(uint32_t baud_rate);
 #else
 #define SERIAL1_PORT 0
 #endif
@@ -53,735 +46,849 @@ static const io_stream_t *serial1Init(uint32_t baud_rate);
 #if !SERIAL1_PORT
 #error "Add SERIAL1_PORT before adding SERIAL2_PORT!"
 #endif
-static stream_rx_buffer_t rxbuf2 = {0};
-static stream_tx_buffer_t txbuf2 = {0};
-static enqueue_realtime_command_ptr enqueue_realtime_command2;
-static const io_stream_t *serial2Init(uint32_t baud_rate);
 #else
 #define SERIAL2_PORT 0
 #endif
 
-#if SERIAL_PORT
+#ifdef SERIAL3_PORT
+#if !SERIAL2_PORT
+#error "Add SERIAL2_PORT before adding SERIAL3_PORT!"
+#endif
+#else
+#define SERIAL3_PORT 0
+#endif
 
-#if SERIAL_PORT == SERIAL1_PORT || SERIAL_PORT == SERIAL2_PORT
-#error Conflicting use of UART peripherals!
+#ifdef SERIAL4_PORT
+#if !SERIAL3_PORT
+#error "Add SERIAL3_PORT before adding SERIAL4_PORT!"
+#endif
+#else
+#define SERIAL4_PORT 0
 #endif
 
-#if (SERIAL_PORT >= 10 && SERIAL_PORT < 19)
-#define UART0            usart(1)
-#define UART0_IRQ        usartINT(1)
-#define UART0_IRQHandler usartHANDLER(1)
-#define UART0_CLK_En     usartCLKEN(1)
-#elif (SERIAL_PORT >= 20 && SERIAL_PORT < 29)
-#define UART0            usart(2)
-#define UART0_IRQ        usartINT(2)
-#define UART0_IRQHandler usartHANDLER(2)
-#define UART0_CLK_En     usartCLKEN(2)
-#elif (SERIAL_PORT >= 30 && SERIAL_PORT < 39)
-#define UART0            usart(3)
-#define UART0_IRQ        usartINT(3)
-#define UART0_IRQHandler usartHANDLER(3)
-#define UART0_CLK_En     usartCLKEN(3)
-#elif (SERIAL_PORT >= 60 && SERIAL_PORT < 69)
-#define UART0            usart(6)
-#define UART0_IRQ        usartINT(6)
-#define UART0_IRQHandler usartHANDLER(6)
-#define UART0_CLK_En     usartCLKEN(6)
+#ifdef SERIAL5_PORT
+#if !SERIAL4_PORT
+#error "Add SERIAL4_PORT before adding SERIAL5_PORT!"
+#endif
 #else
-#define UART0            usart(SERIAL_PORT)
-#define UART0_IRQ        usartINT(SERIAL_PORT)
-#define UART0_IRQHandler usartHANDLER(SERIAL_PORT)
-#define UART0_CLK_En     usartCLKEN(SERIAL_PORT)
+#define SERIAL5_PORT 0
+#endif
+
+#ifdef SERIAL6_PORT
+#if !SERIAL5_PORT
+#error "Add SERIAL5_PORT before adding SERIAL6_PORT!"
 #endif
-#if SERIAL_PORT == 1 || (SERIAL_PORT >= 10 && SERIAL_PORT < 19) || SERIAL_PORT == 6
-#define UART0_CLK HAL_RCC_GetPCLK2Freq()
 #else
-#define UART0_CLK HAL_RCC_GetPCLK1Freq()
-#endif
-
-#if SERIAL_PORT == 1
-#define UART0_TX_PIN 9
-#define UART0_RX_PIN 10
-#define UART0_PORT GPIOA
-#define UART0_AF GPIO_AF7_USART1
-#elif SERIAL_PORT == 11
-#define UART0_TX_PIN 6
-#define UART0_RX_PIN 7
-#define UART0_PORT GPIOB
-#define UART0_AF GPIO_AF7_USART1
-#elif SERIAL_PORT == 2
-#define UART0_TX_PIN 2
-#define UART0_RX_PIN 3
-#define UART0_PORT GPIOA
-#define UART0_AF GPIO_AF7_USART2
-#elif SERIAL_PORT == 21
-#define UART0_TX_PIN 5
-#define UART0_RX_PIN 6
-#define UART0_PORT GPIOD
-#define UART0_AF GPIO_AF7_USART2
-#elif SERIAL_PORT == 3
-#define UART0_TX_PIN 10
-#define UART0_RX_PIN 11
-#define UART0_PORT GPIOB
-#define UART0_AF GPIO_AF7_USART3
-#elif SERIAL_PORT == 31
-#define UART0_TX_PIN 10
-#define UART0_RX_PIN 11
-#define UART0_PORT GPIOC
-#define UART0_AF GPIO_AF7_USART3
-#elif SERIAL_PORT == 32
-#define UART0_TX_PIN 8
-#define UART0_RX_PIN 9
-#define UART0_PORT GPIOD
-#define UART0_AF GPIO_AF7_USART3
-#elif SERIAL_PORT == 6
-#define UART0_TX_PIN 6
-#define UART0_RX_PIN 7
-#define UART0_PORT GPIOC
-#define UART0_AF GPIO_AF8_USART6
-#elif SERIAL_PORT == 61
-#define UART0_TX_PIN 14
-#define UART0_RX_PIN 9
-#define UART0_PORT GPIOG
-#define UART0_AF GPIO_AF8_USART6
+#define SERIAL6_PORT 0
+#endif
+
+#ifdef SERIAL7_PORT
+#if !SERIAL6_PORT
+#error "Add SERIAL6_PORT before adding SERIAL7_PORT!"
+#endif
 #else
-#error Code has to be added to support serial port
+#define SERIAL7_PORT 0
 #endif
 
-#endif // SERIAL_PORT
+#define N_UARTS ((SERIAL_PORT ? 1 : 0) + (SERIAL1_PORT ? 1 : 0) + (SERIAL2_PORT ? 1 : 0) + (SERIAL3_PORT ? 1 : 0) + \
+                 (SERIAL4_PORT ? 1 : 0) + (SERIAL5_PORT ? 1 : 0) + (SERIAL6_PORT ? 1 : 0) + (SERIAL7_PORT ? 1 : 0))
+
+#if N_UARTS
+
+#define SERIAL_USES_PORT(p) (SERIAL_PORT == (p) || SERIAL1_PORT == (p) || SERIAL2_PORT == (p) || SERIAL3_PORT == (p) || \
+                             SERIAL4_PORT == (p) || SERIAL5_PORT == (p) || SERIAL6_PORT == (p) || SERIAL7_PORT == (p))
 
-#if SERIAL1_PORT
+#define SERIAL_PORT_VALID(p) (!(p) || (p) == 1 || (p) == 11 || (p) == 2 || (p) == 21 || (p) == 3 || (p) == 31 || (p) == 32 || \
+                              (p) == 4 || (p) == 41 || (p) == 5 || (p) == 6 || (p) == 61 || (p) == 7 || (p) == 71 || (p) == 8)
 
-#if SERIAL1_PORT == SERIAL_PORT || SERIAL1_PORT == SERIAL2_PORT
+#if !(SERIAL_PORT_VALID(SERIAL_PORT) && SERIAL_PORT_VALID(SERIAL1_PORT) && SERIAL_PORT_VALID(SERIAL2_PORT) && SERIAL_PORT_VALID(SERIAL3_PORT) && \
+      SERIAL_PORT_VALID(SERIAL4_PORT) && SERIAL_PORT_VALID(SERIAL5_PORT) && SERIAL_PORT_VALID(SERIAL6_PORT) && SERIAL_PORT_VALID(SERIAL7_PORT))
+#error Code has to be added to support serial port
+#endif
+
+#define SERIAL_USART_COUNT(n) ((SERIAL_USART(SERIAL_PORT) == (n)) + (SERIAL_USART(SERIAL1_PORT) == (n)) + (SERIAL_USART(SERIAL2_PORT) == (n)) + \
+                               (SERIAL_USART(SERIAL3_PORT) == (n)) + (SERIAL_USART(SERIAL4_PORT) == (n)) + (SERIAL_USART(SERIAL5_PORT) == (n)) + \
+                               (SERIAL_USART(SERIAL6_PORT) == (n)) + (SERIAL_USART(SERIAL7_PORT) == (n)))
+
+#if SERIAL_USART_COUNT(1) > 1 || SERIAL_USART_COUNT(2) > 1 || SERIAL_USART_COUNT(3) > 1 || SERIAL_USART_COUNT(4) > 1 || \
+    SERIAL_USART_COUNT(5) > 1 || SERIAL_USART_COUNT(6) > 1 || SERIAL_USART_COUNT(7) > 1 || SERIAL_USART_COUNT(8) > 1
 #error Conflicting use of UART peripherals!
 #endif
 
-#if (SERIAL1_PORT >= 10 && SERIAL1_PORT < 19)
-#define UART1            usart(1)
-#define UART1_IRQ        usartINT(1)
-#define UART1_IRQHandler usartHANDLER(1)
-#define UART1_CLK_En     usartCLKEN(1)
-#elif (SERIAL1_PORT >= 20 && SERIAL1_PORT < 29)
-#define UART1            usart(2)
-#define UART1_IRQ        usartINT(2)
-#define UART1_IRQHandler usartHANDLER(2)
-#define UART1_CLK_En     usartCLKEN(2)
-#elif (SERIAL1_PORT >= 30 && SERIAL1_PORT < 39)
-#define UART1            usart(3)
-#define UART1_IRQ        usartINT(3)
-#define UART1_IRQHandler usartHANDLER(3)
-#define UART1_CLK_En     usartCLKEN(3)
-#elif (SERIAL1_PORT >= 60 && SERIAL1_PORT < 69)
-#define UART1            usart(6)
-#define UART1_IRQ        usartINT(6)
-#define UART1_IRQHandler usartHANDLER(6)
-#define UART1_CLK_En     usartCLKEN(6)
+// Stream instance from peripheral number, for use with constant peripheral numbers only.
+#define SERIAL_INSTANCE(n) (SERIAL_USART(SERIAL_PORT) == (n) ? 0 : SERIAL_USART(SERIAL1_PORT) == (n) ? 1 : \
+                            SERIAL_USART(SERIAL2_PORT) == (n) ? 2 : SERIAL_USART(SERIAL3_PORT) == (n) ? 3 : \
+                            SERIAL_USART(SERIAL4_PORT) == (n) ? 4 : SERIAL_USART(SERIAL5_PORT) == (n) ? 5 : \
+                            SERIAL_USART(SERIAL6_PORT) == (n) ? 6 : 7)
+#define SERIAL_ISR_ID(n) ((isr_id_t)(ISR_Serial0 + SERIAL_INSTANCE(n)))
+
+// Optional hardware flow control. RTS is a GPIO output driven from the input buffer fill level, CTS the peripheral CTS input
+// gating the transmitter. Add SERIAL_RTS_PORT/SERIAL_RTS_PIN and/or SERIAL_CTS_PORT/SERIAL_CTS_PIN to the board map,
+// prefixed SERIAL1_ and SERIAL2_ for the next instances. The CTS pin must be one mapped to the peripheral.
+
+#if defined(SERIAL_RTS_PIN) || defined(SERIAL_CTS_PIN) || defined(SERIAL1_RTS_PIN) || defined(SERIAL1_CTS_PIN) || defined(SERIAL2_RTS_PIN) || defined(SERIAL2_CTS_PIN)
+#define SERIAL_FLOW_CONTROL 1
 #else
-#define UART1            usart(SERIAL1_PORT)
-#define UART1_IRQ        usartINT(SERIAL1_PORT)
-#define UART1_IRQHandler usartHANDLER(SERIAL1_PORT)
-#define UART1_CLK_En     usartCLKEN(SERIAL1_PORT)
+#define SERIAL_FLOW_CONTROL 0
 #endif
-#if SERIAL1_PORT == 1 || (SERIAL1_PORT >= 10 && SERIAL1_PORT < 19) || SERIAL1_PORT == 6
-#define UART1_CLK HAL_RCC_GetPCLK2Freq()
-#else
-#define UART1_CLK HAL_RCC_GetPCLK1Freq()
-#endif
-
-#if SERIAL1_PORT == 1
-#define UART1_TX_PIN 9
-#define UART1_RX_PIN 10
-#define UART1_PORT GPIOA
-#define UART1_AF GPIO_AF7_USART1
-#elif SERIAL1_PORT == 11
-#define UART1_TX_PIN 6
-#define UART1_RX_PIN 7
-#define UART1_PORT GPIOB
-#define UART1_AF GPIO_AF7_USART1
-#elif SERIAL1_PORT == 2
-#define UART1_TX_PIN 2
-#define UART1_RX_PIN 3
-#define UART1_PORT GPIOA
-#define UART1_AF GPIO_AF7_USART2
-#elif SERIAL1_PORT == 21
-#define UART1_TX_PIN 5
-#define UART1_RX_PIN 6
-#define UART1_PORT GPIOD
-#define UART1_AF GPIO_AF7_USART2
-#elif SERIAL1_PORT == 3
-#define UART1_TX_PIN 10
-#define UART1_RX_PIN 11
-#define UART1_PORT GPIOB
-#define UART1_AF GPIO_AF7_USART3
-#elif SERIAL1_PORT == 31
-#define UART1_TX_PIN 10
-#define UART1_RX_PIN 11
-#define UART1_PORT GPIOC
-#define UART1_AF GPIO_AF7_USART3
-#elif SERIAL1_PORT == 32
-#define UART1_TX_PIN 8
-#define UART1_RX_PIN 9
-#define UART1_PORT GPIOD
-#define UART1_AF GPIO_AF7_USART3
-#elif SERIAL1_PORT == 6
-#define UART1_TX_PIN 6
-#define UART1_RX_PIN 7
-#define UART1_PORT GPIOC
-#define UART1_AF GPIO_AF8_USART6
-#elif SERIAL1_PORT == 61
-#define UART1_TX_PIN 14
-#define UART1_RX_PIN 9
-#define UART1_PORT GPIOG
-#define UART1_AF GPIO_AF8_USART6
-#else
-#error Code has to be added to support serial port 1
+
+#if ((defined(SERIAL1_RTS_PIN) || defined(SERIAL1_CTS_PIN)) && !SERIAL1_PORT) || ((defined(SERIAL2_RTS_PIN) || defined(SERIAL2_CTS_PIN)) && !SERIAL2_PORT)
+#error "Flow control pins declared for a serial port not in use!"
 #endif
 
-#endif // SERIAL1_PORT
+#ifndef RX_BUFFER_HWM
+#define RX_BUFFER_HWM (RX_BUFFER_SIZE - 128) // RTS is deasserted at this fill level, the rest is headroom for characters in flight
+#endif
+#ifndef RX_BUFFER_LWM
+#define RX_BUFFER_LWM (RX_BUFFER_SIZE / 2)   // and asserted again when drained to this level
+#endif
 
-#if SERIAL2_PORT
+// Optional Modbus RTU framing by the peripheral. The transceiver is switched by the driver enable output, the RTS pin
+// of the peripheral declared as RS485_DE_PORT/RS485_DE_PIN in the board map, and received characters are held back
+// from the input buffer until the receiver timeout flags the end of the frame.
 
-#if SERIAL2_PORT == SERIAL_PORT || SERIAL2_PORT == SERIAL1_PORT
-#error Conflicting use of UART peripherals!
+#if MODBUS_HW_FRAMING_ENABLE
+#if !defined(MODBUS_RTU_STREAM) || !defined(RS485_DE_PIN)
+#error "Modbus hardware framing requires MODBUS_RTU_STREAM and the RS485_DE_PORT/RS485_DE_PIN driver enable pin!"
 #endif
-
-#if (SERIAL2_PORT >= 10 && SERIAL2_PORT < 19)
-#define UART2            usart(1)
-#define UART2_IRQ        usartINT(1)
-#define UART2_IRQHandler usartHANDLER(1)
-#define UART2_CLK_En     usartCLKEN(1)
-#elif (SERIAL2_PORT >= 20 && SERIAL2_PORT < 29)
-#define UART2            usart(2)
-#define UART2_IRQ        usartINT(2)
-#define UART2_IRQHandler usartHANDLER(2)
-#define UART2_CLK_En     usartCLKEN(2)
-#elif (SERIAL2_PORT >= 30 && SERIAL2_PORT < 39)
-#define UART2            usart(3)
-#define UART2_IRQ        usartINT(3)
-#define UART2_IRQHandler usartHANDLER(3)
-#define UART2_CLK_En     usartCLKEN(3)
-#elif (SERIAL2_PORT >= 60 && SERIAL2_PORT < 69)
-#define UART2            usart(6)
-#define UART2_IRQ        usartINT(6)
-#define UART2_IRQHandler usartHANDLER(6)
-#define UART2_CLK_En     usartCLKEN(6)
-#else
-#define UART2            usart(SERIAL2_PORT)
-#define UART2_IRQ        usartINT(SERIAL2_PORT)
-#define UART2_IRQHandler usartHANDLER(SERIAL2_PORT)
-#define UART2_CLK_En     usartCLKEN(SERIAL2_PORT)
+#ifdef RS485_DIR_PORT
+#error "RS485_DIR_PORT cannot be used with Modbus hardware framing, use RS485_DE_PORT instead!"
+#endif
+#if RS485_DE_ASSERT_TIME > 31 || RS485_DE_DEASSERT_TIME > 31
+#error "Driver enable assertion and deassertion times cannot exceed 31 sample times!"
 #endif
-#if SERIAL2_PORT == 1 || (SERIAL2_PORT >= 10 && SERIAL2_PORT < 19) || SERIAL2_PORT == 6
-#define UART2_CLK HAL_RCC_GetPCLK2Freq()
-#else
-#define UART2_CLK HAL_RCC_GetPCLK1Freq()
-#endif
-
-#if SERIAL2_PORT == 1
-#define UART2_TX_PIN 9
-#define UART2_RX_PIN 10
-#define UART2_PORT GPIOA
-#define UART2_AF GPIO_AF7_USART1
-#elif SERIAL2_PORT == 11
-#define UART2_TX_PIN 6
-#define UART2_RX_PIN 7
-#define UART2_PORT GPIOB
-#define UART2_AF GPIO_AF7_USART1
-#elif SERIAL2_PORT == 2
-#define UART2_TX_PIN 2
-#define UART2_RX_PIN 3
-#define UART2_PORT GPIOA
-#define UART2_AF GPIO_AF7_USART2
-#elif SERIAL2_PORT == 21
-#define UART2_TX_PIN 5
-#define UART2_RX_PIN 6
-#define UART2_PORT GPIOD
-#define UART2_AF GPIO_AF7_USART2
-#elif SERIAL2_PORT == 3
-#define UART2_TX_PIN 10
-#define UART2_RX_PIN 11
-#define UART2_PORT GPIOB
-#define UART2_AF GPIO_AF7_USART3
-#elif SERIAL2_PORT == 31
-#define UART2_TX_PIN 10
-#define UART2_RX_PIN 11
-#define UART2_PORT GPIOC
-#define UART2_AF GPIO_AF7_USART3
-#elif SERIAL2_PORT == 32
-#define UART2_TX_PIN 8
-#define UART2_RX_PIN 9
-#define UART2_PORT GPIOD
-#define UART2_AF GPIO_AF7_USART3
-#elif SERIAL2_PORT == 6
-#define UART2_TX_PIN 6
-#define UART2_RX_PIN 7
-#define UART2_PORT GPIOC
-#define UART2_AF GPIO_AF8_USART6
-#elif SERIAL2_PORT == 61
-#define UART2_TX_PIN 14
-#define UART2_RX_PIN 9
-#define UART2_PORT GPIOG
-#define UART2_AF GPIO_AF8_USART6
-#else
-#error Code has to be added to support serial port 2
 #endif
 
-#endif // SERIAL2_PORT
+#if SERIAL_RX_DMA_ENABLE || SERIAL_TX_DMA_ENABLE
 
-#if SERIAL_PORT
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
 
-static bool uart_release (uint8_t instance);
-static const io_stream_status_t *get_uart_status (uint8_t instance);
+#define DMAhandler(d, s) DMAhandlerI(d, s)
+#define DMAhandlerI(d, s) DMA ## d ## _Stream ## s ## _IRQHandler
 
-static io_stream_status_t stream_status[] = {
-#if SERIAL_PORT
-    {
-        .baud_rate = 115200,
-        .format = {
-            .width = Serial_8bit,
-            .stopbits = Serial_StopBits1,
-            .parity = Serial_ParityNone,
-        }
-    },
-#endif
-#if SERIAL1_PORT
-    {
-        .baud_rate = 115200,
-        .format = {
-            .width = Serial_8bit,
-            .stopbits = Serial_StopBits1,
-            .parity = Serial_ParityNone,
-        }
-    },
-#endif
-#if SERIAL2_PORT
-    {
-        .baud_rate = 115200,
-        .format = {
-            .width = Serial_8bit,
-            .stopbits = Serial_StopBits1,
-            .parity = Serial_ParityNone,
-        }
-    }
-#endif
+typedef struct {
+    uint8_t d;      // DMA controller, 0 if none available
+    uint8_t s;      // stream
+    uint32_t ch;    // channel select
+} uart_dma_map_t;
+
+static DMA_Stream_TypeDef *const dma_stream[2][8] = {
+    { DMA1_Stream0, DMA1_Stream1, DMA1_Stream2, DMA1_Stream3, DMA1_Stream4, DMA1_Stream5, DMA1_Stream6, DMA1_Stream7 },
+    { DMA2_Stream0, DMA2_Stream1, DMA2_Stream2, DMA2_Stream3, DMA2_Stream4, DMA2_Stream5, DMA2_Stream6, DMA2_Stream7 }
 };
 
-static io_stream_properties_t serial[] = {
-#if SERIAL_PORT
-    {
-      .type = StreamType_Serial,
-      .instance = 0,
-      .flags.claimable = On,
-      .flags.claimed = Off,
-      .flags.can_set_baud = On,
-      .flags.modbus_ready = On,
-      .claim = serialInit,
-      .release = uart_release,
-      .get_status = get_uart_status
-    },
-#endif
-#if SERIAL1_PORT
-    {
-      .type = StreamType_Serial,
-      .instance = 1,
-      .flags.claimable = On,
-      .flags.claimed = Off,
-      .flags.can_set_baud = On,
-      .flags.modbus_ready = On,
-      .claim = serial1Init,
-      .release = uart_release,
-      .get_status = get_uart_status
-    },
-#endif
-#if SERIAL2_PORT
-    {
-      .type = StreamType_Serial,
-      .instance = 2,
-      .flags.claimable = On,
-      .flags.claimed = Off,
-      .flags.can_set_baud = On,
-      .flags.modbus_ready = On,
-      .claim = serial2Init,
-      .release = uart_release,
-      .get_status = get_uart_status
-    }
-#endif
+static const IRQn_Type dma_irq[2][8] = {
+    { DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn, DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn },
+    { DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn, DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn }
 };
 
-void serialRegisterStreams (void)
+static inline void serial_dma_flags_clear (DMA_TypeDef *dma, uint8_t stream_n)
 {
-    static io_stream_details_t streams = {
-        .n_streams = sizeof(serial) / sizeof(io_stream_properties_t),
-        .streams = serial,
-    };
+    static const uint8_t shift[] = { 0, 6, 16, 22 };
 
-#if SERIAL_PORT
+    uint32_t flags = (DMA_LIFCR_CTCIF0|DMA_LIFCR_CHTIF0|DMA_LIFCR_CTEIF0|DMA_LIFCR_CDMEIF0|DMA_LIFCR_CFEIF0) << shift[stream_n & 0x03];
 
-    static const periph_pin_t tx0 = {
-        .function = Output_TX,
-        .group = PinGroup_UART1,
-        .port  = UART0_PORT,
-        .pin   = UART0_TX_PIN,
-        .mode  = { .mask = PINMODE_OUTPUT }
-    };
+    if(stream_n < 4)
+        dma->LIFCR = flags;
+    else
+        dma->HIFCR = flags;
+}
 
-    static const periph_pin_t rx0 = {
-        .function = Input_RX,
-        .group = PinGroup_UART1,
-        .port = UART0_PORT,
-        .pin = UART0_RX_PIN,
-        .mode = { .mask = PINMODE_NONE }
-    };
+static inline void serial_dma_disable (DMA_Stream_TypeDef *stream)
+{
+    stream->CR &= ~DMA_SxCR_EN;
+    while(stream->CR & DMA_SxCR_EN);
+}
 
-    hal.periph_port.register_pin(&rx0);
-    hal.periph_port.register_pin(&tx0);
+#endif
+
+#if SERIAL_RX_DMA_ENABLE
 
+// USART/UART RX DMA request mapping, Un_RX_DMA_D is 0 when the stream is in use elsewhere and the port falls back to
+// interrupt driven reception. DMA2 streams 5 and 6 are used by the DMA sampler, DMA2 stream 1 by SPI4, DMA2 stream 2 by SPI1,
+// DMA1 stream 2 by SPI3 and DMA1 stream 3 by SPI2.
+
+#if DMA_SAMPLER_ENABLE
+#if SPI_ENABLE && (SPI_PORT == 1 || SPI_PORT == 11 || SPI_PORT == 12)
+#define U1_RX_DMA_D  0
+#else
+#define U1_RX_DMA_D  2
 #endif
+#define U1_RX_DMA_S  2
+#else
+#define U1_RX_DMA_D  2
+#define U1_RX_DMA_S  5
+#endif
+#define U1_RX_DMA_CH DMA_CHANNEL_4
 
-#if SERIAL1_PORT
+#define U2_RX_DMA_D  1
+#define U2_RX_DMA_S  5
+#define U2_RX_DMA_CH DMA_CHANNEL_4
 
-    static const periph_pin_t tx1 = {
-        .function = Output_TX,
-        .group = PinGroup_UART2,
-        .port  = UART1_PORT,
-        .pin   = UART1_TX_PIN,
-        .mode  = { .mask = PINMODE_OUTPUT }
-    };
+#define U3_RX_DMA_D  1
+#define U3_RX_DMA_S  1
+#define U3_RX_DMA_CH DMA_CHANNEL_4
 
-    static const periph_pin_t rx1 = {
-        .function = Input_RX,
-        .group = PinGroup_UART2,
-        .port = UART1_PORT,
-        .pin = UART1_RX_PIN,
-        .mode = { .mask = PINMODE_NONE }
-    };
+#if SPI_ENABLE && SPI_PORT == 3
+#define U4_RX_DMA_D  0
+#else
+#define U4_RX_DMA_D  1
+#endif
+#define U4_RX_DMA_S  2
+#define U4_RX_DMA_CH DMA_CHANNEL_4
+
+#define U5_RX_DMA_D  1
+#define U5_RX_DMA_S  0
+#define U5_RX_DMA_CH DMA_CHANNEL_4
+
+#if SPI_ENABLE && SPI_PORT == 4
+#if U1_RX_DMA_D == 2 && U1_RX_DMA_S == 2 && SERIAL_USES_USART(1)
+#define U6_RX_DMA_D  0
+#else
+#define U6_RX_DMA_D  2
+#endif
+#define U6_RX_DMA_S  2
+#else
+#define U6_RX_DMA_D  2
+#define U6_RX_DMA_S  1
+#endif
+#define U6_RX_DMA_CH DMA_CHANNEL_5
 
-    hal.periph_port.register_pin(&rx1);
-    hal.periph_port.register_pin(&tx1);
+#if (SPI_ENABLE && SPI_PORT == 2) || (SERIAL_TX_DMA_ENABLE && SERIAL_USES_USART(3))
+#define U7_RX_DMA_D  0
+#else
+#define U7_RX_DMA_D  1
+#endif
+#define U7_RX_DMA_S  3
+#define U7_RX_DMA_CH DMA_CHANNEL_5
 
+#if SERIAL_TX_DMA_ENABLE && SERIAL_USES_USART(2)
+#define U8_RX_DMA_D  0
+#else
+#define U8_RX_DMA_D  1
 #endif
+#define U8_RX_DMA_S  6
+#define U8_RX_DMA_CH DMA_CHANNEL_5
 
-#if SERIAL2_PORT
+#define UART_RX_DMA(n) .rx_dma = { .d = U ## n ## _RX_DMA_D, .s = U ## n ## _RX_DMA_S, .ch = U ## n ## _RX_DMA_CH },
 
-    static const periph_pin_t tx2 = {
-        .function = Output_TX,
-        .group = PinGroup_UART3,
-        .port  = UART2_PORT,
-        .pin   = UART2_TX_PIN,
-        .mode  = { .mask = PINMODE_OUTPUT }
-    };
+#else
 
-    static const periph_pin_t rx2 = {
-        .function = Input_RX,
-        .group = PinGroup_UART3,
-        .port = UART2_PORT,
-        .pin = UART2_RX_PIN,
-        .mode = { .mask = PINMODE_NONE }
-    };
+#define UART_RX_DMA(n)
+
+#endif // SERIAL_RX_DMA_ENABLE
 
-    hal.periph_port.register_pin(&rx2);
-    hal.periph_port.register_pin(&tx2);
+#if SERIAL_TX_DMA_ENABLE
 
+// USART/UART TX DMA request mapping, Un_TX_DMA_D is 0 when the stream is in use elsewhere and the port falls back to
+// interrupt driven transmission. DMA2 streams 4 and 7 are used by STEP_DMA, DMA2 stream 6 by the DMA sampler,
+// DMA1 stream 4 by SPI2 and neopixels on SPI2 and DMA1 stream 7 by SPI3 and neopixels on SPI3.
+
+#if STEP_DMA_ENABLE
+#define U1_TX_DMA_D  0
+#else
+#define U1_TX_DMA_D  2
 #endif
+#define U1_TX_DMA_S  7
+#define U1_TX_DMA_CH DMA_CHANNEL_4
 
-    stream_register_streams(&streams);
-}
+#define U2_TX_DMA_D  1
+#define U2_TX_DMA_S  6
+#define U2_TX_DMA_CH DMA_CHANNEL_4
 
-static const io_stream_status_t *get_uart_status (uint8_t instance)
-{
-    stream_status[instance].flags = serial[instance].flags;
+#if SPI_ENABLE && SPI_PORT == 2
+#define U3_TX_DMA_D  0
+#else
+#define U3_TX_DMA_D  1
+#endif
+#define U3_TX_DMA_S  3
+#define U3_TX_DMA_CH DMA_CHANNEL_4
 
-    return &stream_status[instance];
-}
+#if (SPI_ENABLE && SPI_PORT == 2) || (defined(NEOPIXEL_SPI) && NEOPIXEL_SPI == 2)
+#define U4_TX_DMA_D  0
+#else
+#define U4_TX_DMA_D  1
+#endif
+#define U4_TX_DMA_S  4
+#define U4_TX_DMA_CH DMA_CHANNEL_4
 
-static bool uart_release (uint8_t instance)
-{
-    bool ok;
+#if (SPI_ENABLE && SPI_PORT == 3) || (defined(NEOPIXEL_SPI) && NEOPIXEL_SPI == 3)
+#define U5_TX_DMA_D  0
+#else
+#define U5_TX_DMA_D  1
+#endif
+#define U5_TX_DMA_S  7
+#define U5_TX_DMA_CH DMA_CHANNEL_4
 
-    if((ok = serial[instance].flags.claimed))
-        serial[instance].flags.claimed = Off;
+#if DMA_SAMPLER_ENABLE
+#if STEP_DMA_ENABLE || SERIAL_USES_USART(1)
+#define U6_TX_DMA_D  0
+#else
+#define U6_TX_DMA_D  2
+#endif
+#define U6_TX_DMA_S  7
+#else
+#define U6_TX_DMA_D  2
+#define U6_TX_DMA_S  6
+#endif
+#define U6_TX_DMA_CH DMA_CHANNEL_5
 
-    return ok;
-}
+#if SERIAL_RX_DMA_ENABLE && SERIAL_USES_USART(3)
+#define U7_TX_DMA_D  0
+#else
+#define U7_TX_DMA_D  1
+#endif
+#define U7_TX_DMA_S  1
+#define U7_TX_DMA_CH DMA_CHANNEL_5
 
-#ifdef RS485_DIR_PORT
+#if SERIAL_RX_DMA_ENABLE && SERIAL_USES_USART(5)
+#define U8_TX_DMA_D  0
+#else
+#define U8_TX_DMA_D  1
+#endif
+#define U8_TX_DMA_S  0
+#define U8_TX_DMA_CH DMA_CHANNEL_5
 
-static void rs485SetDirection (bool tx)
-{
-    DIGITAL_OUT(RS485_DIR_PORT, RS485_DIR_PIN, tx);
-}
+#define UART_TX_DMA(n) .tx_dma = { .d = U ## n ## _TX_DMA_D, .s = U ## n ## _TX_DMA_S, .ch = U ## n ## _TX_DMA_CH },
 
-#endif // RS485_DIR_PORT
+#else
 
+#define UART_TX_DMA(n)
+
+#endif // SERIAL_TX_DMA_ENABLE
+
+#if SERIAL_FLOW_CONTROL
+
+#ifdef SERIAL_RTS_PIN
+#define UART0_RTS .rts_port = SERIAL_RTS_PORT, .rts_pin = SERIAL_RTS_PIN,
 #else
+#define UART0_RTS .rts_port = NULL,
+#endif
+#ifdef SERIAL_CTS_PIN
+#define UART0_CTS .cts_port = SERIAL_CTS_PORT, .cts_pin = SERIAL_CTS_PIN,
+#else
+#define UART0_CTS .cts_port = NULL,
+#endif
 
-void serialRegisterStreams (void) {}; // No serial ports!
+#ifdef SERIAL1_RTS_PIN
+#define UART1_RTS .rts_port = SERIAL1_RTS_PORT, .rts_pin = SERIAL1_RTS_PIN,
+#else
+#define UART1_RTS .rts_port = NULL,
+#endif
+#ifdef SERIAL1_CTS_PIN
+#define UART1_CTS .cts_port = SERIAL1_CTS_PORT, .cts_pin = SERIAL1_CTS_PIN,
+#else
+#define UART1_CTS .cts_port = NULL,
+#endif
 
+#ifdef SERIAL2_RTS_PIN
+#define UART2_RTS .rts_port = SERIAL2_RTS_PORT, .rts_pin = SERIAL2_RTS_PIN,
+#else
+#define UART2_RTS .rts_port = NULL,
+#endif
+#ifdef SERIAL2_CTS_PIN
+#define UART2_CTS .cts_port = SERIAL2_CTS_PORT, .cts_pin = SERIAL2_CTS_PIN,
+#else
+#define UART2_CTS .cts_port = NULL,
 #endif
 
-#if SERIAL_PORT
+typedef struct {
+    GPIO_TypeDef *rts_port;
+    uint8_t rts_pin;
+    GPIO_TypeDef *cts_port;
+    uint8_t cts_pin;
+} uart_flow_map_t;
+
+static const uart_flow_map_t uart_flow_map[] = {
+    { UART0_RTS UART0_CTS },
+#if N_UARTS > 1
+    { UART1_RTS UART1_CTS },
+#endif
+#if N_UARTS > 2
+    { UART2_RTS UART2_CTS },
+#endif
+};
 
-//
-// Returns number of free characters in serial input buffer
-//
-static uint16_t serialRxFree (void)
+#endif // SERIAL_FLOW_CONTROL
+
+typedef struct {
+    uint8_t port;               // SERIAL_PORT code, see serial.h
+    USART_TypeDef *uart;
+    IRQn_Type irq;
+    __IO uint32_t *rcc_enr;
+    uint32_t rcc_en;
+    bool apb2;
+    GPIO_TypeDef *tx_port;
+    uint8_t tx_pin;
+    GPIO_TypeDef *rx_port;
+    uint8_t rx_pin;
+    uint8_t af;
+#if SERIAL_RX_DMA_ENABLE
+    uart_dma_map_t rx_dma;
+#endif
+#if SERIAL_TX_DMA_ENABLE
+    uart_dma_map_t tx_dma;
+#endif
+} uart_map_t;
+
+// Only ports in use are added to the table.
+static const uart_map_t uart_map[] = {
+#if SERIAL_USES_PORT(1)
+    { .port = 1,  .uart = USART1, .irq = USART1_IRQn, .rcc_enr = &RCC->APB2ENR, .rcc_en = RCC_APB2ENR_USART1EN, .apb2 = true,  .tx_port = GPIOA, .tx_pin = 9,  .rx_port = GPIOA, .rx_pin = 10, .af = GPIO_AF7_USART1, UART_RX_DMA(1) UART_TX_DMA(1) },
+#endif
+#if SERIAL_USES_PORT(11)
+    { .port = 11, .uart = USART1, .irq = USART1_IRQn, .rcc_enr = &RCC->APB2ENR, .rcc_en = RCC_APB2ENR_USART1EN, .apb2 = true,  .tx_port = GPIOB, .tx_pin = 6,  .rx_port = GPIOB, .rx_pin = 7,  .af = GPIO_AF7_USART1, UART_RX_DMA(1) UART_TX_DMA(1) },
+#endif
+#if SERIAL_USES_PORT(2)
+    { .port = 2,  .uart = USART2, .irq = USART2_IRQn, .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_USART2EN, .apb2 = false, .tx_port = GPIOA, .tx_pin = 2,  .rx_port = GPIOA, .rx_pin = 3,  .af = GPIO_AF7_USART2, UART_RX_DMA(2) UART_TX_DMA(2) },
+#endif
+#if SERIAL_USES_PORT(21)
+    { .port = 21, .uart = USART2, .irq = USART2_IRQn, .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_USART2EN, .apb2 = false, .tx_port = GPIOD, .tx_pin = 5,  .rx_port = GPIOD, .rx_pin = 6,  .af = GPIO_AF7_USART2, UART_RX_DMA(2) UART_TX_DMA(2) },
+#endif
+#if SERIAL_USES_PORT(3)
+    { .port = 3,  .uart = USART3, .irq = USART3_IRQn, .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_USART3EN, .apb2 = false, .tx_port = GPIOB, .tx_pin = 10, .rx_port = GPIOB, .rx_pin = 11, .af = GPIO_AF7_USART3, UART_RX_DMA(3) UART_TX_DMA(3) },
+#endif
+#if SERIAL_USES_PORT(31)
+    { .port = 31, .uart = USART3, .irq = USART3_IRQn, .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_USART3EN, .apb2 = false, .tx_port = GPIOC, .tx_pin = 10, .rx_port = GPIOC, .rx_pin = 11, .af = GPIO_AF7_USART3, UART_RX_DMA(3) UART_TX_DMA(3) },
+#endif
+#if SERIAL_USES_PORT(32)
+    { .port = 32, .uart = USART3, .irq = USART3_IRQn, .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_USART3EN, .apb2 = false, .tx_port = GPIOD, .tx_pin = 8,  .rx_port = GPIOD, .rx_pin = 9,  .af = GPIO_AF7_USART3, UART_RX_DMA(3) UART_TX_DMA(3) },
+#endif
+#if SERIAL_USES_PORT(4)
+    { .port = 4,  .uart = UART4,  .irq = UART4_IRQn,  .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_UART4EN,  .apb2 = false, .tx_port = GPIOA, .tx_pin = 0,  .rx_port = GPIOA, .rx_pin = 1,  .af = GPIO_AF8_UART4,  UART_RX_DMA(4) UART_TX_DMA(4) },
+#endif
+#if SERIAL_USES_PORT(41)
+    { .port = 41, .uart = UART4,  .irq = UART4_IRQn,  .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_UART4EN,  .apb2 = false, .tx_port = GPIOC, .tx_pin = 10, .rx_port = GPIOC, .rx_pin = 11, .af = GPIO_AF8_UART4,  UART_RX_DMA(4) UART_TX_DMA(4) },
+#endif
+#if SERIAL_USES_PORT(5)
+    { .port = 5,  .uart = UART5,  .irq = UART5_IRQn,  .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_UART5EN,  .apb2 = false, .tx_port = GPIOC, .tx_pin = 12, .rx_port = GPIOD, .rx_pin = 2,  .af = GPIO_AF8_UART5,  UART_RX_DMA(5) UART_TX_DMA(5) },
+#endif
+#if SERIAL_USES_PORT(6)
+    { .port = 6,  .uart = USART6, .irq = USART6_IRQn, .rcc_enr = &RCC->APB2ENR, .rcc_en = RCC_APB2ENR_USART6EN, .apb2 = true,  .tx_port = GPIOC, .tx_pin = 6,  .rx_port = GPIOC, .rx_pin = 7,  .af = GPIO_AF8_USART6, UART_RX_DMA(6) UART_TX_DMA(6) },
+#endif
+#if SERIAL_USES_PORT(61)
+    { .port = 61, .uart = USART6, .irq = USART6_IRQn, .rcc_enr = &RCC->APB2ENR, .rcc_en = RCC_APB2ENR_USART6EN, .apb2 = true,  .tx_port = GPIOG, .tx_pin = 14, .rx_port = GPIOG, .rx_pin = 9,  .af = GPIO_AF8_USART6, UART_RX_DMA(6) UART_TX_DMA(6) },
+#endif
+#if SERIAL_USES_PORT(7)
+    { .port = 7,  .uart = UART7,  .irq = UART7_IRQn,  .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_UART7EN,  .apb2 = false, .tx_port = GPIOF, .tx_pin = 7,  .rx_port = GPIOF, .rx_pin = 6,  .af = GPIO_AF8_UART7,  UART_RX_DMA(7) UART_TX_DMA(7) },
+#endif
+#if SERIAL_USES_PORT(71)
+    { .port = 71, .uart = UART7,  .irq = UART7_IRQn,  .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_UART7EN,  .apb2 = false, .tx_port = GPIOE, .tx_pin = 8,  .rx_port = GPIOE, .rx_pin = 7,  .af = GPIO_AF8_UART7,  UART_RX_DMA(7) UART_TX_DMA(7) },
+#endif
+#if SERIAL_USES_PORT(8)
+    { .port = 8,  .uart = UART8,  .irq = UART8_IRQn,  .rcc_enr = &RCC->APB1ENR, .rcc_en = RCC_APB1ENR_UART8EN,  .apb2 = false, .tx_port = GPIOE, .tx_pin = 1,  .rx_port = GPIOE, .rx_pin = 0,  .af = GPIO_AF8_UART8,  UART_RX_DMA(8) UART_TX_DMA(8) },
+#endif
+};
+
+#if SERIAL_RX_DMA_ENABLE
+
+// Received characters are transferred by DMA to a circular landing buffer. On the idle line interrupt and the DMA half
+// and full transfer interrupts the new characters are scanned for realtime commands and the rest copied to the stream buffer.
+// Realtime command latency is estimated from the number of characters received after the command.
+
+typedef struct {
+    uint32_t irqs;
+    uint32_t bytes;
+    uint32_t rt_commands;
+    uint32_t rt_latency_max;    // CPU cycles
+    uint64_t rt_latency_sum;    // CPU cycles
+} serial_rx_stats_t;
+
+typedef struct {
+    USART_TypeDef *uart;
+    DMA_TypeDef *dma;
+    DMA_Stream_TypeDef *stream; // NULL if interrupt driven
+    uint8_t stream_n;
+    uint32_t channel;
+    IRQn_Type irq;
+    uint8_t *data;
+    stream_rx_buffer_t *rxbuf;
+    volatile uint_fast16_t *head;   // input buffer head, or the head of the frame being received when framing
+    enqueue_realtime_command_ptr *enqueue_realtime_command;
+    uint_fast16_t tail;
+    uint32_t char_cycles;
+    serial_rx_stats_t stats;
+} serial_rx_dma_t;
+
+static DMA_DATA uint8_t rx_dma_buf[N_UARTS][SERIAL_RX_DMA_SIZE];
+
+static void serial_rx_dma_init (serial_rx_dma_t *rx)
 {
-    uint16_t tail = rxbuf.tail, head = rxbuf.head;
+    if(rx->dma == DMA1)
+        __HAL_RCC_DMA1_CLK_ENABLE();
+    else
+        __HAL_RCC_DMA2_CLK_ENABLE();
 
-    return (RX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, RX_BUFFER_SIZE);
+    serial_dma_disable(rx->stream);
+    serial_dma_flags_clear(rx->dma, rx->stream_n);
+
+    rx->tail = 0;
+    rx->stream->PAR = (uint32_t)&rx->uart->RDR;
+    rx->stream->M0AR = (uint32_t)rx->data;
+    rx->stream->NDTR = SERIAL_RX_DMA_SIZE;
+    rx->stream->FCR = 0;
+    rx->stream->CR = rx->channel|DMA_SxCR_PL_1|DMA_SxCR_MINC|DMA_SxCR_CIRC|DMA_SxCR_HTIE|DMA_SxCR_TCIE|DMA_SxCR_EN;
+
+    HAL_NVIC_SetPriority(rx->irq, 1, 0);
+    HAL_NVIC_EnableIRQ(rx->irq);
 }
 
-//
-// Returns number of characters in serial input buffer
-//
-static uint16_t serialRxCount (void)
+// Discards characters received by DMA but not yet moved to the input buffer, call with interrupts disabled.
+static inline void serial_rx_dma_discard (serial_rx_dma_t *rx)
 {
-    uint32_t tail = rxbuf.tail, head = rxbuf.head;
-
-    return BUFCOUNT(head, tail, RX_BUFFER_SIZE);
+    rx->tail = (SERIAL_RX_DMA_SIZE - rx->stream->NDTR) & (SERIAL_RX_DMA_SIZE - 1);
 }
 
-//
-// Flushes the serial input buffer
-//
-static void serialRxFlush (void)
+// Discards unprocessed characters and updates the character time used for the latency estimate.
+static void serial_rx_dma_reset (serial_rx_dma_t *rx, uint32_t baud_rate, serial_format_t format)
 {
-    rxbuf.tail = rxbuf.head;
+    serial_rx_dma_discard(rx);
+    rx->char_cycles = (SystemCoreClock / baud_rate) * (format.parity == Serial_ParityNone ? 10 : 11);
 }
 
-//
-// Flushes and adds a CAN character to the serial input buffer
-//
-static void serialRxCancel (void)
+static inline void serial_rx_dma_enable (serial_rx_dma_t *rx, bool on)
 {
-    rxbuf.data[rxbuf.head] = ASCII_CAN;
-    rxbuf.tail = rxbuf.head;
-    rxbuf.head = BUFNEXT(rxbuf.head, rxbuf);
+    if(on)
+        rx->uart->CR3 |= USART_CR3_DMAR;
+    else
+        rx->uart->CR3 &= ~USART_CR3_DMAR;
 }
 
-//
-// Writes a character to the serial output stream
-//
-static bool serialPutC (const uint8_t c)
+ISR_CODE static void serial_rx_dma_process (serial_rx_dma_t *rx, uint32_t t_irq, bool idle)
 {
-    uint16_t next_head = BUFNEXT(txbuf.head, txbuf);    // Get pointer to next free slot in buffer
+    uint_fast16_t head = (SERIAL_RX_DMA_SIZE - rx->stream->NDTR) & (SERIAL_RX_DMA_SIZE - 1), tail = rx->tail;
+    stream_rx_buffer_t *rxbuf = rx->rxbuf;
+
+    rx->stats.irqs++;
+
+    while(tail != head) {
+
+        uint8_t c = rx->data[tail];
+
+        if((*rx->enqueue_realtime_command)(c)) {
+            // characters received after the command plus the idle frame if detected by the idle line interrupt
+            uint32_t latency = (((head - tail - 1) & (SERIAL_RX_DMA_SIZE - 1)) + (idle ? 1 : 0)) * rx->char_cycles + (DWT->CYCCNT - t_irq);
+            rx->stats.rt_commands++;
+            rx->stats.rt_latency_sum += latency;
+            if(latency > rx->stats.rt_latency_max)
+                rx->stats.rt_latency_max = latency;
+        } else {
+            uint_fast16_t head = *rx->head, next_head = BUFNEXT(head, (*rxbuf));
+            if(next_head == rxbuf->tail)
+                rxbuf->overflow = 1;
+            else {
+                rxbuf->data[head] = c;
+                *rx->head = next_head;
+            }
+        }
 
-    while(txbuf.tail == next_head) {                    // While TX buffer full
-        if(!hal.stream_blocking_callback())             // check if blocking for space,
-            return false;                               // exit if not (leaves TX buffer in an inconsistent state)
+        tail = (tail + 1) & (SERIAL_RX_DMA_SIZE - 1);
+        rx->stats.bytes++;
     }
-    txbuf.data[txbuf.head] = c;                         // Add data to buffer,
-    txbuf.head = next_head;                             // update head pointer and
-    UART0->CR1 |= USART_CR1_TXEIE;                      // enable TX interrupts
 
-    return true;
+    rx->tail = tail;
 }
 
-//
-// Writes a null terminated string to the serial output stream, blocks if buffer full
-//
-static void serialWriteS (const char *s)
+ISR_CODE static void serial_rx_dma_irq (serial_rx_dma_t *rx)
 {
-    char c, *ptr = (char *)s;
+    uint32_t t_irq = DWT->CYCCNT;
 
-    while((c = *ptr++) != '\0')
-        serialPutC((uint8_t)c);
+    serial_dma_flags_clear(rx->dma, rx->stream_n);
+    serial_rx_dma_process(rx, t_irq, false);
 }
 
-//
-// Writes a number of characters from string to the serial output stream followed by EOL, blocks if buffer full
-//
-static void serialWrite (const uint8_t *s, uint16_t length)
+#endif // SERIAL_RX_DMA_ENABLE
+
+#if SERIAL_TX_DMA_ENABLE
+
+// Written data is copied to the stream buffer in contiguous blocks and transmitted by DMA from the buffer tail up to
+// the head or the end of the buffer, whichever comes first. The transfer complete interrupt advances the tail and
+// chains the next chunk, a wrapped buffer is thus sent as two transfers. Writes start a transfer by pending the DMA
+// interrupt when no transfer is in progress.
+
+typedef struct {
+    uint32_t irqs;
+    uint32_t bytes;
+    uint32_t chunks;
+    uint32_t errors;
+} serial_tx_stats_t;
+
+typedef struct {
+    USART_TypeDef *uart;
+    DMA_TypeDef *dma;
+    DMA_Stream_TypeDef *stream; // NULL if interrupt driven
+    uint8_t stream_n;
+    uint32_t channel;
+    IRQn_Type irq;
+    stream_tx_buffer_t *txbuf;
+    volatile bool busy;
+    uint_fast16_t chunk;
+    serial_tx_stats_t stats;
+} serial_tx_dma_t;
+
+static void serial_tx_dma_init (serial_tx_dma_t *tx)
 {
-    uint8_t *ptr = (uint8_t *)s;
+    if(tx->dma == DMA1)
+        __HAL_RCC_DMA1_CLK_ENABLE();
+    else
+        __HAL_RCC_DMA2_CLK_ENABLE();
 
-    while(length--)
-        serialPutC(*ptr++);
-}
+    serial_dma_disable(tx->stream);
+    serial_dma_flags_clear(tx->dma, tx->stream_n);
 
-//
-// Flushes the serial output buffer
-//
-static void serialTxFlush (void)
-{
-    UART0->CR1 &= ~USART_CR1_TXEIE;     // Disable TX interrupts
-    txbuf.tail = txbuf.head;
+    tx->busy = false;
+    tx->stream->PAR = (uint32_t)&tx->uart->TDR;
+    tx->stream->FCR = 0;
+    tx->stream->CR = tx->channel|DMA_SxCR_PL_0|DMA_SxCR_DIR_0|DMA_SxCR_MINC|DMA_SxCR_TCIE|DMA_SxCR_TEIE|DMA_SxCR_DMEIE;
+
+    HAL_NVIC_SetPriority(tx->irq, 1, 0);
+    HAL_NVIC_EnableIRQ(tx->irq);
 }
 
-//
-// Returns number of characters pending transmission
-//
-static uint16_t serialTxCount (void)
+ISR_CODE static void serial_tx_dma_irq (serial_tx_dma_t *tx)
 {
-    uint32_t tail = txbuf.tail, head = txbuf.head;
+    static const uint8_t shift[] = { 0, 6, 16, 22 };
 
-    return BUFCOUNT(head, tail, TX_BUFFER_SIZE) + (UART0->ISR & USART_ISR_TC ? 0 : 1);
-}
+    uint32_t flags = (tx->stream_n < 4 ? tx->dma->LISR : tx->dma->HISR) >> shift[tx->stream_n & 0x03];
 
-//
-// serialGetC - returns -1 if no data available
-//
-static int32_t serialGetC (void)
-{
-    uint_fast16_t tail = rxbuf.tail;            // Get buffer pointer
+    serial_dma_flags_clear(tx->dma, tx->stream_n);
 
-    if(tail == rxbuf.head)
-        return -1; // no data available
+    tx->stats.irqs++;
 
-    int32_t data = (int32_t)rxbuf.data[tail];   // Get next character
-    rxbuf.tail = BUFNEXT(tail, rxbuf);          // and update pointer
+    if(tx->busy) {
+        if(flags & (DMA_LISR_TEIF0|DMA_LISR_DMEIF0)) {
+            // Transfer aborted, keep the characters sent and restart from the first one not transferred.
+            serial_dma_disable(tx->stream);
+            tx->chunk -= tx->stream->NDTR;
+            tx->stats.errors++;
+        } else if(!(flags & DMA_LISR_TCIF0))
+            return;
+        tx->txbuf->tail = (tx->txbuf->tail + tx->chunk) & (TX_BUFFER_SIZE - 1);
+        tx->stats.bytes += tx->chunk;
+        tx->busy = false;
+    }
 
-    return data;
-}
+    uint_fast16_t tail = tx->txbuf->tail, head = tx->txbuf->head;
 
-static bool serialSuspendInput (bool suspend)
-{
-    return stream_rx_suspend(&rxbuf, suspend);
+    if(tail != head) {
+        tx->chunk = (head > tail ? head : TX_BUFFER_SIZE) - tail;
+        tx->stream->M0AR = (uint32_t)&tx->txbuf->data[tail];
+        tx->stream->NDTR = tx->chunk;
+        tx->busy = true;
+        tx->stats.chunks++;
+        tx->stream->CR |= DMA_SxCR_EN;
+    }
 }
 
-static bool serialSetBaudRate (uint32_t baud_rate)
+// Copies data to the stream buffer in contiguous blocks, blocks if buffer full.
+static bool serial_tx_dma_write (serial_tx_dma_t *tx, const uint8_t *s, uint_fast16_t length)
 {
-    stream_status[0].baud_rate = baud_rate;
+    stream_tx_buffer_t *txbuf = tx->txbuf;
+    uint_fast16_t head, n;
 
-    UART0->CR1 &= ~(USART_CR1_UE|USART_CR1_RXNEIE|USART_CR1_RE|USART_CR1_TE);
-    UART0->CR3 = USART_CR3_OVRDIS;
-    UART0->BRR = UART_DIV_SAMPLING16(UART0_CLK, baud_rate);
-    UART0->CR1 |= (USART_CR1_UE|USART_CR1_RXNEIE|USART_CR1_RE|USART_CR1_TE);
+    while(length) {
 
-    rxbuf.tail = rxbuf.head;
-    txbuf.tail = txbuf.head;
+        head = txbuf->head;
 
-    return true;
-}
-
-static bool serialSetFormat (serial_format_t format)
-{
-    stream_status[0].format = format;
+        if((n = (TX_BUFFER_SIZE - 1) - BUFCOUNT(head, txbuf->tail, TX_BUFFER_SIZE)) == 0) {
+            if(!hal.stream_blocking_callback())
+                return false;
+            continue;
+        }
 
-    UART0->CR1 &= ~(USART_CR1_M|USART_CR1_PCE|USART_CR1_PS|USART_CR1_UE);
+        if(n > TX_BUFFER_SIZE - head)
+            n = TX_BUFFER_SIZE - head;
+        if(n > length)
+            n = length;
 
-    if(format.parity != Serial_ParityNone)
-        UART0->CR1 |= (format.parity == Serial_ParityEven ? (USART_CR1_M0|USART_CR1_PCE) : (USART_CR1_M0|USART_CR1_PCE|USART_CR1_PS));
+        memcpy(&txbuf->data[head], s, n);
+        txbuf->head = (head + n) & (TX_BUFFER_SIZE - 1);
+        s += n;
+        length -= n;
 
-    UART0->CR1 |= USART_CR1_UE;
+        if(!tx->busy)
+            NVIC_SetPendingIRQ(tx->irq);
+    }
 
     return true;
 }
 
-static bool serialDisable (bool disable)
+static void serial_tx_dma_flush (serial_tx_dma_t *tx)
 {
-    if(disable)
-        UART0->CR1 &= ~USART_CR1_RXNEIE;
-    else
-        UART0->CR1 |= USART_CR1_RXNEIE;
+    NVIC_DisableIRQ(tx->irq);
 
-    return true;
-}
+    serial_dma_disable(tx->stream);
+    serial_dma_flags_clear(tx->dma, tx->stream_n);
+    NVIC_ClearPendingIRQ(tx->irq);
 
-static bool serialEnqueueRtCommand (uint8_t c)
-{
-    return enqueue_realtime_command(c);
+    tx->busy = false;
+    tx->txbuf->tail = tx->txbuf->head;
+
+    NVIC_EnableIRQ(tx->irq);
 }
 
-static enqueue_realtime_command_ptr serialSetRtHandler (enqueue_realtime_command_ptr handler)
-{
-    enqueue_realtime_command_ptr prev = enqueue_realtime_command;
+#endif // SERIAL_TX_DMA_ENABLE
+
+// Run time state, one per stream instance. Accessed by the interrupt handlers and thus placed in DTCM along with the buffers.
+
+typedef struct {
+    const uart_map_t *map;
+    USART_TypeDef *uart;
+    stream_rx_buffer_t *rxbuf;
+    stream_tx_buffer_t *txbuf;
+    volatile uint_fast16_t *rx_head; // where received characters are added: &rxbuf->head, or &frame_head when framing
+    enqueue_realtime_command_ptr enqueue_realtime_command;
+    uint32_t rx_ie;             // CR1 receive interrupt enable: RXNEIE, or IDLEIE when receiving via DMA, plus RTOIE when framing
+    uint32_t cr3;
+#if MODBUS_HW_FRAMING_ENABLE
+    bool framing;
+    volatile uint_fast16_t frame_head; // published to rxbuf->head on receiver timeout
+#endif
+#if SERIAL_RX_DMA_ENABLE
+    serial_rx_dma_t rx;
+#endif
+#if SERIAL_TX_DMA_ENABLE
+    serial_tx_dma_t tx;
+#endif
+#if SERIAL_FLOW_CONTROL
+    GPIO_TypeDef *rts_port;     // NULL if no RTS output
+    uint32_t rts_bit;
+#endif
+    io_stream_status_t status;
+} uart_t;
 
-    if(handler)
-        enqueue_realtime_command = handler;
+DTCM_DATA static stream_rx_buffer_t rxbuf[N_UARTS] = {0};
+DTCM_DATA static stream_tx_buffer_t txbuf[N_UARTS] = {0};
+DTCM_DATA static uart_t uart_port[N_UARTS] = {0};
 
-    return prev;
-}
+#if SERIAL_RX_DMA_ENABLE
 
-static const io_stream_t *serialInit (uint32_t baud_rate)
+// $SRX - output receive interrupt count, characters received and realtime command latency per serial port.
+// $SRX=R - reset statistics.
+static status_code_t serial_rx_dma_report (sys_state_t state, char *args)
 {
-    static const io_stream_t stream = {
-        .type = StreamType_Serial,
-        .is_connected = stream_connected,
-        .read = serialGetC,
-        .write = serialWriteS,
-        .write_n =  serialWrite,
-        .write_char = serialPutC,
-        .enqueue_rt_command = serialEnqueueRtCommand,
-        .get_rx_buffer_free = serialRxFree,
-        .get_rx_buffer_count = serialRxCount,
-        .get_tx_buffer_count = serialTxCount,
-        .reset_write_buffer = serialTxFlush,
-        .reset_read_buffer = serialRxFlush,
-        .cancel_read_buffer = serialRxCancel,
-        .suspend_read = serialSuspendInput,
-        .disable_rx = serialDisable,
-        .set_baud_rate = serialSetBaudRate,
-        .set_format = serialSetFormat,
-#if MODBUS_RTU_STREAM == 0 && defined(RS485_DIR_PORT)
-        .set_direction = rs485SetDirection,
-#endif
-        .set_enqueue_rt_handler = serialSetRtHandler
-    };
+    uint_fast8_t idx;
+    serial_rx_stats_t stats;
+
+    if(args && !((*args == 'R' || *args == 'r') && args[1] == '\0'))
+        return Status_InvalidStatement;
+
+    for(idx = 0; idx < N_UARTS; idx++) {
+
+        if(uart_port[idx].rx.stream == NULL)
+            continue;
+
+        __disable_irq();
+        stats = uart_port[idx].rx.stats;
+        if(args)
+            memset(&uart_port[idx].rx.stats, 0, sizeof(serial_rx_stats_t));
+        __enable_irq();
+
+        if(!args) {
+            hal.stream.write("[SRX:");
+            hal.stream.write(uitoa(idx));
+            hal.stream.write("|irq:");
+            hal.stream.write(uitoa(stats.irqs));
+            hal.stream.write("|rx:");
+            hal.stream.write(uitoa(stats.bytes));
+            hal.stream.write("|rt:");
+            hal.stream.write(uitoa(stats.rt_commands));
+            hal.stream.write("|lat:");
+            hal.stream.write(uitoa(stats.rt_latency_max / hal.f_mcu));
+            hal.stream.write(",");
+            hal.stream.write(uitoa(stats.rt_commands ? (uint32_t)(stats.rt_latency_sum / stats.rt_commands) / hal.f_mcu : 0));
+            hal.stream.write("us]" ASCII_EOL);
+        }
+    }
 
-    if(!serial[0].flags.claimable || serial[0].flags.claimed)
-        return NULL;
+    return Status_OK;
+}
 
-    serial[0].flags.claimed = On;
+#endif // SERIAL_RX_DMA_ENABLE
 
-    if(!serial[0].flags.init_ok) {
+#if SERIAL_TX_DMA_ENABLE
 
-        UART0_CLK_En();
+// $STX - output transmit interrupt count, characters sent, DMA transfers and DMA transfer errors per serial port.
+// $STX=R - reset statistics.
+static status_code_t serial_tx_dma_report (sys_state_t state, char *args)
+{
+    uint_fast8_t idx;
+    serial_tx_stats_t stats;
+
+    if(args && !((*args == 'R' || *args == 'r') && args[1] == '\0'))
+        return Status_InvalidStatement;
+
+    for(idx = 0; idx < N_UARTS; idx++) {
+
+        if(uart_port[idx].tx.stream == NULL)
+            continue;
+
+        __disable_irq();
+        stats = uart_port[idx].tx.stats;
+        if(args)
+            memset(&uart_port[idx].tx.stats, 0, sizeof(serial_tx_stats_t));
+        __enable_irq();
+
+        if(!args) {
+            hal.stream.write("[STX:");
+            hal.stream.write(uitoa(idx));
+            hal.stream.write("|irq:");
+            hal.stream.write(uitoa(stats.irqs));
+            hal.stream.write("|tx:");
+            hal.stream.write(uitoa(stats.bytes));
+            hal.stream.write("|dma:");
+            hal.stream.write(uitoa(stats.chunks));
+            hal.stream.write("|err:");
+            hal.stream.write(uitoa(stats.errors));
+            hal.stream.write("]" ASCII_EOL);
+        }
+    }
 
-        GPIO_InitTypeDef GPIO_InitStructure = {
-            .Mode      = GPIO_MODE_AF_PP,
-            .Pull      = GPIO_NOPULL,
-            .Speed     = GPIO_SPEED_FREQ_VERY_HIGH,
-            .Pin       = (1 << UART0_RX_PIN)|(1 << UART0_TX_PIN),
-            .Alternate = UART0_AF
-        };
-        HAL_GPIO_Init(UART0_PORT, &GPIO_InitStructure);
+    return Status_OK;
+}
 
-        HAL_NVIC_SetPriority(UART0_IRQ, 1, 0);
-        HAL_NVIC_EnableIRQ(UART0_IRQ);
+#endif // SERIAL_TX_DMA_ENABLE
 
-        serial[0].flags.init_ok = On;
-    }
+#if SERIAL_FLOW_CONTROL
 
-    stream_set_defaults(&stream, baud_rate);
+// Deasserts RTS when the input buffer is filled to the high water mark, called from the receive interrupt handlers.
+static inline void uart_rts_check (uart_t *port)
+{
+    stream_rx_buffer_t *rxbuf = port->rxbuf;
+    uint_fast16_t tail = rxbuf->tail, head = rxbuf->head;
 
-    return &stream;
+    if(port->rts_port && !rxbuf->rts_state && BUFCOUNT(head, tail, RX_BUFFER_SIZE) >= RX_BUFFER_HWM) {
+        rxbuf->rts_state = On;
+        DIGITAL_OUT(port->rts_port, port->rts_bit, 1);
+    }
 }
 
-ISR_CODE void UART0_IRQHandler (void)
+// Asserts RTS again when the input buffer is drained to the low water mark.
+static inline void uart_rts_release (uart_t *port)
 {
-    if(UART0->ISR & USART_ISR_RXNE) {
-        uint32_t data = UART0->RDR;
-        if(!enqueue_realtime_command((uint8_t)data)) {          // Check and strip realtime commands...
-            uint16_t next_head = BUFNEXT(rxbuf.head, rxbuf);    // Get and increment buffer pointer
-            if(next_head == rxbuf.tail)                         // If buffer full
-                rxbuf.overflow = 1;                             // flag overflow
-            else {
-                rxbuf.data[rxbuf.head] = (uint8_t)data;         // if not add data to buffer
-                rxbuf.head = next_head;                         // and update pointer
-            }
-        }
-    }
+    stream_rx_buffer_t *rxbuf = port->rxbuf;
+    uint_fast16_t tail = rxbuf->tail, head = rxbuf->head;
 
-    if((UART0->ISR & USART_ISR_TXE) && (UART0->CR1 & USART_CR1_TXEIE)) {
-        uint_fast16_t tail = txbuf.tail;            // Get buffer pointer
-        UART0->TDR = txbuf.data[tail];              // Send next character
-        txbuf.tail = tail = BUFNEXT(tail, txbuf);   // and increment pointer
-        if(tail == txbuf.head)                      // If buffer empty then
-            UART0->CR1 &= ~USART_CR1_TXEIE;         // disable UART TX interrupt
-   }
+    if(rxbuf->rts_state && BUFCOUNT(head, tail, RX_BUFFER_SIZE) <= RX_BUFFER_LWM) {
+        rxbuf->rts_state = Off;
+        DIGITAL_OUT(port->rts_port, port->rts_bit, 0);
+    }
 }
 
-#endif // SERIAL_PORT
+#else
+
+#define uart_rts_check(port)
+#define uart_rts_release(port)
 
-#if SERIAL1_PORT
+#endif // SERIAL_FLOW_CONTROL
 
 //
 // Returns number of free characters in serial input buffer
 //
-static uint16_t serial1RxFree (void)
+static inline uint16_t uart_rx_free (uart_t *port)
 {
-    uint32_t tail = rxbuf1.tail, head = rxbuf1.head;
+    uint_fast16_t tail = port->rxbuf->tail, head = port->rxbuf->head;
 
     return (RX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, RX_BUFFER_SIZE);
 }
@@ -789,9 +896,9 @@ static uint16_t serial1RxFree (void)
 //
 // Returns number of characters in serial input buffer
 //
-static uint16_t serial1RxCount (void)
+static inline uint16_t uart_rx_count (uart_t *port)
 {
-    uint32_t tail = rxbuf1.tail, head = rxbuf1.head;
+    uint_fast16_t tail = port->rxbuf->tail, head = port->rxbuf->head;
 
     return BUFCOUNT(head, tail, RX_BUFFER_SIZE);
 }
@@ -799,493 +906,792 @@ static uint16_t serial1RxCount (void)
 //
 // Flushes the serial input buffer
 //
-static void serial1RxFlush (void)
+static inline void uart_rx_flush (uart_t *port)
 {
-    rxbuf1.tail = rxbuf1.head;
+    __disable_irq();
+#if SERIAL_RX_DMA_ENABLE
+    if(port->rx.stream)
+        serial_rx_dma_discard(&port->rx); // also discard characters still in the DMA buffer
+#endif
+#if MODBUS_HW_FRAMING_ENABLE
+    if(port->framing)
+        port->frame_head = port->rxbuf->head; // and the frame being received
+#endif
+    port->rxbuf->tail = port->rxbuf->head;
+    __enable_irq();
+    uart_rts_release(port);
 }
 
 //
 // Flushes and adds a CAN character to the serial input buffer
 //
-static void serial1RxCancel (void)
+static void uart_rx_cancel (uart_t *port)
 {
-    rxbuf1.data[rxbuf1.head] = ASCII_CAN;
-    rxbuf1.tail = rxbuf1.head;
-    rxbuf1.head = BUFNEXT(rxbuf1.head, rxbuf1);
+    stream_rx_buffer_t *rxbuf = port->rxbuf;
+
+    __disable_irq();
+#if SERIAL_RX_DMA_ENABLE
+    if(port->rx.stream)
+        serial_rx_dma_discard(&port->rx);
+#endif
+    rxbuf->data[rxbuf->head] = ASCII_CAN;
+    rxbuf->tail = rxbuf->head;
+    rxbuf->head = BUFNEXT(rxbuf->head, (*rxbuf));
+#if MODBUS_HW_FRAMING_ENABLE
+    if(port->framing)
+        port->frame_head = rxbuf->head;
+#endif
+    __enable_irq();
+    uart_rts_release(port);
 }
 
 //
-// Writes a character to the serial output stream
+// uart_getc - returns -1 if no data available
 //
-static bool serial1PutC (const uint8_t c)
+static int32_t uart_getc (uart_t *port)
 {
-    uint32_t next_head = BUFNEXT(txbuf1.head, txbuf1);   // Set and update head pointer
-
-    while(txbuf1.tail == next_head) {           // While TX buffer full
-        if(!hal.stream_blocking_callback())     // check if blocking for space,
-            return false;                       // exit if not (leaves TX buffer in an inconsistent state)
-        UART1->CR1 |= USART_CR1_TXEIE;          // Enable TX interrupts???
-    }
+    stream_rx_buffer_t *rxbuf = port->rxbuf;
+    uint_fast16_t tail = rxbuf->tail;               // Get buffer pointer
 
-    txbuf1.data[txbuf1.head] = c;               // Add data to buffer
-    txbuf1.head = next_head;                    // and update head pointer
+    if(tail == rxbuf->head)
+        return -1; // no data available
 
-    UART1->CR1 |= USART_CR1_TXEIE;              // Enable TX interrupts
+    int32_t data = (int32_t)rxbuf->data[tail];      // Get next character
+    rxbuf->tail = BUFNEXT(tail, (*rxbuf));          // and update pointer
+    uart_rts_release(port);
 
-    return true;
+    return data;
 }
 
 //
-// Writes a null terminated string to the serial output stream, blocks if buffer full
+// Writes a character to the serial output stream
 //
-static void serial1WriteS (const char *s)
+static bool uart_putc (uart_t *port, const uint8_t c)
 {
-    char c, *ptr = (char *)s;
+#if SERIAL_TX_DMA_ENABLE
+    if(port->tx.stream)
+        return serial_tx_dma_write(&port->tx, &c, 1);
+#endif
+
+    stream_tx_buffer_t *txbuf = port->txbuf;
+    uint_fast16_t next_head = BUFNEXT(txbuf->head, (*txbuf));   // Get pointer to next free slot in buffer
+
+    while(txbuf->tail == next_head) {                           // While TX buffer full
+        if(!hal.stream_blocking_callback())                     // check if blocking for space,
+            return false;                                       // exit if not (leaves TX buffer in an inconsistent state)
+    }
+    txbuf->data[txbuf->head] = c;                               // Add data to buffer,
+    txbuf->head = next_head;                                    // update head pointer and
+    port->uart->CR1 |= USART_CR1_TXEIE;                         // enable TX interrupts
 
-    while((c = *ptr++) != '\0')
-        serial1PutC((uint8_t)c);
+    return true;
 }
 
-// Writes a number of characters from a buffer to the serial output stream, blocks if buffer full
 //
-static void serial1Write (const uint8_t *s, uint16_t length)
+// Writes a number of characters to the serial output stream, blocks if buffer full
+//
+static void uart_write (uart_t *port, const uint8_t *s, uint_fast16_t length)
 {
-    uint8_t *ptr = (uint8_t *)s;
+#if SERIAL_TX_DMA_ENABLE
+    if(port->tx.stream) {
+        serial_tx_dma_write(&port->tx, s, length);
+        return;
+    }
+#endif
 
     while(length--)
-        serial1PutC(*ptr++);
+        uart_putc(port, *s++);
 }
 
 //
 // Flushes the serial output buffer
 //
-static void serial1TxFlush (void)
+static void uart_tx_flush (uart_t *port)
 {
-    UART1->CR1 &= ~USART_CR1_TXEIE;     // Disable TX interrupts
-    txbuf1.tail = txbuf1.head;
+#if SERIAL_TX_DMA_ENABLE
+    if(port->tx.stream) {
+        serial_tx_dma_flush(&port->tx);
+        return;
+    }
+#endif
+
+    port->uart->CR1 &= ~USART_CR1_TXEIE;     // Disable TX interrupts
+    port->txbuf->tail = port->txbuf->head;
 }
 
 //
 // Returns number of characters pending transmission
 //
-static uint16_t serial1TxCount (void)
+static uint16_t uart_tx_count (uart_t *port)
 {
-    uint32_t tail = txbuf1.tail, head = txbuf1.head;
+    uint_fast16_t tail = port->txbuf->tail, head = port->txbuf->head;
 
-    return BUFCOUNT(head, tail, TX_BUFFER_SIZE) + (UART1->ISR & USART_ISR_TC ? 0 : 1);
+    return BUFCOUNT(head, tail, TX_BUFFER_SIZE) + (port->uart->ISR & USART_ISR_TC ? 0 : 1);
 }
 
-//
-// serialGetC - returns -1 if no data available
-//
-static int32_t serial1GetC (void)
-{
-    uint_fast16_t tail = rxbuf1.tail;           // Get buffer pointer
-
-    if(tail == rxbuf1.head)
-        return -1; // no data available
+#if MODBUS_HW_FRAMING_ENABLE
 
-    int32_t data = (int32_t)rxbuf1.data[tail];  // Get next character
-    rxbuf1.tail = BUFNEXT(tail, rxbuf1);        // and update pointer
+// Receiver timeout in bit times from the last stop bit: the 3.5 character Modbus inter-frame gap,
+// fixed to 1.75 ms for baud rates above 19200 as recommended by the specification.
+static inline void uart_set_rto (uart_t *port)
+{
+    uint32_t baud_rate = port->status.baud_rate;
 
-    return data;
+    port->uart->RTOR = baud_rate > 19200 ? (baud_rate * 7) / 4000 : (port->status.format.parity == Serial_ParityNone ? 35 : 39);
 }
 
-static bool serial1SuspendInput (bool suspend)
-{
-    return stream_rx_suspend(&rxbuf1, suspend);
-}
+#endif // MODBUS_HW_FRAMING_ENABLE
 
-static bool serial1SetBaudRate (uint32_t baud_rate)
+// Baud rates above f_ck / 16 use 8x oversampling, the maximum is f_ck / 8: 13.5 Mbaud for USART1 and USART6
+// and 6.75 Mbaud for the others with the default 216 MHz clock configuration.
+static bool uart_set_baud_rate (uart_t *port, uint32_t baud_rate)
 {
-    stream_status[1].baud_rate = baud_rate;
+    USART_TypeDef *uart = port->uart;
+    uint32_t f_ck = port->map->apb2 ? HAL_RCC_GetPCLK2Freq() : HAL_RCC_GetPCLK1Freq(), div;
+
+    if(baud_rate == 0 || baud_rate > f_ck / 8)
+        return false;
 
-    UART1->CR1 &= ~(USART_CR1_UE|USART_CR1_RXNEIE|USART_CR1_RE|USART_CR1_TE);
-    UART1->CR3 = USART_CR3_OVRDIS;
-    UART1->BRR = UART_DIV_SAMPLING16(UART1_CLK, baud_rate);
-    UART1->CR1 |=(USART_CR1_UE|USART_CR1_RXNEIE|USART_CR1_RE|USART_CR1_TE);
+    port->status.baud_rate = baud_rate;
 
-    rxbuf1.tail = rxbuf1.head;
-    txbuf1.tail = txbuf1.head;
+#if SERIAL_TX_DMA_ENABLE
+    if(port->tx.stream)
+        serial_tx_dma_flush(&port->tx);
+#endif
+
+    uart->CR1 &= ~(USART_CR1_UE|port->rx_ie|USART_CR1_RE|USART_CR1_TE|USART_CR1_OVER8);
+    uart->CR3 = port->cr3;
+    if(baud_rate > f_ck / 16) {
+        div = UART_DIV_SAMPLING8(f_ck, baud_rate);
+        uart->BRR = (div & 0xFFF0) | ((div & 0x000F) >> 1); // BRR[2:0] = USARTDIV[3:0] >> 1, BRR[3] must be kept cleared
+        uart->CR1 |= USART_CR1_OVER8;
+    } else
+        uart->BRR = UART_DIV_SAMPLING16(f_ck, baud_rate);
+#if MODBUS_HW_FRAMING_ENABLE
+    if(port->framing) {
+        // DEAT and DEDT can only be written with the peripheral disabled, in sample time units of 1/16 or 1/8 bit
+        uart->CR1 = (uart->CR1 & ~(USART_CR1_DEAT|USART_CR1_DEDT)) |
+                     (RS485_DE_ASSERT_TIME << USART_CR1_DEAT_Pos) | (RS485_DE_DEASSERT_TIME << USART_CR1_DEDT_Pos);
+        uart->CR2 |= USART_CR2_RTOEN;
+        uart_set_rto(port);
+        port->frame_head = port->rxbuf->head;
+    }
+#endif
+    uart->CR1 |= (USART_CR1_UE|port->rx_ie|USART_CR1_RE|USART_CR1_TE);
+
+    port->rxbuf->tail = port->rxbuf->head;
+    port->txbuf->tail = port->txbuf->head;
+    uart_rts_release(port);
+
+#if SERIAL_RX_DMA_ENABLE
+    if(port->rx.stream)
+        serial_rx_dma_reset(&port->rx, baud_rate, port->status.format);
+#endif
 
     return true;
 }
 
-static bool serial1SetFormat (serial_format_t format)
+static bool uart_set_format (uart_t *port, serial_format_t format)
 {
-    stream_status[1].format = format;
+    USART_TypeDef *uart = port->uart;
+
+    port->status.format = format;
 
-    UART1->CR1 &= ~(USART_CR1_M|USART_CR1_PCE|USART_CR1_PS|USART_CR1_UE);
+    uart->CR1 &= ~(USART_CR1_M|USART_CR1_PCE|USART_CR1_PS|USART_CR1_UE);
 
     if(format.parity != Serial_ParityNone)
-        UART1->CR1 |= (format.parity == Serial_ParityEven ? (USART_CR1_M0|USART_CR1_PCE) : (USART_CR1_M0|USART_CR1_PCE|USART_CR1_PS));
+        uart->CR1 |= (format.parity == Serial_ParityEven ? (USART_CR1_M0|USART_CR1_PCE) : (USART_CR1_M0|USART_CR1_PCE|USART_CR1_PS));
+
+#if MODBUS_HW_FRAMING_ENABLE
+    if(port->framing)
+        uart_set_rto(port);
+#endif
 
-    UART1->CR1 |= USART_CR1_UE;
+    uart->CR1 |= USART_CR1_UE;
 
     return true;
 }
 
-static bool serial1Disable (bool disable)
+static bool uart_disable (uart_t *port, bool disable)
 {
     if(disable)
-        UART1->CR1 &= ~USART_CR1_RXNEIE;
+        port->uart->CR1 &= ~port->rx_ie;
     else
-        UART1->CR1 |= USART_CR1_RXNEIE;
+        port->uart->CR1 |= port->rx_ie;
+
+#if SERIAL_RX_DMA_ENABLE
+    if(port->rx.stream)
+        serial_rx_dma_enable(&port->rx, !disable);
+#endif
 
     return true;
 }
 
-static bool serial1EnqueueRtCommand (uint8_t c)
+static enqueue_realtime_command_ptr uart_set_rt_handler (uart_t *port, enqueue_realtime_command_ptr handler)
 {
-    return enqueue_realtime_command1(c);
+    enqueue_realtime_command_ptr prev = port->enqueue_realtime_command;
+
+    if(handler)
+        port->enqueue_realtime_command = handler;
+
+    return prev;
 }
 
-static enqueue_realtime_command_ptr serial1SetRtHandler (enqueue_realtime_command_ptr handler)
+#ifdef RS485_DIR_PORT
+
+static void rs485SetDirection (bool tx)
 {
-    enqueue_realtime_command_ptr prev = enqueue_realtime_command1;
+    DIGITAL_OUT(RS485_DIR_PORT, RS485_DIR_PIN, tx);
+}
 
-    if(handler)
-        enqueue_realtime_command1 = handler;
+#endif // RS485_DIR_PORT
 
-    return prev;
+#if defined(MODBUS_RTU_STREAM) && defined(RS485_DIR_PORT)
+#define UART_SET_DIRECTION(i) .set_direction = (i) == MODBUS_RTU_STREAM ? rs485SetDirection : NULL,
+#else
+#define UART_SET_DIRECTION(i)
+#endif
+
+static const io_stream_t *uart_claim (uint_fast8_t instance, const io_stream_t *stream, void (*rx_released)(void), uint32_t baud_rate);
+
+// The io_stream_t entry points have no instance argument, these thin wrappers bind each stream instance to the shared code.
+
+#define UART_STREAM(i) \
+static int32_t serial ## i ## GetC (void) { return uart_getc(&uart_port[i]); } \
+static bool serial ## i ## PutC (const uint8_t c) { return uart_putc(&uart_port[i], c); } \
+static void serial ## i ## WriteS (const char *s) { uart_write(&uart_port[i], (const uint8_t *)s, strlen(s)); } \
+static void serial ## i ## Write (const uint8_t *s, uint16_t length) { uart_write(&uart_port[i], s, length); } \
+static bool serial ## i ## EnqueueRtCommand (uint8_t c) { return uart_port[i].enqueue_realtime_command(c); } \
+static uint16_t serial ## i ## RxFree (void) { return uart_rx_free(&uart_port[i]); } \
+static uint16_t serial ## i ## RxCount (void) { return uart_rx_count(&uart_port[i]); } \
+static uint16_t serial ## i ## TxCount (void) { return uart_tx_count(&uart_port[i]); } \
+static void serial ## i ## TxFlush (void) { uart_tx_flush(&uart_port[i]); } \
+static void serial ## i ## RxFlush (void) { uart_rx_flush(&uart_port[i]); } \
+static void serial ## i ## RxCancel (void) { uart_rx_cancel(&uart_port[i]); } \
+static bool serial ## i ## SuspendInput (bool suspend) { return stream_rx_suspend(uart_port[i].rxbuf, suspend); } \
+static bool serial ## i ## Disable (bool disable) { return uart_disable(&uart_port[i], disable); } \
+static bool serial ## i ## SetBaudRate (uint32_t baud_rate) { return uart_set_baud_rate(&uart_port[i], baud_rate); } \
+static bool serial ## i ## SetFormat (serial_format_t format) { return uart_set_format(&uart_port[i], format); } \
+static enqueue_realtime_command_ptr serial ## i ## SetRtHandler (enqueue_realtime_command_ptr handler) { return uart_set_rt_handler(&uart_port[i], handler); } \
+static void serial ## i ## RxReleased (void) { uart_rts_release(&uart_port[i]); } \
+\
+static const io_stream_t *serial ## i ## Init (uint32_t baud_rate) \
+{ \
+    static const io_stream_t stream = { \
+        .type = StreamType_Serial, \
+        .is_connected = stream_connected, \
+        .read = serial ## i ## GetC, \
+        .write = serial ## i ## WriteS, \
+        .write_n = serial ## i ## Write, \
+        .write_char = serial ## i ## PutC, \
+        .enqueue_rt_command = serial ## i ## EnqueueRtCommand, \
+        .get_rx_buffer_free = serial ## i ## RxFree, \
+        .get_rx_buffer_count = serial ## i ## RxCount, \
+        .get_tx_buffer_count = serial ## i ## TxCount, \
+        .reset_write_buffer = serial ## i ## TxFlush, \
+        .reset_read_buffer = serial ## i ## RxFlush, \
+        .cancel_read_buffer = serial ## i ## RxCancel, \
+        .suspend_read = serial ## i ## SuspendInput, \
+        .disable_rx = serial ## i ## Disable, \
+        .set_baud_rate = serial ## i ## SetBaudRate, \
+        .set_format = serial ## i ## SetFormat, \
+        UART_SET_DIRECTION(i) \
+        .set_enqueue_rt_handler = serial ## i ## SetRtHandler \
+    }; \
+\
+    return uart_claim(i, &stream, serial ## i ## RxReleased, baud_rate); \
 }
 
-static const io_stream_t *serial1Init (uint32_t baud_rate)
+UART_STREAM(0)
+#if N_UARTS > 1
+UART_STREAM(1)
+#endif
+#if N_UARTS > 2
+UART_STREAM(2)
+#endif
+#if N_UARTS > 3
+UART_STREAM(3)
+#endif
+#if N_UARTS > 4
+UART_STREAM(4)
+#endif
+#if N_UARTS > 5
+UART_STREAM(5)
+#endif
+#if N_UARTS > 6
+UART_STREAM(6)
+#endif
+#if N_UARTS > 7
+UART_STREAM(7)
+#endif
+
+static bool uart_release (uint8_t instance);
+static const io_stream_status_t *get_uart_status (uint8_t instance);
+
+#define UART_PROPERTIES(i) { \
+      .type = StreamType_Serial, \
+      .instance = i, \
+      .flags.claimable = On, \
+      .flags.claimed = Off, \
+      .flags.can_set_baud = On, \
+      .flags.modbus_ready = On, \
+      .claim = serial ## i ## Init, \
+      .release = uart_release, \
+      .get_status = get_uart_status \
+    }
+
+static io_stream_properties_t serial[] = {
+    UART_PROPERTIES(0),
+#if N_UARTS > 1
+    UART_PROPERTIES(1),
+#endif
+#if N_UARTS > 2
+    UART_PROPERTIES(2),
+#endif
+#if N_UARTS > 3
+    UART_PROPERTIES(3),
+#endif
+#if N_UARTS > 4
+    UART_PROPERTIES(4),
+#endif
+#if N_UARTS > 5
+    UART_PROPERTIES(5),
+#endif
+#if N_UARTS > 6
+    UART_PROPERTIES(6),
+#endif
+#if N_UARTS > 7
+    UART_PROPERTIES(7),
+#endif
+};
+
+static const io_stream_t *uart_claim (uint_fast8_t instance, const io_stream_t *stream, void (*rx_released)(void), uint32_t baud_rate)
 {
-    static const io_stream_t stream = {
-        .type = StreamType_Serial,
-        .instance = 1,
-        .is_connected = stream_connected,
-        .read = serial1GetC,
-        .write = serial1WriteS,
-        .write_n =  serial1Write,
-        .write_char = serial1PutC,
-        .enqueue_rt_command = serial1EnqueueRtCommand,
-        .get_rx_buffer_free = serial1RxFree,
-        .get_rx_buffer_count = serial1RxCount,
-        .get_tx_buffer_count = serial1TxCount,
-        .reset_write_buffer = serial1TxFlush,
-        .reset_read_buffer = serial1RxFlush,
-        .cancel_read_buffer = serial1RxCancel,
-        .suspend_read = serial1SuspendInput,
-        .disable_rx = serial1Disable,
-        .set_baud_rate = serial1SetBaudRate,
-        .set_format = serial1SetFormat,
-#if MODBUS_RTU_STREAM == 1 && defined(RS485_DIR_PORT)
-        .set_direction = rs485SetDirection,
-#endif
-        .set_enqueue_rt_handler = serial1SetRtHandler
-    };
+    uart_t *port = &uart_port[instance];
 
-    if(!serial[1].flags.claimable || serial[1].flags.claimed)
+    if(!serial[instance].flags.claimable || serial[instance].flags.claimed)
         return NULL;
 
-    serial[1].flags.claimed = On;
+    serial[instance].flags.claimed = On;
 
-    if(!serial[1].flags.init_ok) {
+    if(!serial[instance].flags.init_ok) {
 
-        UART1_CLK_En();
+        const uart_map_t *map = port->map;
+
+        *map->rcc_enr |= map->rcc_en;
+        (void)*map->rcc_enr; // Delay after an RCC peripheral clock enabling
 
         GPIO_InitTypeDef GPIO_InitStructure = {
             .Mode      = GPIO_MODE_AF_PP,
             .Pull      = GPIO_NOPULL,
             .Speed     = GPIO_SPEED_FREQ_VERY_HIGH,
-            .Pin       = (1 << UART1_RX_PIN)|(1 << UART1_TX_PIN),
-            .Alternate = UART1_AF
+            .Pin       = (1 << map->tx_pin),
+            .Alternate = map->af
         };
-        HAL_GPIO_Init(UART1_PORT, &GPIO_InitStructure);
+        HAL_GPIO_Init(map->tx_port, &GPIO_InitStructure);
 
-        HAL_NVIC_SetPriority(UART1_IRQ, 1, 0);
-        HAL_NVIC_EnableIRQ(UART1_IRQ);
+        GPIO_InitStructure.Pin = (1 << map->rx_pin);
+        HAL_GPIO_Init(map->rx_port, &GPIO_InitStructure);
 
-        serial[1].flags.init_ok = On;
-    }
+#if SERIAL_FLOW_CONTROL
+        if(instance < sizeof(uart_flow_map) / sizeof(uart_flow_map_t)) {
 
-    stream_set_defaults(&stream, baud_rate);
+            const uart_flow_map_t *flow = &uart_flow_map[instance];
 
-    return &stream;
-}
+            if(flow->cts_port) {
+                GPIO_InitStructure.Pin = (1 << flow->cts_pin);
+                GPIO_InitStructure.Pull = GPIO_PULLDOWN; // Transmit when not connected
+                GPIO_InitStructure.Alternate = map->uart == UART5 ? GPIO_AF7_UART5 : map->af;
+                HAL_GPIO_Init(flow->cts_port, &GPIO_InitStructure);
+            }
 
-ISR_CODE void UART1_IRQHandler (void)
-{
-    if(UART1->ISR & USART_ISR_RXNE) {
-        uint32_t data = UART1->RDR;
-        if(!enqueue_realtime_command1((uint8_t)data)) {         // Check and strip realtime commands...
-            uint16_t next_head = BUFNEXT(rxbuf1.head, rxbuf1);  // Get and increment buffer pointer
-            if(next_head == rxbuf1.tail)                        // If buffer full
-                rxbuf1.overflow = 1;                            // flag overflow
-            else {
-                rxbuf1.data[rxbuf1.head] = (uint8_t)data;       // if not add data to buffer
-                rxbuf1.head = next_head;                        // and update pointer
+            if(flow->rts_port) {
+                DIGITAL_OUT(flow->rts_port, 1 << flow->rts_pin, 0);
+                GPIO_InitStructure.Mode = GPIO_MODE_OUTPUT_PP;
+                GPIO_InitStructure.Pin = (1 << flow->rts_pin);
+                GPIO_InitStructure.Pull = GPIO_NOPULL;
+                GPIO_InitStructure.Alternate = 0;
+                HAL_GPIO_Init(flow->rts_port, &GPIO_InitStructure);
             }
         }
-    }
+#endif
 
-    if((UART1->ISR & USART_ISR_TXE) && (UART1->CR1 & USART_CR1_TXEIE)) {
-        uint_fast16_t tail = txbuf1.tail;           // Get buffer pointer
-        UART1->TDR = txbuf1.data[tail];             // Send next character
-        txbuf1.tail = tail = BUFNEXT(tail, txbuf1); // and increment pointer
-        if(tail == txbuf1.head)                     // If buffer empty then
-            UART1->CR1 &= ~USART_CR1_TXEIE;         // disable UART TX interrupt
-   }
-}
+#if MODBUS_HW_FRAMING_ENABLE
+        if(port->framing) {
+            GPIO_InitStructure.Mode = GPIO_MODE_AF_PP;
+            GPIO_InitStructure.Pin = (1 << RS485_DE_PIN);
+            GPIO_InitStructure.Pull = GPIO_PULLDOWN; // Keep the transceiver receiving until the peripheral is enabled
+            GPIO_InitStructure.Alternate = map->uart == UART5 ? GPIO_AF7_UART5 : map->af;
+            HAL_GPIO_Init(RS485_DE_PORT, &GPIO_InitStructure);
+        }
+#endif
+
+        HAL_NVIC_SetPriority(map->irq, 1, 0);
+        HAL_NVIC_EnableIRQ(map->irq);
+
+#if SERIAL_RX_DMA_ENABLE
+        if(port->rx.stream)
+            serial_rx_dma_init(&port->rx);
+#endif
+#if SERIAL_TX_DMA_ENABLE
+        if(port->tx.stream)
+            serial_tx_dma_init(&port->tx);
+#endif
 
-#endif // SERIAL1_PORT
+        serial[instance].flags.init_ok = On;
+    }
 
-#if SERIAL2_PORT
+    stream_set_defaults(stream, baud_rate);
 
-//
-// Returns number of free characters in serial input buffer
-//
-static uint16_t serial2RxFree (void)
-{
-    uint32_t tail = rxbuf2.tail, head = rxbuf2.head;
+#if STREAM_SPAN_ENABLE && SERIAL_FLOW_CONTROL
+    stream_span_register(stream->read, port->rxbuf, port->rts_port ? rx_released : NULL);
+#elif STREAM_SPAN_ENABLE
+    stream_span_register(stream->read, port->rxbuf, NULL);
+#endif
 
-    return (RX_BUFFER_SIZE - 1) - BUFCOUNT(head, tail, RX_BUFFER_SIZE);
+    return stream;
 }
 
-//
-// Returns number of characters in serial input buffer
-//
-static uint16_t serial2RxCount (void)
+static const io_stream_status_t *get_uart_status (uint8_t instance)
 {
-    uint32_t tail = rxbuf2.tail, head = rxbuf2.head;
+    uart_port[instance].status.flags = serial[instance].flags;
 
-    return BUFCOUNT(head, tail, RX_BUFFER_SIZE);
+    return &uart_port[instance].status;
 }
 
-//
-// Flushes the serial input buffer
-//
-static void serial2RxFlush (void)
+static bool uart_release (uint8_t instance)
 {
-    rxbuf2.tail = rxbuf2.head;
-}
+    bool ok;
 
-//
-// Flushes and adds a CAN character to the serial input buffer
-//
-static void serial2RxCancel (void)
-{
-    rxbuf2.data[rxbuf2.head] = ASCII_CAN;
-    rxbuf2.tail = rxbuf2.head;
-    rxbuf2.head = BUFNEXT(rxbuf2.head, rxbuf2);
+    if((ok = serial[instance].flags.claimed))
+        serial[instance].flags.claimed = Off;
+
+    return ok;
 }
 
-//
-// Writes a character to the serial output stream
-//
-static bool serial2PutC (const uint8_t c)
+void serialRegisterStreams (void)
 {
-    uint32_t next_head = BUFNEXT(txbuf2.head, txbuf2);   // Set and update head pointer
+    static const uint8_t port_code[] = { SERIAL_PORT, SERIAL1_PORT, SERIAL2_PORT, SERIAL3_PORT, SERIAL4_PORT, SERIAL5_PORT, SERIAL6_PORT, SERIAL7_PORT };
 
-    while(txbuf2.tail == next_head) {           // While TX buffer full
-        if(!hal.stream_blocking_callback())     // check if blocking for space,
-            return false;                       // exit if not (leaves TX buffer in an inconsistent state)
-        UART2->CR1 |= USART_CR1_TXEIE;          // Enable TX interrupts???
-    }
+    static io_stream_details_t streams = {
+        .n_streams = sizeof(serial) / sizeof(io_stream_properties_t),
+        .streams = serial,
+    };
 
-    txbuf2.data[txbuf2.head] = c;               // Add data to buffer
-    txbuf2.head = next_head;                    // and update head pointer
+    uint_fast8_t idx, map;
+    uart_t *port;
+
+    for(idx = 0; idx < N_UARTS; idx++) {
+
+        port = &uart_port[idx];
+
+        for(map = 0; uart_map[map].port != port_code[idx]; map++); // All port codes are validated at compile time.
+
+        port->map = &uart_map[map];
+        port->uart = port->map->uart;
+        port->rxbuf = &rxbuf[idx];
+        port->txbuf = &txbuf[idx];
+        port->rx_head = &port->rxbuf->head;
+        port->rx_ie = USART_CR1_RXNEIE;
+        port->cr3 = USART_CR3_OVRDIS;
+        port->status.baud_rate = 115200;
+        port->status.format.width = Serial_8bit;
+        port->status.format.stopbits = Serial_StopBits1;
+        port->status.format.parity = Serial_ParityNone;
+
+#if SERIAL_RX_DMA_ENABLE
+        if(port->map->rx_dma.d) {
+            port->rx.uart = port->uart;
+            port->rx.dma = port->map->rx_dma.d == 1 ? DMA1 : DMA2;
+            port->rx.stream = dma_stream[port->map->rx_dma.d - 1][port->map->rx_dma.s];
+            port->rx.stream_n = port->map->rx_dma.s;
+            port->rx.channel = port->map->rx_dma.ch;
+            port->rx.irq = dma_irq[port->map->rx_dma.d - 1][port->map->rx_dma.s];
+            port->rx.data = rx_dma_buf[idx];
+            port->rx.rxbuf = port->rxbuf;
+            port->rx.head = port->rx_head;
+            port->rx.enqueue_realtime_command = &port->enqueue_realtime_command;
+            port->rx_ie = USART_CR1_IDLEIE;
+            port->cr3 |= USART_CR3_DMAR;
+        }
+#endif
 
-    UART2->CR1 |= USART_CR1_TXEIE;              // Enable TX interrupts
+#if SERIAL_TX_DMA_ENABLE
+        if(port->map->tx_dma.d) {
+            port->tx.uart = port->uart;
+            port->tx.dma = port->map->tx_dma.d == 1 ? DMA1 : DMA2;
+            port->tx.stream = dma_stream[port->map->tx_dma.d - 1][port->map->tx_dma.s];
+            port->tx.stream_n = port->map->tx_dma.s;
+            port->tx.channel = port->map->tx_dma.ch;
+            port->tx.irq = dma_irq[port->map->tx_dma.d - 1][port->map->tx_dma.s];
+            port->tx.txbuf = port->txbuf;
+            port->cr3 |= USART_CR3_DMAT;
+        }
+#endif
 
-    return true;
-}
+        periph_pin_t tx = {
+            .function = Output_TX,
+            .group = idx < 4 ? PinGroup_UART + idx : PinGroup_UART4,
+            .port  = port->map->tx_port,
+            .pin   = port->map->tx_pin,
+            .mode  = { .mask = PINMODE_OUTPUT }
+        };
 
-//
-// Writes a null terminated string to the serial output stream, blocks if buffer full
-//
-static void serial2WriteS (const char *s)
-{
-    char c, *ptr = (char *)s;
+        periph_pin_t rx = {
+            .function = Input_RX,
+            .group = tx.group,
+            .port = port->map->rx_port,
+            .pin = port->map->rx_pin,
+            .mode = { .mask = PINMODE_NONE }
+        };
 
-    while((c = *ptr++) != '\0')
-        serial2PutC(c);
-}
+        hal.periph_port.register_pin(&rx);
+        hal.periph_port.register_pin(&tx);
 
-// Writes a number of characters from a buffer to the serial output stream, blocks if buffer full
-//
-static void serial2Write (const uint8_t *s, uint16_t length)
-{
-	const uint8_t *ptr = s;
+#if MODBUS_HW_FRAMING_ENABLE
+        if(idx == MODBUS_RTU_STREAM) {
 
-    while(length--)
-        serial2PutC(*ptr++);
-}
+            port->framing = true;
+            port->rx_head = &port->frame_head;
+            port->rx_ie |= USART_CR1_RTOIE;
+            port->cr3 |= USART_CR3_DEM; // active high driver enable
+#if SERIAL_RX_DMA_ENABLE
+            port->rx.head = port->rx_head;
+#endif
 
-//
-// Flushes the serial output buffer
-//
-static void serial2TxFlush (void)
-{
-    UART2->CR1 &= ~USART_CR1_TXEIE;     // Disable TX interrupts
-    txbuf2.tail = txbuf2.head;
-}
+            periph_pin_t de = {
+                .function = Output_RS485_Direction,
+                .group = tx.group,
+                .port = RS485_DE_PORT,
+                .pin = RS485_DE_PIN,
+                .mode = { .mask = PINMODE_OUTPUT }
+            };
 
-//
-// Returns number of characters pending transmission
-//
-static uint16_t serial2TxCount (void)
-{
-    uint32_t tail = txbuf2.tail, head = txbuf2.head;
+            hal.periph_port.register_pin(&de);
+        }
+#endif
 
-    return BUFCOUNT(head, tail, TX_BUFFER_SIZE) + (UART2->ISR & USART_ISR_TC ? 0 : 1);
-}
+#if SERIAL_FLOW_CONTROL
+        if(idx < sizeof(uart_flow_map) / sizeof(uart_flow_map_t)) {
 
-//
-// serialGetC - returns -1 if no data available
-//
-static int32_t serial2GetC (void)
-{
-    uint_fast16_t tail = rxbuf2.tail;           // Get buffer pointer
+            if(uart_flow_map[idx].cts_port)
+                port->cr3 |= USART_CR3_CTSE;
 
-    if(tail == rxbuf2.head)
-        return -1; // no data available
+            if(uart_flow_map[idx].rts_port) {
 
-    int32_t data = (int32_t)rxbuf2.data[tail]; 	// Get next character
-    rxbuf2.tail = BUFNEXT(tail, rxbuf2);    	// and update pointer
+                port->rts_port = uart_flow_map[idx].rts_port;
+                port->rts_bit = 1 << uart_flow_map[idx].rts_pin;
 
-    return data;
-}
+                periph_pin_t rts = {
+                    .function = Output_RTS,
+                    .group = tx.group,
+                    .port = port->rts_port,
+                    .pin = uart_flow_map[idx].rts_pin,
+                    .mode = { .mask = PINMODE_OUTPUT }
+                };
 
-static bool serial2SuspendInput (bool suspend)
-{
-    return stream_rx_suspend(&rxbuf2, suspend);
-}
+                hal.periph_port.register_pin(&rts);
+            }
+        }
+#endif
+    }
 
-static bool serial2SetBaudRate (uint32_t baud_rate)
-{
-    stream_status[2].baud_rate = baud_rate;
+#if SERIAL_RX_DMA_ENABLE
 
-    UART2->CR1 &= ~(USART_CR1_UE|USART_CR1_RXNEIE|USART_CR1_RE|USART_CR1_TE);
-    UART2->CR3 = USART_CR3_OVRDIS;
-    UART2->BRR = UART_DIV_SAMPLING16(UART2_CLK, baud_rate);
-    UART2->CR1 |= (USART_CR1_UE|USART_CR1_RXNEIE|USART_CR1_RE|USART_CR1_TE);
+    static const sys_command_t serial_rx_command_list[] = {
+        {"SRX", serial_rx_dma_report, { .allow_blocking = On }, { .str = "output serial receive interrupt and realtime command latency statistics, $SRX=R to reset" } }
+    };
 
-    rxbuf2.tail = rxbuf2.head;
-    txbuf2.tail = txbuf2.head;
+    static sys_commands_t serial_rx_commands = {
+        .n_commands = sizeof(serial_rx_command_list) / sizeof(sys_command_t),
+        .commands = serial_rx_command_list
+    };
 
-    return true;
-}
+    system_register_commands(&serial_rx_commands);
 
-static bool serial2SetFormat (serial_format_t format)
-{
-    stream_status[2].format = format;
+#endif
 
-    UART2->CR1 &= ~(USART_CR1_M|USART_CR1_PCE|USART_CR1_PS|USART_CR1_UE);
+#if SERIAL_TX_DMA_ENABLE
 
-    if(format.parity != Serial_ParityNone)
-        UART2->CR1 |= (format.parity == Serial_ParityEven ? (USART_CR1_M0|USART_CR1_PCE) : (USART_CR1_M0|USART_CR1_PCE|USART_CR1_PS));
+    static const sys_command_t serial_tx_command_list[] = {
+        {"STX", serial_tx_dma_report, { .allow_blocking = On }, { .str = "output serial transmit interrupt and DMA transfer statistics, $STX=R to reset" } }
+    };
 
-    UART2->CR1 |= USART_CR1_UE;
+    static sys_commands_t serial_tx_commands = {
+        .n_commands = sizeof(serial_tx_command_list) / sizeof(sys_command_t),
+        .commands = serial_tx_command_list
+    };
 
-    return true;
-}
+    system_register_commands(&serial_tx_commands);
 
-static bool serial2Disable (bool disable)
-{
-    if(disable)
-        UART2->CR1 &= ~USART_CR1_RXNEIE;
-    else
-        UART2->CR1 |= USART_CR1_RXNEIE;
+#endif
 
-    return true;
+    stream_register_streams(&streams);
 }
 
-static bool serial2EnqueueRtCommand (uint8_t c)
-{
-    return enqueue_realtime_command2(c);
-}
+// Shared interrupt handler, the peripheral handlers below pass the instance bound to the peripheral.
 
-static enqueue_realtime_command_ptr serial2SetRtHandler (enqueue_realtime_command_ptr handler)
+ISR_CODE static void uart_irq (uart_t *port)
 {
-    enqueue_realtime_command_ptr prev = enqueue_realtime_command2;
+    USART_TypeDef *uart = port->uart;
+
+#if SERIAL_RX_DMA_ENABLE
+    if(port->rx.stream) {
+        uint32_t t_irq = DWT->CYCCNT;
+        if(uart->ISR & USART_ISR_IDLE) {
+            uart->ICR = USART_ICR_IDLECF;
+            serial_rx_dma_process(&port->rx, t_irq, true);
+        }
+    } else
+#endif
+    if(uart->ISR & USART_ISR_RXNE) {
+        stream_rx_buffer_t *rxbuf = port->rxbuf;
+        uint32_t data = uart->RDR;
+        if(!port->enqueue_realtime_command((uint8_t)data)) {            // Check and strip realtime commands...
+            uint_fast16_t head = *port->rx_head;
+            uint_fast16_t next_head = BUFNEXT(head, (*rxbuf));          // Get and increment buffer pointer
+            if(next_head == rxbuf->tail)                                // If buffer full
+                rxbuf->overflow = 1;                                    // flag overflow
+            else {
+                rxbuf->data[head] = (uint8_t)data;                      // if not add data to buffer
+                *port->rx_head = next_head;                             // and update pointer
+            }
+        }
+    }
 
-    if(handler)
-        enqueue_realtime_command2 = handler;
+#if MODBUS_HW_FRAMING_ENABLE
+    if(uart->ISR & USART_ISR_RTOF) {                                    // End of frame,
+        uart->ICR = USART_ICR_RTOCF;
+#if SERIAL_RX_DMA_ENABLE
+        if(port->rx.stream)                                             // add any characters left in the DMA buffer
+            serial_rx_dma_process(&port->rx, DWT->CYCCNT, true);
+#endif
+        port->rxbuf->head = port->frame_head;                           // and make the frame available to the reader
+    }
+#endif
 
-    return prev;
+    uart_rts_check(port);
+
+    if((uart->ISR & USART_ISR_TXE) && (uart->CR1 & USART_CR1_TXEIE)) {
+        stream_tx_buffer_t *txbuf = port->txbuf;
+        uint_fast16_t tail = txbuf->tail;           // Get buffer pointer
+        uart->TDR = txbuf->data[tail];              // Send next character
+        txbuf->tail = tail = BUFNEXT(tail, (*txbuf)); // and increment pointer
+        if(tail == txbuf->head)                     // If buffer empty then
+            uart->CR1 &= ~USART_CR1_TXEIE;          // disable UART TX interrupt
+    }
 }
 
-static const io_stream_t *serial2Init (uint32_t baud_rate)
-{
-    static const io_stream_t stream = {
-        .type = StreamType_Serial,
-        .instance = 2,
-        .is_connected = stream_connected,
-        .read = serial2GetC,
-        .write = serial2WriteS,
-        .write_n =  serial2Write,
-        .write_char = serial2PutC,
-        .enqueue_rt_command = serial2EnqueueRtCommand,
-        .get_rx_buffer_free = serial2RxFree,
-        .get_rx_buffer_count = serial2RxCount,
-        .get_tx_buffer_count = serial2TxCount,
-        .reset_write_buffer = serial2TxFlush,
-        .reset_read_buffer = serial2RxFlush,
-        .cancel_read_buffer = serial2RxCancel,
-        .suspend_read = serial2SuspendInput,
-        .disable_rx = serial2Disable,
-        .set_baud_rate = serial2SetBaudRate,
-        .set_format = serial2SetFormat,
-#if MODBUS_RTU_STREAM == 2 && defined(RS485_DIR_PORT)
-        .set_direction = rs485SetDirection,
-#endif
-        .set_enqueue_rt_handler = serial2SetRtHandler
-    };
+#define UART_IRQ_HANDLER(handler, n) \
+ISR_CODE void handler (void) \
+{ \
+    ISR_PROFILE_ENTER(); \
+    uart_irq(&uart_port[SERIAL_INSTANCE(n)]); \
+    ISR_PROFILE_EXIT(SERIAL_ISR_ID(n)); \
+}
 
-    if(!serial[2].flags.claimable || serial[2].flags.claimed)
-        return NULL;
+#if SERIAL_USES_USART(1)
+UART_IRQ_HANDLER(USART1_IRQHandler, 1)
+#endif
+#if SERIAL_USES_USART(2)
+UART_IRQ_HANDLER(USART2_IRQHandler, 2)
+#endif
+#if SERIAL_USES_USART(3)
+UART_IRQ_HANDLER(USART3_IRQHandler, 3)
+#endif
+#if SERIAL_USES_USART(4)
+UART_IRQ_HANDLER(UART4_IRQHandler, 4)
+#endif
+#if SERIAL_USES_USART(5)
+UART_IRQ_HANDLER(UART5_IRQHandler, 5)
+#endif
+#if SERIAL_USES_USART(6)
+UART_IRQ_HANDLER(USART6_IRQHandler, 6)
+#endif
+#if SERIAL_USES_USART(7)
+UART_IRQ_HANDLER(UART7_IRQHandler, 7)
+#endif
+#if SERIAL_USES_USART(8)
+UART_IRQ_HANDLER(UART8_IRQHandler, 8)
+#endif
 
-    serial[2].flags.claimed = On;
+#if SERIAL_RX_DMA_ENABLE
 
-    if(!serial[2].flags.init_ok) {
+#define UART_RX_DMA_HANDLER(n) \
+ISR_CODE void DMAhandler(U ## n ## _RX_DMA_D, U ## n ## _RX_DMA_S) (void) \
+{ \
+    ISR_PROFILE_ENTER(); \
+    serial_rx_dma_irq(&uart_port[SERIAL_INSTANCE(n)].rx); \
+    uart_rts_check(&uart_port[SERIAL_INSTANCE(n)]); \
+    ISR_PROFILE_EXIT(SERIAL_ISR_ID(n)); \
+}
 
-        UART2_CLK_En();
+#if SERIAL_USES_USART(1) && U1_RX_DMA_D
+UART_RX_DMA_HANDLER(1)
+#endif
+#if SERIAL_USES_USART(2) && U2_RX_DMA_D
+UART_RX_DMA_HANDLER(2)
+#endif
+#if SERIAL_USES_USART(3) && U3_RX_DMA_D
+UART_RX_DMA_HANDLER(3)
+#endif
+#if SERIAL_USES_USART(4) && U4_RX_DMA_D
+UART_RX_DMA_HANDLER(4)
+#endif
+#if SERIAL_USES_USART(5) && U5_RX_DMA_D
+UART_RX_DMA_HANDLER(5)
+#endif
+#if SERIAL_USES_USART(6) && U6_RX_DMA_D
+UART_RX_DMA_HANDLER(6)
+#endif
+#if SERIAL_USES_USART(7) && U7_RX_DMA_D
+UART_RX_DMA_HANDLER(7)
+#endif
+#if SERIAL_USES_USART(8) && U8_RX_DMA_D
+UART_RX_DMA_HANDLER(8)
+#endif
 
-        GPIO_InitTypeDef GPIO_InitStructure = {
-            .Mode      = GPIO_MODE_AF_PP,
-            .Pull      = GPIO_NOPULL,
-            .Speed     = GPIO_SPEED_FREQ_VERY_HIGH,
-            .Pin       = (1 << UART2_RX_PIN)|(1 << UART2_TX_PIN),
-            .Alternate = UART2_AF
-        };
-        HAL_GPIO_Init(UART2_PORT, &GPIO_InitStructure);
+#endif // SERIAL_RX_DMA_ENABLE
 
-        HAL_NVIC_SetPriority(UART2_IRQ, 1, 0);
-        HAL_NVIC_EnableIRQ(UART2_IRQ);
+#if SERIAL_TX_DMA_ENABLE
 
-        serial[2].flags.init_ok = On;
-    }
+#define UART_TX_DMA_HANDLER(n) \
+ISR_CODE void DMAhandler(U ## n ## _TX_DMA_D, U ## n ## _TX_DMA_S) (void) \
+{ \
+    ISR_PROFILE_ENTER(); \
+    serial_tx_dma_irq(&uart_port[SERIAL_INSTANCE(n)].tx); \
+    ISR_PROFILE_EXIT(SERIAL_ISR_ID(n)); \
+}
 
-    stream_set_defaults(&stream, baud_rate);
+#if SERIAL_USES_USART(1) && U1_TX_DMA_D
+UART_TX_DMA_HANDLER(1)
+#endif
+#if SERIAL_USES_USART(2) && U2_TX_DMA_D
+UART_TX_DMA_HANDLER(2)
+#endif
+#if SERIAL_USES_USART(3) && U3_TX_DMA_D
+UART_TX_DMA_HANDLER(3)
+#endif
+#if SERIAL_USES_USART(4) && U4_TX_DMA_D
+UART_TX_DMA_HANDLER(4)
+#endif
+#if SERIAL_USES_USART(5) && U5_TX_DMA_D
+UART_TX_DMA_HANDLER(5)
+#endif
+#if SERIAL_USES_USART(6) && U6_TX_DMA_D
+UART_TX_DMA_HANDLER(6)
+#endif
+#if SERIAL_USES_USART(7) && U7_TX_DMA_D
+UART_TX_DMA_HANDLER(7)
+#endif
+#if SERIAL_USES_USART(8) && U8_TX_DMA_D
+UART_TX_DMA_HANDLER(8)
+#endif
 
-    return &stream;
-}
+#endif // SERIAL_TX_DMA_ENABLE
 
-ISR_CODE void UART2_IRQHandler (void)
-{
-    if(UART2->ISR & USART_ISR_RXNE) {
-        uint32_t data = UART2->RDR;
-        if(!enqueue_realtime_command2((uint8_t)data)) {         // Check and strip realtime commands...
-            uint16_t next_head = BUFNEXT(rxbuf2.head, rxbuf2);  // Get and increment buffer pointer
-            if(next_head == rxbuf2.tail)                        // If buffer full
-                rxbuf2.overflow = 1;                            // flag overflow
-            else {
-                rxbuf2.data[rxbuf2.head] = (uint8_t)data;       // if not add data to buffer
-                rxbuf2.head = next_head;                        // and update pointer
-            }
-        }
-    }
+#else
 
-    if((UART2->ISR & USART_ISR_TXE) && (UART2->CR1 & USART_CR1_TXEIE)) {
-        uint_fast16_t tail = txbuf2.tail;           // Get buffer pointer
-        UART2->TDR = txbuf2.data[tail];             // Send next character
-        txbuf2.tail = tail = BUFNEXT(tail, txbuf2); // and increment pointer
-        if(tail == txbuf2.head)                     // If buffer empty then
-            UART2->CR1 &= ~USART_CR1_TXEIE;         // disable UART TX interrupt
-   }
-}
+void serialRegisterStreams (void) {}; // No serial ports!
 
-#endif // SERIAL2_PORT
+#endif // N_UARTS
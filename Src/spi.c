@@ -19,6 +19,8 @@
   along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <string.h>
+
 #include "main.h"
 #include "driver.h"
 
@@ -35,6 +37,8 @@
 
 #define SPIPORT SPIport(SPI_PORT)
 
+#define SPI_BOUNCE_BUFFER_SIZE 512 // SD card sector size
+
 static SPI_HandleTypeDef spi_port = {
     .Instance = SPIPORT,
     .Init.Mode = SPI_MODE_MASTER,
@@ -396,6 +400,8 @@ uint8_t spi_put_byte (uint8_t byte)
 
 bool spi_write (uint8_t *data, uint16_t len)
 {
+    cache_clean(data, len);
+
     if(HAL_SPI_Transmit_DMA(&spi_port, data, len) == HAL_OK)
         while(spi_port.State != HAL_SPI_STATE_READY);
 
@@ -404,13 +410,42 @@ bool spi_write (uint8_t *data, uint16_t len)
     return true;
 }
 
-bool spi_read (uint8_t *data, uint16_t len)
+static void spi_read_dma (uint8_t *data, uint16_t len)
 {
     if(HAL_SPI_Receive_DMA(&spi_port, data, len) == HAL_OK)
         while(spi_port.State != HAL_SPI_STATE_READY);
 
     __HAL_DMA_DISABLE(&spi_dma_rx);
     __HAL_DMA_DISABLE(&spi_dma_tx);
+}
+
+bool spi_read (uint8_t *data, uint16_t len)
+{
+    // Invalidating a partial cache line would discard data sharing the line with the buffer,
+    // unaligned buffers are read via the non-cacheable bounce buffer when the data cache is enabled.
+    if(!(SCB->CCR & SCB_CCR_DC_Msk) || !(((uint32_t)data | len) & (CACHE_LINE_SIZE - 1))) {
+
+        cache_clean(data, len); // buffer is also transmitted
+
+        spi_read_dma(data, len);
+
+        cache_invalidate(data, len);
+
+    } else {
+
+        static DMA_DATA uint8_t rx_buffer[SPI_BOUNCE_BUFFER_SIZE];
+
+        uint16_t chunk;
+
+        while(len) {
+            chunk = len > sizeof(rx_buffer) ? sizeof(rx_buffer) : len;
+            memcpy(rx_buffer, data, chunk); // buffer is also transmitted
+            spi_read_dma(rx_buffer, chunk);
+            memcpy(data, rx_buffer, chunk);
+            data += chunk;
+            len -= chunk;
+        }
+    }
 
     return true;
 }
@@ -0,0 +1,325 @@
+/*
+
+  step_loopback.c - step pulse loopback verification for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+  Each axis step output is wired to a timer input pin defined in the board map by <axis>_STEP_LOOPBACK_PORT
+  and <axis>_STEP_LOOPBACK_PIN. The timer counts the emitted pulses in external clock mode, the count is
+  compared to the number of commanded steps each time the stepper starts executing a new segment.
+*/
+
+#include "driver.h"
+
+#if STEP_LOOPBACK_ENABLE
+
+#include <string.h>
+
+#include "grbl/hal.h"
+#include "grbl/task.h"
+#include "grbl/report.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+#include "step_loopback.h"
+
+typedef struct {
+    GPIO_TypeDef *port;
+    uint8_t pin;
+} loopback_pin_t;
+
+typedef struct {
+    const stm32_pcnt_hw_t *hw;
+    uint16_t cnt_ref;   // hardware count at last check
+    uint16_t steps;     // commanded steps since last check
+    uint32_t total;     // total commanded steps
+    uint32_t errors;    // number of segments with mismatched counts
+    int32_t lost;       // accumulated difference, commanded - counted
+} loopback_axis_t;
+
+static const loopback_pin_t loopback_pin[N_AXIS] = {
+#ifdef X_STEP_LOOPBACK_PIN
+    [X_AXIS] = { .port = X_STEP_LOOPBACK_PORT, .pin = X_STEP_LOOPBACK_PIN },
+#endif
+#ifdef Y_STEP_LOOPBACK_PIN
+    [Y_AXIS] = { .port = Y_STEP_LOOPBACK_PORT, .pin = Y_STEP_LOOPBACK_PIN },
+#endif
+#ifdef Z_STEP_LOOPBACK_PIN
+    [Z_AXIS] = { .port = Z_STEP_LOOPBACK_PORT, .pin = Z_STEP_LOOPBACK_PIN },
+#endif
+#if defined(A_AXIS) && defined(A_STEP_LOOPBACK_PIN)
+    [A_AXIS] = { .port = A_STEP_LOOPBACK_PORT, .pin = A_STEP_LOOPBACK_PIN },
+#endif
+#if defined(B_AXIS) && defined(B_STEP_LOOPBACK_PIN)
+    [B_AXIS] = { .port = B_STEP_LOOPBACK_PORT, .pin = B_STEP_LOOPBACK_PIN },
+#endif
+#if defined(C_AXIS) && defined(C_STEP_LOOPBACK_PIN)
+    [C_AXIS] = { .port = C_STEP_LOOPBACK_PORT, .pin = C_STEP_LOOPBACK_PIN },
+#endif
+#if defined(U_AXIS) && defined(U_STEP_LOOPBACK_PIN)
+    [U_AXIS] = { .port = U_STEP_LOOPBACK_PORT, .pin = U_STEP_LOOPBACK_PIN },
+#endif
+#if defined(V_AXIS) && defined(V_STEP_LOOPBACK_PIN)
+    [V_AXIS] = { .port = V_STEP_LOOPBACK_PORT, .pin = V_STEP_LOOPBACK_PIN },
+#endif
+#if defined(W_AXIS) && defined(W_STEP_LOOPBACK_PIN)
+    [W_AXIS] = { .port = W_STEP_LOOPBACK_PORT, .pin = W_STEP_LOOPBACK_PIN },
+#endif
+};
+
+DTCM_DATA static struct {
+    axes_signals_t axes;
+    axes_signals_t mismatch;
+    bool report_pending;
+    void *segment;
+    stepper_pulse_start_ptr pulse_start;
+    loopback_axis_t axis[N_AXIS];
+} loopback = {};
+
+static void loopback_report_mismatch (void *data)
+{
+    uint_fast8_t idx;
+    char msg[40];
+
+    __disable_irq();
+    axes_signals_t mismatch = loopback.mismatch;
+    loopback.mismatch.bits = 0;
+    loopback.report_pending = false;
+    __enable_irq();
+
+    strcpy(msg, "Step loopback mismatch on axis");
+    for(idx = 0; idx < N_AXIS; idx++) {
+        if(mismatch.bits & (1 << idx)) {
+            strcat(msg, " ");
+            strcat(msg, axis_letter[idx]);
+        }
+    }
+
+    report_message(msg, Message_Warning);
+}
+
+static inline uint16_t loopback_count (loopback_axis_t *axis)
+{
+    return (uint16_t)axis->hw->timer->CNT;
+}
+
+// Compare emitted and commanded steps since last check, must be called before the pulses for the current step are started.
+ISR_CODE static void loopback_check (void)
+{
+    uint_fast8_t idx = N_AXIS;
+    uint16_t count, emitted;
+    loopback_axis_t *axis;
+
+    do {
+        axis = &loopback.axis[--idx];
+        if(axis->hw) {
+            count = loopback_count(axis);
+            emitted = count - axis->cnt_ref;
+            if(emitted != axis->steps) {
+                axis->errors++;
+                axis->lost += (int16_t)(axis->steps - emitted);
+                loopback.mismatch.bits |= (1 << idx);
+            }
+            axis->cnt_ref = count;
+            axis->steps = 0;
+        }
+    } while(idx);
+
+    if(loopback.mismatch.bits && !loopback.report_pending)
+        loopback.report_pending = task_add_immediate(loopback_report_mismatch, NULL);
+}
+
+inline static __attribute__((always_inline)) void loopback_add_steps (uint32_t bits)
+{
+    uint_fast8_t idx;
+
+    bits &= loopback.axes.bits;
+
+    while(bits) {
+        idx = __builtin_ctz(bits);
+        bits &= ~(1 << idx);
+        loopback.axis[idx].steps++;
+        loopback.axis[idx].total++;
+    }
+}
+
+ISR_CODE static void stepperPulseStartLoopback (stepper_t *stepper)
+{
+    if(stepper->exec_segment != loopback.segment) {
+        loopback.segment = stepper->exec_segment;
+        loopback_check();
+    }
+
+    // Steps for motors disabled by auto squaring or driven by step injection are not output.
+    loopback_add_steps(stepper->step_out.bits & stepper_loopback_axes().bits);
+
+    loopback.pulse_start(stepper);
+}
+
+// Count steps output by stepperOutputStep() as commanded, may be called from outside the stepper interrupt.
+ISR_CODE void step_loopback_injected (axes_signals_t step_out)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    loopback_add_steps(step_out.bits);
+    __set_PRIMASK(primask);
+}
+
+// $SLB - report commanded steps, segments with mismatched counts and accumulated difference per axis.
+// $SLB=R - reset statistics.
+static status_code_t loopback_report (sys_state_t state, char *args)
+{
+    uint_fast8_t idx;
+    loopback_axis_t axis;
+
+    if(args) {
+        if(!(*args == 'R' || *args == 'r') || args[1] != '\0')
+            return Status_InvalidStatement;
+
+        __disable_irq();
+        for(idx = 0; idx < N_AXIS; idx++) {
+            loopback.axis[idx].total = loopback.axis[idx].errors = 0;
+            loopback.axis[idx].lost = 0;
+        }
+        __enable_irq();
+
+        return Status_OK;
+    }
+
+    for(idx = 0; idx < N_AXIS; idx++) {
+
+        if(loopback.axis[idx].hw == NULL)
+            continue;
+
+        __disable_irq();
+        memcpy(&axis, &loopback.axis[idx], sizeof(loopback_axis_t));
+        __enable_irq();
+
+        hal.stream.write("[SLB:");
+        hal.stream.write(axis_letter[idx]);
+        hal.stream.write("|steps:");
+        hal.stream.write(uitoa(axis.total));
+        hal.stream.write("|errors:");
+        hal.stream.write(uitoa(axis.errors));
+        hal.stream.write("|lost:");
+        if(axis.lost < 0) {
+            hal.stream.write("-");
+            axis.lost = -axis.lost;
+        }
+        hal.stream.write(uitoa((uint32_t)axis.lost));
+        hal.stream.write("]" ASCII_EOL);
+    }
+
+    return Status_OK;
+}
+
+// Set counter input polarity from the step invert setting and hook into step pulse start.
+// Called from settings_changed() after hal.stepper.pulse_start has been set.
+void step_loopback_attach (settings_t *settings)
+{
+    uint_fast8_t idx;
+    loopback_axis_t *axis;
+
+    if(!loopback.axes.bits)
+        return;
+
+    for(idx = 0; idx < N_AXIS; idx++) {
+        if((axis = &loopback.axis[idx])->hw) {
+            if(axis->hw->ecm) {
+                if(settings->steppers.step_invert.bits & (1 << idx))
+                    axis->hw->timer->CCER |= TIM_CCER_CC1P;
+                else
+                    axis->hw->timer->CCER &= ~TIM_CCER_CC1P;
+            } else {
+                if(settings->steppers.step_invert.bits & (1 << idx))
+                    axis->hw->timer->SMCR |= TIM_SMCR_ETP;
+                else
+                    axis->hw->timer->SMCR &= ~TIM_SMCR_ETP;
+            }
+            axis->cnt_ref = loopback_count(axis);
+            axis->steps = 0;
+        }
+    }
+
+    loopback.segment = NULL;
+    loopback.pulse_start = hal.stepper.pulse_start;
+    hal.stepper.pulse_start = stepperPulseStartLoopback;
+}
+
+// Claim and configure a counter timer for each axis with a loopback pin defined.
+// Must be called before ioports_init() so that the timers are not claimed for PWM outputs.
+bool step_loopback_init (void)
+{
+    static const sys_command_t loopback_command_list[] = {
+        {"SLB", loopback_report, { .allow_blocking = On }, { .str = "output step loopback verification statistics, $SLB=R to reset" } }
+    };
+
+    static sys_commands_t loopback_commands = {
+        .n_commands = sizeof(loopback_command_list) / sizeof(sys_command_t),
+        .commands = loopback_command_list
+    };
+
+    uint_fast8_t idx;
+    const stm32_pcnt_hw_t *hw;
+
+    for(idx = 0; idx < N_AXIS; idx++) {
+
+        if(loopback_pin[idx].port == NULL)
+            continue;
+
+        if((hw = pcnt_claim(loopback_pin[idx].port, loopback_pin[idx].pin, NULL))) {
+
+            timer_clk_enable(hw->timer);
+
+            hw->timer->CR1 = 0;
+            hw->timer->PSC = 0;
+            hw->timer->ARR = 0xFFFF;
+            if(hw->ecm) {
+                hw->timer->CCMR1 = TIM_CCMR1_CC1S_0|TIM_CCMR1_IC1F_0|TIM_CCMR1_IC1F_1; // TI1 input, fCK_INT N = 8 filter
+                hw->timer->CCER = 0;
+                hw->timer->SMCR = TIM_SMCR_SMS_0|TIM_SMCR_SMS_1|TIM_SMCR_SMS_2|TIM_SMCR_TS_0|TIM_SMCR_TS_2;
+            } else
+                hw->timer->SMCR = TIM_SMCR_ECE|TIM_SMCR_ETF_0|TIM_SMCR_ETF_1;
+            hw->timer->EGR = TIM_EGR_UG;
+            hw->timer->CR1 = TIM_CR1_CEN;
+
+            GPIO_InitTypeDef GPIO_Init = {
+                .Mode = GPIO_MODE_AF_PP,
+                .Pin = (1 << hw->pin),
+                .Pull = GPIO_NOPULL,
+                .Speed = GPIO_SPEED_FREQ_LOW,
+                .Alternate = hw->af
+            };
+
+            HAL_GPIO_Init(hw->port, &GPIO_Init);
+
+            loopback.axis[idx].hw = hw;
+            loopback.axes.bits |= (1 << idx);
+        }
+    }
+
+    if(loopback.axes.bits)
+        system_register_commands(&loopback_commands);
+
+    return loopback.axes.bits != 0;
+}
+
+#endif // STEP_LOOPBACK_ENABLE
@@ -0,0 +1,177 @@
+/*
+
+  step_trace.c - step and direction output timing trace for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if STEP_TRACE_ENABLE
+
+#include <string.h>
+
+#include "grbl/hal.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+step_trace_t step_trace;
+
+typedef struct {
+    uint32_t n;
+    uint32_t min;
+    uint32_t max;
+} trace_stat_t;
+
+static void stat_add (trace_stat_t *stat, uint32_t value)
+{
+    if(stat->n++ == 0)
+        stat->min = stat->max = value;
+    else {
+        if(value < stat->min)
+            stat->min = value;
+        if(value > stat->max)
+            stat->max = value;
+    }
+}
+
+static void stat_report (const char *name, trace_stat_t *stat)
+{
+    hal.stream.write("|");
+    hal.stream.write(name);
+    hal.stream.write(":");
+    if(stat->n) {
+        hal.stream.write(uitoa(stat->min));
+        hal.stream.write(",");
+        hal.stream.write(uitoa(stat->max));
+    }
+}
+
+// Dump captured events as cycle offsets from the first event.
+static void step_trace_dump (uint32_t n)
+{
+    uint32_t idx;
+
+    for(idx = 0; idx < n; idx++) {
+        hal.stream.write("[STE:");
+        hal.stream.write(uitoa(step_trace.event[idx].cycles - step_trace.event[0].cycles));
+        hal.stream.write(step_trace.event[idx].type == StepTrace_Dir ? "|D:" : "|S:");
+        hal.stream.write(uitoa(step_trace.event[idx].bits));
+        hal.stream.write("|T:");
+        hal.stream.write(uitoa(step_trace.event[idx].period + 1));
+        hal.stream.write("]" ASCII_EOL);
+    }
+}
+
+// $STT - report pulse width, direction setup time, step interval and interval jitter in CPU cycles from the captured trace.
+// $STT=D - dump captured events.
+// $STT=R - rearm capture.
+static status_code_t step_trace_report (sys_state_t state, char *args)
+{
+    uint32_t idx, n = step_trace.n, t_dir = 0, t_step = 0, t_on = 0, tick, interval, jitter;
+    bool dir_pending = false, step_on = false, have_step = false;
+    trace_stat_t width = {0}, dir_setup = {0}, step_interval = {0}, step_jitter = {0};
+    step_trace_event_t *event;
+
+    if(args) {
+
+        if(args[1] != '\0')
+            return Status_InvalidStatement;
+
+        switch(*args) {
+
+            case 'R':
+            case 'r':
+                step_trace.n = 0;
+                break;
+
+            case 'D':
+            case 'd':
+                step_trace_dump(n);
+                break;
+
+            default:
+                return Status_InvalidStatement;
+        }
+
+        return Status_OK;
+    }
+
+    for(idx = 0; idx < n; idx++) {
+
+        event = &step_trace.event[idx];
+
+        if(event->type == StepTrace_Dir) {
+            t_dir = event->cycles;
+            dir_pending = true;
+        } else if(event->bits) {
+            if(dir_pending) {
+                stat_add(&dir_setup, event->cycles - t_dir);
+                dir_pending = false;
+            }
+            if(have_step) {
+                interval = event->cycles - t_step;
+                stat_add(&step_interval, interval);
+                // deviation from the nearest multiple of the stepper timer period
+                tick = (uint32_t)(((uint64_t)(event->period + 1) * hal.f_mcu * 1000000UL) / hal.f_step_timer);
+                if(tick) {
+                    jitter = interval % tick;
+                    stat_add(&step_jitter, jitter > tick / 2 ? tick - jitter : jitter);
+                }
+            }
+            t_step = t_on = event->cycles;
+            have_step = step_on = true;
+        } else if(step_on) {
+            stat_add(&width, event->cycles - t_on);
+            step_on = false;
+        }
+    }
+
+    hal.stream.write("[STT:");
+    hal.stream.write(uitoa(n));
+    hal.stream.write(n == STEP_TRACE_SIZE ? "|full" : "|capturing");
+    hal.stream.write("|clk:");
+    hal.stream.write(uitoa(hal.f_mcu));
+    hal.stream.write("MHz");
+    if(!step_trace.pulse_hw) // pulse width is fixed by hardware in DMA and OPM modes, step off events are not available
+        stat_report("pw", &width);
+    stat_report("dir", &dir_setup);
+    stat_report("interval", &step_interval);
+    stat_report("jitter", &step_jitter);
+    hal.stream.write("]" ASCII_EOL);
+
+    return Status_OK;
+}
+
+void step_trace_init (void)
+{
+    static const sys_command_t step_trace_command_list[] = {
+        {"STT", step_trace_report, { .allow_blocking = On }, { .str = "output step timing trace statistics, $STT=D to dump events, $STT=R to rearm" } }
+    };
+
+    static sys_commands_t step_trace_commands = {
+        .n_commands = sizeof(step_trace_command_list) / sizeof(sys_command_t),
+        .commands = step_trace_command_list
+    };
+
+    step_trace.n = 0;
+
+    system_register_commands(&step_trace_commands);
+}
+
+#endif // STEP_TRACE_ENABLE
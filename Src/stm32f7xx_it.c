@@ -182,7 +182,7 @@ void PendSV_Handler(void)
 /**
   * @brief This function handles System tick timer.
   */
-void SysTick_Handler(void)
+ISR_CODE void SysTick_Handler(void)
 {
   /* USER CODE BEGIN SysTick_IRQn 0 */
   cycle_count = DWT->CYCCNT;
@@ -204,14 +204,14 @@ void SysTick_Handler(void)
   * @brief This function handles USB On The Go FS global interrupt.
   */
 #if USB_SERIAL_CDC
-void OTG_FS_IRQHandler(void)
+ISR_CODE void OTG_FS_IRQHandler(void)
 {
   /* USER CODE BEGIN OTG_FS_IRQn 0 */
-
+  ISR_PROFILE_ENTER();
   /* USER CODE END OTG_FS_IRQn 0 */
   HAL_PCD_IRQHandler(&hpcd_USB_OTG_FS);
   /* USER CODE BEGIN OTG_FS_IRQn 1 */
-
+  ISR_PROFILE_EXIT(ISR_USB);
   /* USER CODE END OTG_FS_IRQn 1 */
 }
 #endif
@@ -0,0 +1,197 @@
+/*
+
+  stream_bench.c - stream throughput and latency benchmark for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if STREAM_BENCH_ENABLE
+
+#include <string.h>
+
+#include "stream_bench.h"
+#include "stream_span.h"
+#include "stream_harness.h"
+
+#include "grbl/hal.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+typedef enum {
+    StreamBench_Sink = 0,
+    StreamBench_Echo,
+    StreamBench_Timestamp
+} stream_bench_mode_t;
+
+typedef struct {
+    stream_bench_mode_t mode;
+    stream_rx_buffer_t *rxbuf;
+    uint32_t lines;
+    uint32_t bytes;
+    uint32_t overflows;
+    uint_fast16_t peak;     // highest input buffer fill level
+    uint_fast16_t length;
+    char line[LINE_BUFFER_SIZE];
+} stream_bench_t;
+
+static stream_harness_status_t stream_bench_poll (stream_harness_t *harness)
+{
+    int32_t c;
+    uint_fast16_t count;
+    stream_bench_t *bench = (stream_bench_t *)harness->context;
+
+    if((count = hal.stream.get_rx_buffer_count()) > bench->peak)
+        bench->peak = count;
+
+    if(bench->rxbuf && bench->rxbuf->overflow) {
+        bench->rxbuf->overflow = 0;
+        bench->overflows++;
+    }
+
+    if((c = hal.stream.read()) == SERIAL_NO_DATA)
+        return StreamHarness_Idle;
+
+    bench->bytes++;
+
+    if(c == ASCII_LF) {
+
+        if(bench->length && bench->line[bench->length - 1] == ASCII_CR)
+            bench->length--;
+        bench->line[bench->length] = '\0';
+        bench->length = 0;
+
+        if(bench->line[0] == '%' && bench->line[1] == '\0')
+            return StreamHarness_Done;
+
+        bench->lines++;
+
+        switch(bench->mode) {
+
+            case StreamBench_Echo:
+                hal.stream.write(bench->line);
+                hal.stream.write(ASCII_EOL);
+                break;
+
+            case StreamBench_Timestamp:
+                hal.stream.write("[SBT:");
+                hal.stream.write(uitoa(bench->lines));
+                hal.stream.write("|");
+                hal.stream.write(uitoa((uint32_t)(harness->elapsed / hal.f_mcu)));
+                hal.stream.write("]" ASCII_EOL);
+                break;
+
+            default:
+                break;
+        }
+    } else if(bench->length < LINE_BUFFER_SIZE - 1)
+        bench->line[bench->length++] = (char)c;
+
+    return StreamHarness_Data;
+}
+
+// $SBM=<S|E|T> - receive lines from the current input stream in sink, echo or timestamp mode and output throughput statistics,
+// see stream_bench.h for details.
+static status_code_t stream_benchmark (sys_state_t state, char *args)
+{
+    static const char *mode_name[] = { "sink", "echo", "timestamp" };
+
+    static stream_bench_t bench;
+
+    stream_bench_mode_t mode;
+    stream_harness_t harness = { .poll = stream_bench_poll, .context = &bench };
+
+    if(args == NULL || args[1] != '\0')
+        return Status_InvalidStatement;
+
+    switch(*args) {
+
+        case 'S':
+        case 's':
+            mode = StreamBench_Sink;
+            break;
+
+        case 'E':
+        case 'e':
+            mode = StreamBench_Echo;
+            break;
+
+        case 'T':
+        case 't':
+            mode = StreamBench_Timestamp;
+            break;
+
+        default:
+            return Status_InvalidStatement;
+    }
+
+    memset(&bench, 0, sizeof(stream_bench_t));
+    bench.mode = mode;
+
+#if STREAM_SPAN_ENABLE
+    const stream_span_source_t *source;
+
+    if((source = stream_span_get(&hal.stream)))
+        bench.rxbuf = source->rxbuf;
+#endif
+
+    hal.stream.write("[SBM:ready|");
+    hal.stream.write(mode_name[mode]);
+    hal.stream.write("]" ASCII_EOL);
+
+    stream_harness_run(&harness);
+
+    hal.stream.write("[SBM:");
+    hal.stream.write(uitoa(bench.lines));
+    hal.stream.write("|bytes:");
+    hal.stream.write(uitoa(bench.bytes));
+    hal.stream.write("|ms:");
+    hal.stream.write(uitoa(stream_harness_ms(&harness)));
+    hal.stream.write("|bps:");
+    hal.stream.write(uitoa(stream_harness_rate(&harness, bench.bytes)));
+    hal.stream.write("|lps:");
+    hal.stream.write(uitoa(stream_harness_rate(&harness, bench.lines)));
+    hal.stream.write("|peak:");
+    hal.stream.write(uitoa(bench.peak));
+    if(bench.rxbuf) {
+        hal.stream.write("|ovf:");
+        hal.stream.write(uitoa(bench.overflows));
+    }
+    hal.stream.write("]" ASCII_EOL);
+
+    hal.stream.reset_read_buffer();
+
+    return Status_OK;
+}
+
+void stream_bench_init (void)
+{
+    static const sys_command_t bench_command_list[] = {
+        {"SBM", stream_benchmark, { .allow_blocking = On }, { .str = "benchmark input stream throughput, $SBM=S, $SBM=E or $SBM=T for sink, echo or timestamp mode" } }
+    };
+
+    static sys_commands_t bench_commands = {
+        .n_commands = sizeof(bench_command_list) / sizeof(sys_command_t),
+        .commands = bench_command_list
+    };
+
+    system_register_commands(&bench_commands);
+}
+
+#endif // STREAM_BENCH_ENABLE
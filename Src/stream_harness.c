@@ -0,0 +1,81 @@
+/*
+
+  stream_harness.c - shared run loop for the input stream benchmarks for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if STREAM_SPAN_ENABLE || STREAM_BENCH_ENABLE
+
+#include "stream_harness.h"
+
+#include "grbl/hal.h"
+#include "grbl/protocol.h"
+
+void stream_harness_run (stream_harness_t *harness)
+{
+    bool started = false;
+    uint32_t t_idle = hal.get_elapsed_ticks(), t_prev = DWT->CYCCNT, t_realtime = t_prev, ms_cycles = hal.f_mcu * 1000;
+
+    harness->elapsed = harness->total = 0;
+
+    while(!sys.abort && hal.get_elapsed_ticks() - t_idle < STREAM_HARNESS_TIMEOUT_MS) {
+
+        harness->t_now = DWT->CYCCNT;
+        if(started)
+            harness->elapsed += harness->t_now - t_prev;
+        t_prev = harness->t_now;
+
+        if(harness->t_now - t_realtime >= ms_cycles) {
+            t_realtime = harness->t_now;
+            protocol_execute_realtime();
+        }
+
+        switch(harness->poll(harness)) {
+
+            case StreamHarness_Data:
+                started = true;
+                harness->total = harness->elapsed;
+                t_idle = hal.get_elapsed_ticks();
+                break;
+
+            case StreamHarness_Done:
+                harness->total = harness->elapsed;
+                return;
+
+            default:
+                break;
+        }
+    }
+}
+
+// Returns the run time in milliseconds.
+uint32_t stream_harness_ms (const stream_harness_t *harness)
+{
+    return (uint32_t)(harness->total / (hal.f_mcu * 1000));
+}
+
+// Returns count per second over the run time, 0 if less than two polls processed input.
+uint32_t stream_harness_rate (const stream_harness_t *harness, uint32_t count)
+{
+    return harness->total ? (uint32_t)(((uint64_t)count * hal.f_mcu * 1000000) / harness->total) : 0;
+}
+
+#endif // STREAM_SPAN_ENABLE || STREAM_BENCH_ENABLE
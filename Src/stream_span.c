@@ -0,0 +1,209 @@
+/*
+
+  stream_span.c - bulk read access to stream input buffers for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if STREAM_SPAN_ENABLE
+
+#include <string.h>
+
+#include "stream_span.h"
+#include "stream_harness.h"
+
+#include "grbl/hal.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+typedef struct {
+    const stream_span_source_t *source; // NULL for single character reads
+    uint32_t lines;
+    uint32_t target;                    // number of lines to assemble
+    uint32_t bytes;
+    uint64_t busy;                      // CPU cycles spent assembling lines
+    uint_fast16_t length;
+    char line[LINE_BUFFER_SIZE];
+} span_benchmark_t;
+
+static uint_fast8_t n_sources = 0;
+static stream_span_source_t sources[STREAM_SPAN_SOURCES];
+
+// Claiming a stream again updates the existing entry.
+void stream_span_register (stream_read_ptr read, stream_rx_buffer_t *rxbuf, stream_rx_released_ptr released)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < n_sources; idx++) {
+        if(sources[idx].read == read)
+            break;
+    }
+
+    if(idx < STREAM_SPAN_SOURCES) {
+        sources[idx].read = read;
+        sources[idx].rxbuf = rxbuf;
+        sources[idx].released = released;
+        if(idx == n_sources)
+            n_sources++;
+    }
+}
+
+// Returns NULL if the stream does not support span reads, the caller should then fall back to read().
+const stream_span_source_t *stream_span_get (const io_stream_t *stream)
+{
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < n_sources; idx++) {
+        if(sources[idx].read == stream->read)
+            return &sources[idx];
+    }
+
+    return NULL;
+}
+
+// Copies characters to the line buffer up to and including the line end, returns number of characters consumed.
+static inline uint_fast16_t line_add (char *line, uint_fast16_t *length, const uint8_t *data, uint_fast16_t n, bool *eol)
+{
+    const uint8_t *end = memchr(data, ASCII_LF, n);
+    uint_fast16_t copy;
+
+    if((*eol = !!end))
+        n = end - data + 1;
+
+    if((copy = min(n, (LINE_BUFFER_SIZE - 1) - *length))) {
+        memcpy(&line[*length], data, copy);
+        *length += copy;
+    }
+
+    return n;
+}
+
+static stream_harness_status_t span_benchmark_poll (stream_harness_t *harness)
+{
+    bool eol;
+    int32_t c;
+    uint_fast8_t n_spans, idx;
+    uint_fast16_t consumed, n;
+    stream_span_t span[2];
+    span_benchmark_t *bench = (span_benchmark_t *)harness->context;
+
+    if(bench->source) {
+        if((n_spans = stream_rx_span(bench->source, span))) {
+            consumed = 0;
+            for(idx = 0; idx < n_spans && bench->lines < bench->target; idx++) {
+                while(span[idx].length && bench->lines < bench->target) {
+                    n = line_add(bench->line, &bench->length, span[idx].data, span[idx].length, &eol);
+                    span[idx].data += n;
+                    span[idx].length -= n;
+                    consumed += n;
+                    if(eol) {
+                        bench->lines++;
+                        bench->length = 0;
+                    }
+                }
+            }
+            stream_rx_consume(bench->source, consumed);
+            bench->bytes += consumed;
+        }
+    } else if((c = hal.stream.read()) != SERIAL_NO_DATA) {
+        n_spans = 1;
+        bench->bytes++;
+        if(c == ASCII_LF) {
+            bench->lines++;
+            bench->length = 0;
+        } else if(bench->length < LINE_BUFFER_SIZE - 1)
+            bench->line[bench->length++] = (char)c;
+    } else
+        n_spans = 0;
+
+    if(n_spans == 0)
+        return StreamHarness_Idle;
+
+    bench->busy += DWT->CYCCNT - harness->t_now;
+
+    return bench->lines < bench->target ? StreamHarness_Data : StreamHarness_Done;
+}
+
+// $RSB=<lines> - assemble <lines> lines from the current input stream by span reads and output lines per second and CPU load.
+// $RSB=<lines>,G - as above by single character reads.
+// Input must be sent after the ready message, the benchmark ends when no input is received for 2 seconds.
+static status_code_t span_benchmark (sys_state_t state, char *args)
+{
+    static span_benchmark_t bench;
+
+    uint_fast8_t cc = 0;
+    uint32_t lines;
+    const stream_span_source_t *source;
+    stream_harness_t harness = { .poll = span_benchmark_poll, .context = &bench };
+
+    if(args == NULL || read_uint(args, &cc, &lines) != Status_OK || lines == 0)
+        return Status_InvalidStatement;
+
+    if(args[cc] == '\0')
+        source = stream_span_get(&hal.stream);
+    else if(args[cc] == ',' && (args[cc + 1] == 'G' || args[cc + 1] == 'g') && args[cc + 2] == '\0')
+        source = NULL;
+    else
+        return Status_InvalidStatement;
+
+    hal.stream.write("[RSB:ready|");
+    hal.stream.write(source ? "span" : "getc");
+    hal.stream.write("]" ASCII_EOL);
+
+    memset(&bench, 0, sizeof(span_benchmark_t));
+    bench.source = source;
+    bench.target = lines;
+
+    stream_harness_run(&harness);
+
+    hal.stream.write("[RSB:");
+    hal.stream.write(uitoa(bench.lines));
+    hal.stream.write("|bytes:");
+    hal.stream.write(uitoa(bench.bytes));
+    hal.stream.write("|ms:");
+    hal.stream.write(uitoa(stream_harness_ms(&harness)));
+    hal.stream.write("|lps:");
+    hal.stream.write(uitoa(stream_harness_rate(&harness, bench.lines)));
+    hal.stream.write("|cpl:");
+    hal.stream.write(uitoa(bench.lines ? (uint32_t)(bench.busy / bench.lines) : 0));
+    hal.stream.write("|load:");
+    hal.stream.write(ftoa(harness.total ? (float)bench.busy * 100.0f / (float)harness.total : 0.0f, 1));
+    hal.stream.write("%]" ASCII_EOL);
+
+    hal.stream.reset_read_buffer();
+
+    return Status_OK;
+}
+
+void stream_span_init (void)
+{
+    static const sys_command_t span_command_list[] = {
+        {"RSB", span_benchmark, { .allow_blocking = On }, { .str = "benchmark line assembly from the input stream, $RSB=<lines>[,G]" } }
+    };
+
+    static sys_commands_t span_commands = {
+        .n_commands = sizeof(span_command_list) / sizeof(sys_command_t),
+        .commands = span_command_list
+    };
+
+    system_register_commands(&span_commands);
+}
+
+#endif // STREAM_SPAN_ENABLE
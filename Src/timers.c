@@ -107,7 +107,7 @@ static dtimer_t timers[] = {
         }
     },
 #endif
-#ifdef TIM7
+#if defined(TIM7) && !IS_TIMER_CLAIMED(TIM7_BASE)
     {
         .timer = TIM7,
         .irq = TIM7_IRQn,
@@ -205,6 +205,40 @@ static dtimer_t timers[] = {
 #endif
 };
 
+static const stm32_pcnt_hw_t counters[] = {
+#ifdef TIM8
+    { .port = GPIOA, .pin = 0,  .af = GPIO_AF3_TIM8,  .timer = timer(8),  .ecm = false },
+#endif
+#if !IS_TIMER_CLAIMED(TIM1_BASE)
+    { .port = GPIOA, .pin = 8,  .af = GPIO_AF1_TIM1,  .timer = timer(1),  .ecm = true },
+    { .port = GPIOA, .pin = 12, .af = GPIO_AF1_TIM1,  .timer = timer(1),  .ecm = false },
+    { .port = GPIOE, .pin = 7,  .af = GPIO_AF1_TIM1,  .timer = timer(1),  .ecm = false },
+    { .port = GPIOE, .pin = 9,  .af = GPIO_AF1_TIM1,  .timer = timer(1),  .ecm = true },
+#endif
+#if !IS_TIMER_CLAIMED(TIM2_BASE)
+    { .port = GPIOA, .pin = 0,  .af = GPIO_AF1_TIM2,  .timer = timer(2),  .ecm = false },
+    { .port = GPIOA, .pin = 5,  .af = GPIO_AF1_TIM2,  .timer = timer(2),  .ecm = false },
+    { .port = GPIOA, .pin = 15, .af = GPIO_AF1_TIM2,  .timer = timer(2),  .ecm = false },
+#endif
+#if !IS_TIMER_CLAIMED(TIM3_BASE)
+    { .port = GPIOA, .pin = 6,  .af = GPIO_AF2_TIM3,  .timer = timer(3),  .ecm = true },
+    { .port = GPIOB, .pin = 4,  .af = GPIO_AF2_TIM3,  .timer = timer(3),  .ecm = true },
+    { .port = GPIOD, .pin = 2,  .af = GPIO_AF2_TIM3,  .timer = timer(3),  .ecm = false },
+#endif
+#if !IS_TIMER_CLAIMED(TIM4_BASE)
+    { .port = GPIOB, .pin = 6,  .af = GPIO_AF2_TIM4,  .timer = timer(4),  .ecm = true },
+    { .port = GPIOD, .pin = 12, .af = GPIO_AF2_TIM4,  .timer = timer(4),  .ecm = true },
+    { .port = GPIOE, .pin = 0,  .af = GPIO_AF2_TIM4,  .timer = timer(4),  .ecm = false },
+#endif
+#ifdef TIM9
+    { .port = GPIOA, .pin = 2,  .af = GPIO_AF3_TIM9,  .timer = timer(9),  .ecm = true },
+    { .port = GPIOE, .pin = 5,  .af = GPIO_AF3_TIM9,  .timer = timer(9),  .ecm = true },
+#endif
+#ifdef TIM12
+    { .port = GPIOB, .pin = 14, .af = GPIO_AF9_TIM12, .timer = timer(12), .ecm = true }
+#endif
+};
+
 static dtimer_t *timer_get (TIM_TypeDef *timer)
 {
     dtimer_t *dtimer = NULL;
@@ -245,6 +279,31 @@ hal_timer_t timer_claim (TIM_TypeDef *timer)
     return claimed ? dtimer : NULL;
 }
 
+void timer_release (TIM_TypeDef *timer)
+{
+    dtimer_t *dtimer;
+
+    if((dtimer = timer_get(timer)))
+        dtimer->claimed = false;
+}
+
+// Claims the first available timer that can count pulses on the given pin, returns NULL if none.
+const stm32_pcnt_hw_t *pcnt_claim (GPIO_TypeDef *port, uint8_t pin, hal_timer_t *timer)
+{
+    uint_fast8_t idx;
+    hal_timer_t claimed = NULL;
+
+    for(idx = 0; idx < sizeof(counters) / sizeof(stm32_pcnt_hw_t); idx++) {
+        if(counters[idx].port == port && counters[idx].pin == pin && (claimed = timer_claim(counters[idx].timer))) {
+            if(timer)
+                *timer = claimed;
+            break;
+        }
+    }
+
+    return claimed ? &counters[idx] : NULL;
+}
+
 bool timer_is_claimed (TIM_TypeDef *timer)
 {
     dtimer_t *dtimer = timer_get(timer);
@@ -457,6 +516,8 @@ bool timerStop (hal_timer_t timer)
 
 __attribute__((always_inline)) static inline void _irq_handler (TIM_TypeDef *timer, timer_cfg_t *cfg)
 {
+    ISR_PROFILE_ENTER();
+
     uint32_t irq = timer->SR & timer->DIER;
 
     timer->SR &= ~(TIM_SR_UIF|TIM_SR_CC1IF|TIM_SR_CC2IF|TIM_SR_CC3IF);
@@ -472,6 +533,8 @@ __attribute__((always_inline)) static inline void _irq_handler (TIM_TypeDef *tim
 
     if(irq & TIM_SR_CC3IF)
         cfg->irq2_callback(cfg->context);
+
+    ISR_PROFILE_EXIT(ISR_Timer);
 }
 
 #if !IS_TIMER_CLAIMED(TIM1_BASE)
@@ -570,7 +633,7 @@ ISR_CODE void TIM6_DAC_IRQHandler (void)
 
 #endif // TIM6
 
-#ifdef TIM7
+#if defined(TIM7) && !IS_TIMER_CLAIMED(TIM7_BASE)
 
 enum {
   TIM7_TIDX = LAST_TIDX,
@@ -0,0 +1,118 @@
+/*
+
+  trip_latency.c - limit and e-stop to motion stop latency measurement for STM32F7xx ARM processors
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "driver.h"
+
+#if TRIP_LATENCY_ENABLE
+
+#include <string.h>
+
+#include "grbl/hal.h"
+#include "grbl/system.h"
+#include "grbl/nuts_bolts.h"
+
+DTCM_INIT_DATA trip_latency_t trip_latency = { .min = UINT32_MAX };
+
+// Stale trips are detected from the elapsed ms as the cycle count is ambiguous when the trip is older than the cycle counter period.
+void trip_latency_add (uint32_t cycles, uint32_t ms)
+{
+    uint_fast8_t bin;
+
+    if(ms > TRIP_LATENCY_TIMEOUT_MS) {
+        trip_latency.discarded++;
+        return;
+    }
+
+    bin = 31 - __CLZ(cycles | 1);
+
+    trip_latency.count++;
+    trip_latency.total += cycles;
+    if(cycles < trip_latency.min)
+        trip_latency.min = cycles;
+    if(cycles > trip_latency.max)
+        trip_latency.max = cycles;
+    trip_latency.hist[bin >= TRIP_LATENCY_BINS ? TRIP_LATENCY_BINS - 1 : bin]++;
+}
+
+// $LAT - report min, max and mean cycles and histogram from limit or e-stop interrupt to stepper go idle.
+// $LAT=R - reset statistics.
+static status_code_t trip_latency_report (sys_state_t state, char *args)
+{
+    uint_fast8_t bin;
+    trip_latency_t latency;
+
+    if(args) {
+        if(!(*args == 'R' || *args == 'r') || args[1] != '\0')
+            return Status_InvalidStatement;
+
+        __disable_irq();
+        memset(&trip_latency, 0, sizeof(trip_latency_t));
+        trip_latency.min = UINT32_MAX;
+        __enable_irq();
+
+        return Status_OK;
+    }
+
+    __disable_irq();
+    memcpy(&latency, &trip_latency, sizeof(trip_latency_t));
+    __enable_irq();
+
+    hal.stream.write("[LAT:");
+    hal.stream.write(uitoa(latency.count));
+    hal.stream.write("|clk:");
+    hal.stream.write(uitoa(hal.f_mcu));
+    hal.stream.write("MHz|discarded:");
+    hal.stream.write(uitoa(latency.discarded));
+    if(latency.count) {
+        hal.stream.write("|min:");
+        hal.stream.write(uitoa(latency.min));
+        hal.stream.write("|max:");
+        hal.stream.write(uitoa(latency.max));
+        hal.stream.write("|mean:");
+        hal.stream.write(uitoa((uint32_t)(latency.total / latency.count)));
+        hal.stream.write("|hist:");
+        for(bin = 0; bin < TRIP_LATENCY_BINS; bin++) {
+            if(bin)
+                hal.stream.write(",");
+            hal.stream.write(uitoa(latency.hist[bin]));
+        }
+    }
+    hal.stream.write("]" ASCII_EOL);
+
+    return Status_OK;
+}
+
+void trip_latency_init (void)
+{
+    static const sys_command_t trip_latency_command_list[] = {
+        {"LAT", trip_latency_report, { .allow_blocking = On }, { .str = "output limit and e-stop to motion stop latency in CPU cycles, $LAT=R to reset" } }
+    };
+
+    static sys_commands_t trip_latency_commands = {
+        .n_commands = sizeof(trip_latency_command_list) / sizeof(sys_command_t),
+        .commands = trip_latency_command_list
+    };
+
+    system_register_commands(&trip_latency_commands);
+}
+
+#endif // TRIP_LATENCY_ENABLE
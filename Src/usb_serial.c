@@ -30,10 +30,11 @@
 #include "usb_device.h"
 
 #include "usb_serial.h"
+#include "stream_span.h"
 #include "../grbl/grbl.h"
 #include "../grbl/protocol.h"
 
-static stream_rx_buffer_t rxbuf = {0};
+DTCM_DATA static stream_rx_buffer_t rxbuf = {0};
 static stream_block_tx_buffer2_t txbuf = {0};
 static enqueue_realtime_command_ptr enqueue_realtime_command = protocol_enqueue_realtime_command;
 
@@ -241,6 +242,10 @@ const io_stream_t *usbInit (void)
     txbuf.s = txbuf.data;
     txbuf.max_length = BLOCK_TX_BUFFER_SIZE;
 
+#if STREAM_SPAN_ENABLE
+    stream_span_register(stream.read, &rxbuf, NULL);
+#endif
+
     return &stream;
 }
 
@@ -76,7 +76,55 @@ LoopCopyDataInit:
   adds r4, r0, r3
   cmp r4, r1
   bcc CopyDataInit
+
+/* Copy code to ITCM RAM */
+  ldr r0, =_sitcmram
+  ldr r1, =_eitcmram
+  ldr r2, =_siitcmram
+  movs r3, #0
+  b LoopITCMInit
+
+CopyITCMInit:
+  ldr r4, [r2, r3]
+  str r4, [r0, r3]
+  adds r3, r3, #4
+
+LoopITCMInit:
+  adds r4, r0, r3
+  cmp r4, r1
+  bcc CopyITCMInit
   
+/* Copy the DTCM data initializers from flash */
+  ldr r0, =_sdtcmram
+  ldr r1, =_edtcmram
+  ldr r2, =_sidtcmram
+  movs r3, #0
+  b LoopDTCMInit
+
+CopyDTCMInit:
+  ldr r4, [r2, r3]
+  str r4, [r0, r3]
+  adds r3, r3, #4
+
+LoopDTCMInit:
+  adds r4, r0, r3
+  cmp r4, r1
+  bcc CopyDTCMInit
+
+/* Zero fill the DTCM bss segment. */
+  ldr r2, =_sdtcmbss
+  ldr r4, =_edtcmbss
+  movs r3, #0
+  b LoopFillZeroDTCMbss
+
+FillZeroDTCMbss:
+  str  r3, [r2]
+  adds r2, r2, #4
+
+LoopFillZeroDTCMbss:
+  cmp r2, r4
+  bcc FillZeroDTCMbss
+
 /* Zero fill the bss segment. */
   ldr r2, =_sbss
   ldr r4, =_ebss
@@ -9,7 +9,6 @@ src_dir = Src
 [common]
 build_flags =
   -I .
-  -D L1_CACHE_ENABLE=1
   -D OVERRIDE_MY_MACHINE
   -I FatFs
   -I FatFs/STM
@@ -24,6 +23,7 @@ build_flags =
   '-D ISR_CODE=__attribute__((section(".itcmram")))'
   -Wl,-u,_printf_float
   -Wl,-u,_scanf_float
+  -Wl,--print-memory-usage
 lib_deps =
   bluetooth
   grbl
@@ -0,0 +1,193 @@
+/*
+
+  cmsis_host.h - host replacement for the CMSIS GCC compiler header, part of the step timing simulator
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+Force included ahead of all other headers. Defines the include guard of cmsis_gcc.h so the ARM inline assembly versions of
+the core intrinsics are never seen by the host compiler, and provides host equivalents: barriers are compiler barriers,
+the interrupt mask is a plain variable and the bit manipulation intrinsics map to GCC builtins.
+
+*/
+
+#pragma once
+
+#define __CMSIS_GCC_H
+
+#include <stdint.h>
+
+#ifndef   __ASM
+  #define __ASM                                  __asm
+#endif
+#ifndef   __INLINE
+  #define __INLINE                               inline
+#endif
+#ifndef   __STATIC_INLINE
+  #define __STATIC_INLINE                        static inline
+#endif
+#ifndef   __STATIC_FORCEINLINE
+  #define __STATIC_FORCEINLINE                   __attribute__((always_inline)) static inline
+#endif
+#ifndef   __NO_RETURN
+  #define __NO_RETURN                            __attribute__((__noreturn__))
+#endif
+#ifndef   __USED
+  #define __USED                                 __attribute__((used))
+#endif
+#ifndef   __WEAK
+  #define __WEAK                                 __attribute__((weak))
+#endif
+#ifndef   __PACKED
+  #define __PACKED                               __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __PACKED_STRUCT
+  #define __PACKED_STRUCT                        struct __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __PACKED_UNION
+  #define __PACKED_UNION                         union __attribute__((packed, aligned(1)))
+#endif
+#ifndef   __UNALIGNED_UINT32
+  #define __UNALIGNED_UINT32(x)                  (*((uint32_t *)(x)))
+#endif
+#ifndef   __UNALIGNED_UINT16_WRITE
+  #define __UNALIGNED_UINT16_WRITE(addr, val)    (void)(*((uint16_t *)(addr)) = (val))
+#endif
+#ifndef   __UNALIGNED_UINT16_READ
+  #define __UNALIGNED_UINT16_READ(addr)          (*((const uint16_t *)(addr)))
+#endif
+#ifndef   __UNALIGNED_UINT32_WRITE
+  #define __UNALIGNED_UINT32_WRITE(addr, val)    (void)(*((uint32_t *)(addr)) = (val))
+#endif
+#ifndef   __UNALIGNED_UINT32_READ
+  #define __UNALIGNED_UINT32_READ(addr)          (*((const uint32_t *)(addr)))
+#endif
+#ifndef   __ALIGNED
+  #define __ALIGNED(x)                           __attribute__((aligned(x)))
+#endif
+#ifndef   __RESTRICT
+  #define __RESTRICT                             __restrict
+#endif
+#ifndef   __COMPILER_BARRIER
+  #define __COMPILER_BARRIER()                   __asm volatile("":::"memory")
+#endif
+
+// Core register access, the interrupt mask is owned by the simulator
+
+extern uint32_t sim_primask;
+
+__STATIC_FORCEINLINE void __enable_irq (void)                   { sim_primask = 0; }
+__STATIC_FORCEINLINE void __disable_irq (void)                  { sim_primask = 1; }
+__STATIC_FORCEINLINE uint32_t __get_PRIMASK (void)              { return sim_primask; }
+__STATIC_FORCEINLINE void __set_PRIMASK (uint32_t priMask)      { sim_primask = priMask & 1; }
+__STATIC_FORCEINLINE void __enable_fault_irq (void)             { }
+__STATIC_FORCEINLINE void __disable_fault_irq (void)            { }
+__STATIC_FORCEINLINE uint32_t __get_FAULTMASK (void)            { return 0; }
+__STATIC_FORCEINLINE void __set_FAULTMASK (uint32_t faultMask)  { (void)faultMask; }
+__STATIC_FORCEINLINE uint32_t __get_BASEPRI (void)              { return 0; }
+__STATIC_FORCEINLINE void __set_BASEPRI (uint32_t basePri)      { (void)basePri; }
+__STATIC_FORCEINLINE void __set_BASEPRI_MAX (uint32_t basePri)  { (void)basePri; }
+__STATIC_FORCEINLINE uint32_t __get_CONTROL (void)              { return 0; }
+__STATIC_FORCEINLINE void __set_CONTROL (uint32_t control)      { (void)control; }
+__STATIC_FORCEINLINE uint32_t __get_IPSR (void)                 { return 0; }
+__STATIC_FORCEINLINE uint32_t __get_APSR (void)                 { return 0; }
+__STATIC_FORCEINLINE uint32_t __get_xPSR (void)                 { return 0; }
+__STATIC_FORCEINLINE uint32_t __get_PSP (void)                  { return 0; }
+__STATIC_FORCEINLINE void __set_PSP (uint32_t topOfProcStack)   { (void)topOfProcStack; }
+__STATIC_FORCEINLINE uint32_t __get_MSP (void)                  { return 0; }
+__STATIC_FORCEINLINE void __set_MSP (uint32_t topOfMainStack)   { (void)topOfMainStack; }
+__STATIC_FORCEINLINE uint32_t __get_FPSCR (void)                { return 0; }
+__STATIC_FORCEINLINE void __set_FPSCR (uint32_t fpscr)          { (void)fpscr; }
+
+// Barriers and hints
+
+#define __NOP()     __COMPILER_BARRIER()
+#define __WFI()     __COMPILER_BARRIER()
+#define __WFE()     __COMPILER_BARRIER()
+#define __SEV()     __COMPILER_BARRIER()
+#define __BKPT(value) __builtin_trap()
+
+__STATIC_FORCEINLINE void __ISB (void) { __sync_synchronize(); }
+__STATIC_FORCEINLINE void __DSB (void) { __sync_synchronize(); }
+__STATIC_FORCEINLINE void __DMB (void) { __sync_synchronize(); }
+
+// Bit manipulation
+
+__STATIC_FORCEINLINE uint32_t __REV (uint32_t value)            { return __builtin_bswap32(value); }
+__STATIC_FORCEINLINE uint32_t __REV16 (uint32_t value)          { return ((value & 0xFF00FF00UL) >> 8) | ((value & 0x00FF00FFUL) << 8); }
+__STATIC_FORCEINLINE int16_t __REVSH (int16_t value)            { return (int16_t)__builtin_bswap16((uint16_t)value); }
+__STATIC_FORCEINLINE uint32_t __ROR (uint32_t op1, uint32_t op2)
+{
+    op2 %= 32U;
+
+    return op2 == 0U ? op1 : (op1 >> op2) | (op1 << (32U - op2));
+}
+
+__STATIC_FORCEINLINE uint32_t __RBIT (uint32_t value)
+{
+    uint32_t result = 0;
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < 32; idx++) {
+        result = (result << 1) | (value & 1U);
+        value >>= 1;
+    }
+
+    return result;
+}
+
+__STATIC_FORCEINLINE uint8_t __CLZ (uint32_t value)             { return value == 0U ? 32U : (uint8_t)__builtin_clz(value); }
+
+__STATIC_FORCEINLINE int32_t __SSAT (int32_t val, uint32_t sat)
+{
+    if((sat >= 1U) && (sat <= 32U)) {
+        const int32_t max = (int32_t)((1U << (sat - 1U)) - 1U);
+        const int32_t min = -1 - max;
+        if(val > max)
+            return max;
+        else if(val < min)
+            return min;
+    }
+
+    return val;
+}
+
+__STATIC_FORCEINLINE uint32_t __USAT (int32_t val, uint32_t sat)
+{
+    if(sat <= 31U) {
+        const uint32_t max = ((1U << sat) - 1U);
+        if(val > (int32_t)max)
+            return max;
+        else if(val < 0)
+            return 0U;
+    }
+
+    return (uint32_t)val;
+}
+
+// Exclusive access, the simulator is single threaded so a store always succeeds
+
+__STATIC_FORCEINLINE uint8_t __LDREXB (volatile uint8_t *addr)                  { return *addr; }
+__STATIC_FORCEINLINE uint16_t __LDREXH (volatile uint16_t *addr)                { return *addr; }
+__STATIC_FORCEINLINE uint32_t __LDREXW (volatile uint32_t *addr)                { return *addr; }
+__STATIC_FORCEINLINE uint32_t __STREXB (uint8_t value, volatile uint8_t *addr)  { *addr = value; return 0; }
+__STATIC_FORCEINLINE uint32_t __STREXH (uint16_t value, volatile uint16_t *addr){ *addr = value; return 0; }
+__STATIC_FORCEINLINE uint32_t __STREXW (uint32_t value, volatile uint32_t *addr){ *addr = value; return 0; }
+__STATIC_FORCEINLINE void __CLREX (void)                                        { }
@@ -0,0 +1,641 @@
+/*
+
+  step_sim.c - host step timing simulator for the STM32F7xx driver
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+Runs the unmodified stepper code in Src/driver.c on a Linux host against a register model of the stepper timer (TIM5) and the
+GPIO step and direction outputs, for regression testing step pulse timing without hardware.
+
+The peripheral address ranges are mapped as plain memory at their real addresses so the CMSIS register macros work as is.
+The simulator advances TIM5 one timer tick at a time: down counting with a preloaded ARR, update on underflow and compare
+flags on CCR1 and CCR2 matches. When a flag enabled in DIER is raised the driver interrupt handler is called after a
+configurable latency, the step and direction outputs are then sampled and time stamped. The core stepper interrupt is
+replaced by a replay of a segment file, the step and direction bits of each tick are output by the next interrupt just as
+the core does.
+
+Segment file format, one segment per line, # starts a comment:
+
+<cycles_per_tick> <step bits> <direction bits> [<tick count>]
+
+cycles_per_tick is in stepper timer ticks, bits are axis masks with bit 0 for X, numbers may be given in hex with a 0x prefix.
+
+Reported statistics are in microseconds: pulse width, pulse off time, direction setup time before the next pulse on the same
+axis and step output latency from the stepper timer update event. The exit code is 1 if the pulse width, off time, direction
+setup or direction hold times violate the settings, so runs can be used as regression tests.
+
+The time between stepper timer update events is checked against the segments as well: ARR is preloaded, so the cycles_per_tick
+value set when a tick is loaded must govern the period starting at the next update event, floored to the minimum step period
+of pulse length plus STEP_PULSE_TOFF_MIN. Periods that differ are reported as violations, except that a period may be longer
+when the pulse off handler has moved the counter to guarantee the minimum off time.
+
+Only the GPIO step output modes are modelled, STEP_DMA_ENABLE, STEP_OPM_ENABLE and STEP_PORTMAP_ENABLE builds are rejected.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+// BSRR is a write only set/reset register that plain memory cannot model, output pin writes are applied to ODR instead.
+#define DIGITAL_OUT(port, bit, on) { if(on) (port)->ODR |= (bit); else (port)->ODR &= ~(bit); }
+
+#include "driver.c"
+
+#if STEP_DMA_ENABLE || STEP_OPM_ENABLE || STEP_PORTMAP_ENABLE
+#error "The step timing simulator models the GPIO step output modes only!"
+#endif
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE MAP_FIXED
+#endif
+
+#define SIM_F_PCLK1 54000000UL // APB1 clock with the core running at 216 MHz, stepper timer runs at twice this
+#define SIM_IRQ_FLAGS (TIM_SR_UIF|TIM_SR_CC1IF|TIM_SR_CC2IF)
+#define SIM_MAX_AXES 6
+
+// Normally provided by the core and the CMSIS startup code.
+hal_t hal;
+settings_t settings;
+uint32_t sim_primask;
+
+typedef struct {
+    uint32_t n;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+} sim_stat_t;
+
+typedef struct {
+    char name;
+    GPIO_TypeDef *step_port;
+    uint32_t step_bit;
+    GPIO_TypeDef *dir_port;
+    uint32_t dir_bit;
+    uint8_t mask;
+    bool step;
+    bool dir;
+    bool dir_pending;
+    bool stepped;
+    uint64_t t_step_on;
+    uint64_t t_step_off;
+    uint64_t t_dir;
+} sim_axis_t;
+
+typedef struct {
+    uint32_t cycles_per_tick;
+    axes_signals_t step_out;
+    axes_signals_t dir_out;
+    uint32_t count;
+} sim_segment_t;
+
+static sim_axis_t axis[SIM_MAX_AXES] = {
+    { .name = 'X', .step_port = X_STEP_PORT, .step_bit = X_STEP_BIT, .dir_port = X_DIRECTION_PORT, .dir_bit = X_DIRECTION_BIT, .mask = bit(X_AXIS) },
+    { .name = 'Y', .step_port = Y_STEP_PORT, .step_bit = Y_STEP_BIT, .dir_port = Y_DIRECTION_PORT, .dir_bit = Y_DIRECTION_BIT, .mask = bit(Y_AXIS) },
+    { .name = 'Z', .step_port = Z_STEP_PORT, .step_bit = Z_STEP_BIT, .dir_port = Z_DIRECTION_PORT, .dir_bit = Z_DIRECTION_BIT, .mask = bit(Z_AXIS) },
+#ifdef A_AXIS
+    { .name = 'A', .step_port = A_STEP_PORT, .step_bit = A_STEP_BIT, .dir_port = A_DIRECTION_PORT, .dir_bit = A_DIRECTION_BIT, .mask = bit(A_AXIS) },
+#endif
+#ifdef B_AXIS
+    { .name = 'B', .step_port = B_STEP_PORT, .step_bit = B_STEP_BIT, .dir_port = B_DIRECTION_PORT, .dir_bit = B_DIRECTION_BIT, .mask = bit(B_AXIS) },
+#endif
+#ifdef C_AXIS
+    { .name = 'C', .step_port = C_STEP_PORT, .step_bit = C_STEP_BIT, .dir_port = C_DIRECTION_PORT, .dir_bit = C_DIRECTION_BIT, .mask = bit(C_AXIS) },
+#endif
+};
+
+static uint_fast8_t n_axes;
+
+static struct {
+    uint64_t t;             // current time, stepper timer ticks
+    uint64_t t_update;      // time of last update event
+    uint64_t t_exec;        // time pending interrupt will be executed
+    uint64_t t_busy;        // end of last interrupt handler execution
+    uint32_t arr;           // active reload value, ARR is preloaded
+    uint32_t latency_on;    // interrupt latency to step output from the update event, ticks
+    uint32_t latency_off;   // interrupt latency to output from compare events, ticks
+    uint32_t jitter;        // max random latency added, ticks
+    uint32_t seed;
+    bool pending;
+} timer;
+
+static struct {
+    sim_segment_t *segment;
+    uint32_t n_segments;
+    uint32_t idx;
+    uint32_t count;
+    bool running;
+    bool done;
+    stepper_t stepper;
+} replay;
+
+static struct {
+    uint64_t t_update;      // time of last update event
+    uint32_t floor;         // minimum step period, ticks
+    uint32_t current;       // expected reload value for the current period, 0 if not known
+    uint32_t next;          // expected reload value for the next period, set when a tick is loaded
+    uint32_t checked;
+    uint32_t clamped;
+    uint32_t stretched;
+    bool cnt_written;       // counter written by the interrupt handler in the current period
+} period;
+
+static struct {
+    sim_stat_t pw, off, dir_setup, latency;
+    uint32_t steps;
+    uint32_t violations;
+} stats;
+
+static FILE *vcd = NULL;
+static bool verbose = false;
+
+static double ticks_to_us (uint64_t ticks)
+{
+    return (double)ticks * 1000000.0 / (double)hal.f_step_timer;
+}
+
+static uint32_t us_to_ticks (float us)
+{
+    return (uint32_t)ceilf((float)hal.f_step_timer / 1000000.0f * us);
+}
+
+static void stat_add (sim_stat_t *stat, uint64_t value)
+{
+    if(stat->n++ == 0)
+        stat->min = stat->max = value;
+    else {
+        if(value < stat->min)
+            stat->min = value;
+        if(value > stat->max)
+            stat->max = value;
+    }
+    stat->sum += value;
+}
+
+static void stat_report (const char *name, sim_stat_t *stat)
+{
+    if(stat->n)
+        printf("%-10s min %9.3f  max %9.3f  avg %9.3f us  (%u)\n", name, ticks_to_us(stat->min), ticks_to_us(stat->max),
+                ticks_to_us(stat->sum / stat->n), stat->n);
+    else
+        printf("%-10s -\n", name);
+}
+
+static void violation (sim_axis_t *ax, const char *what, uint64_t ticks, float limit)
+{
+    stats.violations++;
+    fprintf(stderr, "%.3f us: %c %s %.3f us < %.3f us\n", ticks_to_us(timer.t), ax->name, what, ticks_to_us(ticks), limit);
+}
+
+static void period_violation (uint64_t ticks, uint32_t expected)
+{
+    stats.violations++;
+    fprintf(stderr, "%.3f us: step period %llu ticks != %u ticks\n", ticks_to_us(timer.t), (unsigned long long)ticks, expected);
+}
+
+// Called on update events, checks the period that just ended and makes the period of the tick loaded last the current one.
+static void period_update (void)
+{
+    uint64_t ticks = timer.t - period.t_update;
+
+    if(period.current) {
+        period.checked++;
+        if(period.cnt_written && ticks > period.current + 1)
+            period.stretched++;
+        else if(ticks != period.current + 1) // down counting from ARR to 0 inclusive
+            period_violation(ticks, period.current + 1);
+    }
+
+    period.cnt_written = false;
+    period.t_update = timer.t;
+    period.current = period.next;
+    period.next = 0;
+}
+
+static void vcd_header (void)
+{
+    uint_fast8_t idx;
+
+    fprintf(vcd, "$timescale 1ns $end\n$scope module step_sim $end\n");
+    for(idx = 0; idx < n_axes; idx++) {
+        fprintf(vcd, "$var wire 1 %c %c_step $end\n", '!' + idx * 2, axis[idx].name);
+        fprintf(vcd, "$var wire 1 %c %c_dir $end\n", '!' + idx * 2 + 1, axis[idx].name);
+    }
+    fprintf(vcd, "$upscope $end\n$enddefinitions $end\n#0\n");
+    for(idx = 0; idx < n_axes; idx++)
+        fprintf(vcd, "%d%c\n%d%c\n", axis[idx].step, '!' + idx * 2, axis[idx].dir, '!' + idx * 2 + 1);
+}
+
+static void vcd_change (sim_axis_t *ax, bool dir, bool level)
+{
+    static uint64_t t_last = 0;
+
+    uint64_t t_ns = (uint64_t)(ticks_to_us(timer.t) * 1000.0 + 0.5);
+
+    if(t_ns != t_last) {
+        t_last = t_ns;
+        fprintf(vcd, "#%llu\n", (unsigned long long)t_ns);
+    }
+
+    fprintf(vcd, "%d%c\n", level, (char)('!' + (ax - axis) * 2 + dir));
+}
+
+// Sample step and direction outputs as signal levels with inversion removed.
+static void outputs_sample (bool init)
+{
+    uint_fast8_t idx;
+    bool level;
+    sim_axis_t *ax;
+
+    for(idx = 0; idx < n_axes; idx++) {
+
+        ax = &axis[idx];
+
+        level = !!(ax->dir_port->ODR & ax->dir_bit) ^ !!(settings.steppers.dir_invert.mask & ax->mask);
+        if(init)
+            ax->dir = level;
+        else if(level != ax->dir) {
+            ax->dir = level;
+            ax->t_dir = timer.t;
+            ax->dir_pending = true;
+            if(ax->step)
+                violation(ax, "direction hold", timer.t - ax->t_step_on, settings.steppers.pulse_microseconds);
+            if(verbose)
+                printf("%12.3f %c dir %d\n", ticks_to_us(timer.t), ax->name, level);
+            if(vcd)
+                vcd_change(ax, true, level);
+        }
+
+        level = !!(ax->step_port->ODR & ax->step_bit) ^ !!(settings.steppers.step_invert.mask & ax->mask);
+        if(init)
+            ax->step = level;
+        else if(level != ax->step) {
+            ax->step = level;
+            if(level) {
+                stats.steps++;
+                stat_add(&stats.latency, timer.t - timer.t_update);
+                if(ax->stepped) {
+                    stat_add(&stats.off, timer.t - ax->t_step_off);
+                    if(ticks_to_us(timer.t - ax->t_step_off) < STEP_PULSE_TOFF_MIN)
+                        violation(ax, "pulse off time", timer.t - ax->t_step_off, STEP_PULSE_TOFF_MIN);
+                }
+                if(ax->dir_pending) {
+                    ax->dir_pending = false;
+                    stat_add(&stats.dir_setup, timer.t - ax->t_dir);
+                    if(ticks_to_us(timer.t - ax->t_dir) < settings.steppers.pulse_delay_microseconds)
+                        violation(ax, "direction setup", timer.t - ax->t_dir, settings.steppers.pulse_delay_microseconds);
+                }
+                ax->t_step_on = timer.t;
+            } else {
+                ax->stepped = true;
+                ax->t_step_off = timer.t;
+                stat_add(&stats.pw, timer.t - ax->t_step_on);
+                if(ticks_to_us(timer.t - ax->t_step_on) < settings.steppers.pulse_microseconds)
+                    violation(ax, "pulse width", timer.t - ax->t_step_on, settings.steppers.pulse_microseconds);
+            }
+            if(verbose)
+                printf("%12.3f %c step %d\n", ticks_to_us(timer.t), ax->name, level);
+            if(vcd)
+                vcd_change(ax, false, level);
+        }
+    }
+}
+
+// Replaces the core stepper interrupt: outputs the bits of the previous tick, then loads the next tick from the segments.
+static void sim_stepper_interrupt (void)
+{
+    static sim_segment_t *segment = NULL;
+
+    if(replay.running)
+        hal.stepper.pulse_start(&replay.stepper);
+
+    if(replay.count == 0) {
+
+        if(replay.idx == replay.n_segments) {
+            replay.running = false;
+            replay.done = true;
+            hal.stepper.go_idle(false);
+            return;
+        }
+
+        segment = &replay.segment[replay.idx++];
+        replay.count = segment->count;
+        hal.stepper.cycles_per_tick(segment->cycles_per_tick);
+    }
+
+    if((period.next = segment->cycles_per_tick) < period.floor) {
+        period.next = period.floor;
+        period.clamped++;
+    }
+
+    replay.count--;
+    replay.running = true;
+    replay.stepper.dir_changed.bits = segment->dir_out.bits ^ replay.stepper.dir_out.bits;
+    replay.stepper.dir_out = segment->dir_out;
+    replay.stepper.step_out = segment->step_out;
+}
+
+static uint32_t latency_jitter (void)
+{
+    if(timer.jitter == 0)
+        return 0;
+
+    timer.seed = timer.seed * 1103515245UL + 12345UL;
+
+    return (timer.seed >> 8) % (timer.jitter + 1);
+}
+
+// Advances the stepper timer by one tick.
+static void timer_tick (void)
+{
+    TIM_TypeDef *tim = STEPPER_TIMER;
+
+    // Update generated by software, the update flag is cleared by the driver immediately after so it is not raised here.
+    if(tim->EGR & TIM_EGR_UG) {
+        tim->EGR = 0;
+        tim->CNT = timer.arr = tim->ARR;
+        return;
+    }
+
+    if(!(tim->CR1 & TIM_CR1_CEN))
+        return;
+
+    if(!(tim->CR1 & TIM_CR1_ARPE))
+        timer.arr = tim->ARR;
+
+    if(tim->CNT == 0) {
+        tim->CNT = timer.arr = tim->ARR;
+        tim->SR |= TIM_SR_UIF;
+        timer.t_update = timer.t;
+        period_update();
+    } else
+        tim->CNT--;
+
+    if(tim->CNT == tim->CCR1)
+        tim->SR |= TIM_SR_CC1IF;
+
+    if(tim->CNT == tim->CCR2)
+        tim->SR |= TIM_SR_CC2IF;
+}
+
+// Raises the stepper interrupt when an enabled flag is set and executes the handler when the latency has expired.
+static void irq_service (void)
+{
+    uint32_t flags = STEPPER_TIMER->SR & STEPPER_TIMER->DIER & SIM_IRQ_FLAGS;
+
+    if(!timer.pending && flags) {
+        timer.pending = true;
+        timer.t_exec = timer.t + ((flags & (TIM_SR_CC1IF|TIM_SR_CC2IF)) ? timer.latency_off : timer.latency_on) + latency_jitter();
+        if(timer.t_exec < timer.t_busy)
+            timer.t_exec = timer.t_busy;
+    }
+
+    if(timer.pending && timer.t >= timer.t_exec) {
+
+        timer.pending = false;
+        timer.t_busy = timer.t + 1;
+
+        DWT->CYCCNT = (uint32_t)(timer.t * (hal.f_mcu * 1000000ULL) / hal.f_step_timer);
+
+        uint32_t cnt = STEPPER_TIMER->CNT;
+
+        STEPPER_TIMER_IRQHandler();
+
+        period.cnt_written |= STEPPER_TIMER->CNT != cnt;
+
+        outputs_sample(false);
+    }
+}
+
+static bool segments_load (const char *filename)
+{
+    char line[256], *s, *end;
+    uint32_t lineno = 0, size = 0, value[4];
+    uint_fast8_t idx;
+    FILE *file;
+
+    if((file = fopen(filename, "r")) == NULL) {
+        perror(filename);
+        return false;
+    }
+
+    while(fgets(line, sizeof(line), file)) {
+
+        lineno++;
+
+        if((s = strchr(line, '#')))
+            *s = '\0';
+
+        s = line;
+        value[3] = 1;
+
+        for(idx = 0; idx < 4; idx++) {
+            value[idx] = strtoul(s, &end, 0);
+            if(end == s)
+                break;
+            s = end;
+        }
+
+        if(idx == 0)
+            continue;
+
+        if(idx < 3 || value[0] == 0 || value[3] == 0) {
+            fprintf(stderr, "%s:%u: expected <cycles_per_tick> <step bits> <direction bits> [<tick count>]\n", filename, lineno);
+            fclose(file);
+            return false;
+        }
+
+        if(replay.n_segments == size) {
+            size = size ? size * 2 : 256;
+            if((replay.segment = realloc(replay.segment, size * sizeof(sim_segment_t))) == NULL) {
+                fclose(file);
+                return false;
+            }
+        }
+
+        replay.segment[replay.n_segments].cycles_per_tick = value[0];
+        replay.segment[replay.n_segments].step_out.bits = (uint8_t)value[1];
+        replay.segment[replay.n_segments].dir_out.bits = (uint8_t)value[2];
+        replay.segment[replay.n_segments++].count = value[3];
+    }
+
+    fclose(file);
+
+    return replay.n_segments > 0;
+}
+
+// Maps the peripheral and core private peripheral address ranges as zeroed memory.
+static bool registers_map (void)
+{
+    static const struct {
+        uintptr_t base;
+        size_t size;
+    } region[] = {
+        { PERIPH_BASE, 0x80000 }, // APB1, APB2 and AHB1 peripherals
+        { ITM_BASE,    0x100000 } // ITM, DWT and the system control space
+    };
+
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < sizeof(region) / sizeof(region[0]); idx++) {
+        if(mmap((void *)region[idx].base, region[idx].size, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANONYMOUS|MAP_FIXED_NOREPLACE, -1, 0) != (void *)region[idx].base) {
+            fprintf(stderr, "unable to map registers at 0x%08lx\n", (unsigned long)region[idx].base);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void usage (const char *name)
+{
+    fprintf(stderr, "usage: %s [options] <segment file>\n"
+                    "  -p <us>   step pulse length, $0 (default 5.0)\n"
+                    "  -d <us>   step pulse delay, $29 (default 0.0)\n"
+                    "  -s <mask> step invert mask, $2\n"
+                    "  -i <mask> direction invert mask, $3\n"
+                    "  -n <ns>   interrupt latency to step output from the update event (default %.0f)\n"
+                    "  -f <ns>   interrupt latency to output from the compare events (default %.0f)\n"
+                    "  -j <ns>   max random latency added to each interrupt\n"
+                    "  -w <file> write waveform in VCD format\n"
+                    "  -v        list output changes\n",
+                    name, STEP_PULSE_TON_LATENCY * 1000.0f, STEP_PULSE_TOFF_LATENCY * 1000.0f);
+}
+
+int main (int argc, char **argv)
+{
+    int opt;
+    float latency_on = STEP_PULSE_TON_LATENCY, latency_off = STEP_PULSE_TOFF_LATENCY, jitter = 0.0f;
+
+    settings.steppers.pulse_microseconds = 5.0f;
+
+    while((opt = getopt(argc, argv, "p:d:s:i:n:f:j:w:v")) != -1) switch(opt) {
+
+        case 'p':
+            settings.steppers.pulse_microseconds = strtof(optarg, NULL);
+            break;
+
+        case 'd':
+            settings.steppers.pulse_delay_microseconds = strtof(optarg, NULL);
+            break;
+
+        case 's':
+            settings.steppers.step_invert.mask = (uint8_t)strtoul(optarg, NULL, 0);
+            break;
+
+        case 'i':
+            settings.steppers.dir_invert.mask = (uint8_t)strtoul(optarg, NULL, 0);
+            break;
+
+        case 'n':
+            latency_on = strtof(optarg, NULL) / 1000.0f;
+            break;
+
+        case 'f':
+            latency_off = strtof(optarg, NULL) / 1000.0f;
+            break;
+
+        case 'j':
+            jitter = strtof(optarg, NULL) / 1000.0f;
+            break;
+
+        case 'w':
+            if((vcd = fopen(optarg, "w")) == NULL) {
+                perror(optarg);
+                return 2;
+            }
+            break;
+
+        case 'v':
+            verbose = true;
+            break;
+
+        default:
+            usage(argv[0]);
+            return 2;
+    }
+
+    if(optind != argc - 1 || settings.steppers.pulse_microseconds < 2.0f) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if(!segments_load(argv[optind]) || !registers_map())
+        return 2;
+
+    n_axes = min(N_AXIS, SIM_MAX_AXES);
+
+    hal.f_mcu = 216;
+    hal.f_step_timer = SIM_F_PCLK1 * 2 / STEPPER_TIMER_DIV;
+    hal.driver_cap.step_pulse_delay = On;
+    hal.stepper.enable = stepperEnable;
+    hal.stepper.go_idle = stepperGoIdle;
+    hal.stepper.cycles_per_tick = stepperCyclesPerTick;
+    hal.stepper.interrupt_callback = sim_stepper_interrupt;
+
+    timer.latency_on = us_to_ticks(latency_on);
+    timer.latency_off = us_to_ticks(latency_off);
+    timer.jitter = us_to_ticks(jitter);
+    timer.seed = 1;
+
+    STEPPER_TIMER->CR1 = TIM_CR1_DIR|TIM_CR1_ARPE; // as configured by driver_setup()
+
+#if USE_STEPDIR_MAP
+    stepdirmap_init(&settings);
+#endif
+    step_pulse_init(&settings);
+
+    period.floor = us_to_ticks(settings.steppers.pulse_microseconds + STEP_PULSE_TOFF_MIN);
+
+    hal.stepper.go_idle(true);
+    outputs_sample(true);
+
+    if(vcd)
+        vcd_header();
+
+    hal.stepper.wake_up = stepperWakeUp;
+    hal.stepper.wake_up();
+
+    for(timer.t = 0; !(replay.done && !timer.pending && !(STEPPER_TIMER->DIER & SIM_IRQ_FLAGS)); timer.t++) {
+        timer_tick();
+        irq_service();
+    }
+
+    printf("timer %lu Hz, pulse %.3f us, delay %.3f us, latency %.3f/%.3f us, jitter %.3f us\n",
+            (unsigned long)hal.f_step_timer, settings.steppers.pulse_microseconds, settings.steppers.pulse_delay_microseconds,
+             ticks_to_us(timer.latency_on), ticks_to_us(timer.latency_off), ticks_to_us(timer.jitter));
+    printf("%u segments, %u steps, %.3f ms\n", replay.n_segments, stats.steps, ticks_to_us(timer.t) / 1000.0);
+    stat_report("pw", &stats.pw);
+    stat_report("off", &stats.off);
+    stat_report("dir", &stats.dir_setup);
+    stat_report("latency", &stats.latency);
+    printf("%u periods checked, %u clamped to the %.3f us minimum, %u stretched for the pulse off time\n", period.checked, period.clamped,
+            ticks_to_us(period.floor), period.stretched);
+    printf("%u violations\n", stats.violations);
+
+    if(vcd)
+        fclose(vcd);
+
+    return stats.violations ? 1 : 0;
+}
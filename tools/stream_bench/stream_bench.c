@@ -0,0 +1,696 @@
+/*
+
+  stream_bench.c - host side of the $SBM input stream benchmark
+
+  Part of grblHAL
+
+  Copyright (c) 2026 Terje Io
+
+  grblHAL is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  grblHAL is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with grblHAL. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+
+Pushes synthetic G-code at full speed to a controller running the $SBM command, see Inc/stream_bench.h, and reports host and
+controller side throughput, ? status report round trip latency and input buffer overflows.
+
+The controller is reached by a serial device, UART or USB CDC, or by a Telnet connection. Without a board the local stand-in is
+used: a child process connected by a socket pair that answers $SBM and ? as the controller does, for testing the tool itself and
+for a baseline of the host side overhead.
+
+The run is: $SBM=<mode>, wait for [SBM:ready|<mode>], send the lines with a ? interleaved every status interval, send a % line
+and wait for the final [SBM:...] report. Characters sent that are not counted by the controller are reported as lost, the exit
+code is 1 if any characters were lost or overflows were reported.
+
+*/
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <termios.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define READY_TIMEOUT_MS    2000
+#define REPORT_TIMEOUT_MS   5000 // the controller ends the run 2 seconds after the last character received
+#define STANDIN_TIMEOUT_MS  2000
+
+#define ASCII_LF    '\n'
+#define ASCII_CR    '\r'
+
+#define TELNET_IAC  255
+#define TELNET_WILL 251
+
+typedef struct {
+    int fd;
+    bool telnet;
+    uint_fast8_t iac;       // telnet command bytes left to skip
+    size_t rx_length;
+    char rx[1024];
+} link_t;
+
+typedef struct {
+    uint32_t n;
+    double min, max, sum;
+} stat_t;
+
+typedef struct {
+    bool valid;
+    bool has_ovf;
+    uint32_t lines, bytes, ms, bps, lps, peak, ovf;
+} report_t;
+
+static const char *mode_name[] = { "sink", "echo", "timestamp" };
+
+static double now_ms (void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+static void stat_add (stat_t *stat, double value)
+{
+    if(stat->n == 0 || value < stat->min)
+        stat->min = value;
+    if(stat->n == 0 || value > stat->max)
+        stat->max = value;
+    stat->sum += value;
+    stat->n++;
+}
+
+static void nonblocking (int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static bool write_all (int fd, const char *s, size_t length)
+{
+    ssize_t n;
+
+    while(length) {
+        if((n = write(fd, s, length)) < 0) {
+            if(errno == EAGAIN || errno == EINTR) {
+                struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return false;
+        }
+        s += n;
+        length -= n;
+    }
+
+    return true;
+}
+
+/*
+ * Local stand-in for the controller
+ */
+
+static void standin_write (int fd, const char *s)
+{
+    write_all(fd, s, strlen(s));
+}
+
+static void standin_status (int fd)
+{
+    standin_write(fd, "<Idle|MPos:0.000,0.000,0.000|FS:0,0>\r\n");
+}
+
+// Runs the benchmark as Src/stream_bench.c does, ends on a % line or when no input is received for 2 seconds.
+static void standin_bench (int fd, char mode)
+{
+    bool started = false;
+    char buf[512], line[256], msg[128];
+    size_t length = 0;
+    ssize_t n, idx;
+    uint32_t lines = 0, bytes = 0;
+    double t_first = 0.0, t_last = 0.0, ms;
+    struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+    snprintf(msg, sizeof(msg), "[SBM:ready|%s]\r\n", mode_name[mode == 'E' ? 1 : (mode == 'T' ? 2 : 0)]);
+    standin_write(fd, msg);
+
+    while(poll(&pfd, 1, STANDIN_TIMEOUT_MS) > 0 && (n = read(fd, buf, sizeof(buf))) > 0) {
+
+        for(idx = 0; idx < n; idx++) {
+
+            if(buf[idx] == '?') {
+                standin_status(fd);
+                continue;
+            }
+
+            if(!started) {
+                started = true;
+                t_first = now_ms();
+            }
+
+            bytes++;
+            t_last = now_ms();
+
+            if(buf[idx] != ASCII_LF) {
+                if(length < sizeof(line) - 1)
+                    line[length++] = buf[idx];
+                continue;
+            }
+
+            if(length && line[length - 1] == ASCII_CR)
+                length--;
+            line[length] = '\0';
+            length = 0;
+
+            if(!strcmp(line, "%"))
+                goto done;
+
+            lines++;
+
+            if(mode == 'E') {
+                standin_write(fd, line);
+                standin_write(fd, "\r\n");
+            } else if(mode == 'T') {
+                snprintf(msg, sizeof(msg), "[SBT:%u|%u]\r\n", lines, (uint32_t)((t_last - t_first) * 1000.0));
+                standin_write(fd, msg);
+            }
+        }
+    }
+
+done:
+    ms = t_last - t_first;
+    snprintf(msg, sizeof(msg), "[SBM:%u|bytes:%u|ms:%u|bps:%u|lps:%u|peak:0|ovf:0]\r\n", lines, bytes, (uint32_t)ms,
+              ms > 0.0 ? (uint32_t)(bytes * 1000.0 / ms) : 0, ms > 0.0 ? (uint32_t)(lines * 1000.0 / ms) : 0);
+    standin_write(fd, msg);
+}
+
+// Answers $SBM=<mode> and ?, other lines are acknowledged with ok. Returns when the host closes the connection.
+static void standin (int fd)
+{
+    char buf[256], line[256];
+    size_t length = 0;
+    ssize_t n, idx;
+
+    while((n = read(fd, buf, sizeof(buf))) > 0) {
+
+        for(idx = 0; idx < n; idx++) {
+
+            if(buf[idx] == '?') {
+                standin_status(fd);
+                continue;
+            }
+
+            if(buf[idx] != ASCII_LF) {
+                if(length < sizeof(line) - 1)
+                    line[length++] = buf[idx];
+                continue;
+            }
+
+            if(length && line[length - 1] == ASCII_CR)
+                length--;
+            line[length] = '\0';
+            length = 0;
+
+            if(!strncmp(line, "$SBM=", 5) && line[5] && strchr("SET", line[5]) && line[6] == '\0')
+                standin_bench(fd, line[5]);
+            else if(*line)
+                standin_write(fd, "ok\r\n");
+        }
+    }
+}
+
+/*
+ * Connections
+ */
+
+static int open_local (void)
+{
+    int fd[2];
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fd)) {
+        perror("socketpair");
+        return -1;
+    }
+
+    switch(fork()) {
+
+        case -1:
+            perror("fork");
+            return -1;
+
+        case 0:
+            close(fd[0]);
+            standin(fd[1]);
+            _exit(0);
+
+        default:
+            close(fd[1]);
+            break;
+    }
+
+    return fd[0];
+}
+
+static speed_t baud_rate (uint32_t baud)
+{
+    static const struct { uint32_t baud; speed_t speed; } rates[] = {
+        { 9600, B9600 }, { 19200, B19200 }, { 38400, B38400 }, { 57600, B57600 }, { 115200, B115200 },
+        { 230400, B230400 }, { 460800, B460800 }, { 921600, B921600 }, { 1000000, B1000000 }, { 2000000, B2000000 }
+    };
+
+    uint_fast8_t idx;
+
+    for(idx = 0; idx < sizeof(rates) / sizeof(rates[0]); idx++) {
+        if(rates[idx].baud == baud)
+            return rates[idx].speed;
+    }
+
+    return B0;
+}
+
+// The baud rate is ignored by USB CDC devices.
+static int open_tty (const char *device, uint32_t baud)
+{
+    int fd;
+    speed_t speed;
+    struct termios tio;
+
+    if((speed = baud_rate(baud)) == B0) {
+        fprintf(stderr, "unsupported baud rate %u\n", baud);
+        return -1;
+    }
+
+    if((fd = open(device, O_RDWR|O_NOCTTY|O_NONBLOCK)) < 0) {
+        perror(device);
+        return -1;
+    }
+
+    if(tcgetattr(fd, &tio)) {
+        perror(device);
+        close(fd);
+        return -1;
+    }
+
+    cfmakeraw(&tio);
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    tio.c_cflag |= CLOCAL|CREAD;
+    tio.c_cflag &= ~CRTSCTS;
+
+    if(tcsetattr(fd, TCSANOW, &tio)) {
+        perror(device);
+        close(fd);
+        return -1;
+    }
+
+    tcflush(fd, TCIOFLUSH);
+
+    return fd;
+}
+
+// host[:port], the port defaults to 23.
+static int open_tcp (const char *address)
+{
+    int fd = -1, on = 1, status;
+    char host[256], *port;
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM }, *res, *ai;
+
+    snprintf(host, sizeof(host), "%s", address);
+
+    if((port = strrchr(host, ':')))
+        *port++ = '\0';
+    else
+        port = "23";
+
+    if((status = getaddrinfo(host, port, &hints, &res))) {
+        fprintf(stderr, "%s: %s\n", address, gai_strerror(status));
+        return -1;
+    }
+
+    for(ai = res; ai; ai = ai->ai_next) {
+        if((fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol)) < 0)
+            continue;
+        if(connect(fd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+
+    if(fd < 0)
+        perror(address);
+    else
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+    return fd;
+}
+
+/*
+ * Line reception
+ */
+
+// Reads available input, telnet option negotiation is dropped. Returns false on end of file or error.
+static bool link_receive (link_t *link)
+{
+    uint8_t buf[512];
+    ssize_t n, idx;
+
+    if((n = read(link->fd, buf, sizeof(buf))) == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+        return false;
+
+    for(idx = 0; idx < n; idx++) {
+
+        if(link->iac) {
+            if(link->iac == 2 && buf[idx] == TELNET_IAC) // escaped 255
+                link->iac = 0;
+            else {
+                link->iac = link->iac == 2 && buf[idx] >= TELNET_WILL && buf[idx] < TELNET_IAC ? 1 : 0;
+                continue;
+            }
+        } else if(link->telnet && buf[idx] == TELNET_IAC) {
+            link->iac = 2;
+            continue;
+        }
+
+        if(link->rx_length < sizeof(link->rx) - 1)
+            link->rx[link->rx_length++] = (char)buf[idx];
+    }
+
+    return true;
+}
+
+// Copies the next complete line without the line end to line, returns false if none is available.
+static bool link_line (link_t *link, char *line, size_t size)
+{
+    char *end;
+    size_t length;
+
+    if((end = memchr(link->rx, ASCII_LF, link->rx_length)) == NULL) {
+        if(link->rx_length == sizeof(link->rx) - 1) // discard overlong line
+            link->rx_length = 0;
+        return false;
+    }
+
+    length = end - link->rx;
+    snprintf(line, size, "%.*s", (int)(length && end[-1] == ASCII_CR ? length - 1 : length), link->rx);
+    memmove(link->rx, end + 1, link->rx_length - length - 1);
+    link->rx_length -= length + 1;
+
+    return true;
+}
+
+// Waits for a line starting with prefix, other lines are discarded.
+static bool link_wait (link_t *link, const char *prefix, char *line, size_t size, int timeout_ms)
+{
+    double t_end = now_ms() + timeout_ms;
+    struct pollfd pfd = { .fd = link->fd, .events = POLLIN };
+
+    while(true) {
+
+        while(link_line(link, line, size)) {
+            if(!strncmp(line, prefix, strlen(prefix)))
+                return true;
+        }
+
+        if(now_ms() >= t_end || poll(&pfd, 1, (int)(t_end - now_ms()) + 1) <= 0 || !link_receive(link))
+            return false;
+    }
+}
+
+// Discards input until none is received for timeout_ms, e.g. a welcome message.
+static void link_drain (link_t *link, int timeout_ms)
+{
+    struct pollfd pfd = { .fd = link->fd, .events = POLLIN };
+
+    while(poll(&pfd, 1, timeout_ms) > 0 && link_receive(link))
+        link->rx_length = 0;
+
+    link->rx_length = 0;
+}
+
+/*
+ * Benchmark
+ */
+
+typedef struct {
+    char mode;
+    bool verbose;
+    bool query_pending;
+    double t_query;
+    uint32_t replies, echoes, stamps;
+    stat_t rtt;
+    report_t report;
+} bench_t;
+
+static bool report_parse (report_t *report, const char *line)
+{
+    report->valid = sscanf(line, "[SBM:%u|bytes:%u|ms:%u|bps:%u|lps:%u|peak:%u", &report->lines, &report->bytes, &report->ms,
+                                  &report->bps, &report->lps, &report->peak) == 6;
+    report->has_ovf = report->valid && (line = strstr(line, "|ovf:")) && sscanf(line, "|ovf:%u", &report->ovf) == 1;
+
+    return report->valid;
+}
+
+// Handles a line received while the benchmark runs, returns true for the final report.
+static bool bench_line (bench_t *bench, const char *line)
+{
+    if(bench->verbose)
+        printf("%s\n", line);
+
+    if(*line == '<') {
+        bench->replies++;
+        if(bench->query_pending) {
+            bench->query_pending = false;
+            stat_add(&bench->rtt, now_ms() - bench->t_query);
+        }
+    } else if(!strncmp(line, "[SBT:", 5))
+        bench->stamps++;
+    else if(!strncmp(line, "[SBM:", 5))
+        return report_parse(&bench->report, line);
+    else if(bench->mode == 'E' && *line == 'G')
+        bench->echoes++;
+
+    return false;
+}
+
+// Synthetic G-code, line lengths vary with the coordinates.
+static size_t line_generate (char *line, size_t size, uint32_t n)
+{
+    return snprintf(line, size, "G1X%.3fY%.3fZ%.3fF%u\n", (n % 2000) * 0.137, (n % 1500) * -0.211, (n % 700) * 0.013,
+                     1000 + (n % 9) * 500);
+}
+
+static void usage (const char *name)
+{
+    fprintf(stderr, "usage: %s [options] <-d device | -t host[:port] | -l>\n"
+                    "  -d <device>  serial device, UART or USB CDC, e.g. /dev/ttyACM0\n"
+                    "  -b <baud>    serial baud rate, default 115200\n"
+                    "  -t <host>    Telnet connection, port defaults to 23\n"
+                    "  -l           local stand-in for the controller\n"
+                    "  -m <mode>    S, E or T for sink, echo or timestamp mode, default S\n"
+                    "  -n <lines>   number of lines to send, default 10000\n"
+                    "  -q <ms>      ? status request interval, 0 to disable, default 50\n"
+                    "  -v           list lines received during the run\n", name);
+}
+
+int main (int argc, char **argv)
+{
+    int opt, fd = -1;
+    bool local = false, done = false;
+    char cmd[16], line[512], tx[128];
+    const char *device = NULL, *host = NULL;
+    size_t tx_length = 0, tx_sent = 0;
+    ssize_t n;
+    uint32_t baud = 115200, lines = 10000, query_ms = 50, n_sent = 0, bytes_sent = 0, queries = 0;
+    double t_start = 0.0, t_end = 0.0, t_next_query, t_timeout = 0.0;
+    bench_t bench = { .mode = 'S' };
+    link_t link = {0};
+
+    while((opt = getopt(argc, argv, "d:b:t:lm:n:q:v")) != -1) switch(opt) {
+
+        case 'd':
+            device = optarg;
+            break;
+
+        case 'b':
+            baud = strtoul(optarg, NULL, 0);
+            break;
+
+        case 't':
+            host = optarg;
+            break;
+
+        case 'l':
+            local = true;
+            break;
+
+        case 'm':
+            bench.mode = optarg[0] & 0xDF;
+            break;
+
+        case 'n':
+            lines = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'q':
+            query_ms = strtoul(optarg, NULL, 0);
+            break;
+
+        case 'v':
+            bench.verbose = true;
+            break;
+
+        default:
+            usage(argv[0]);
+            return 2;
+    }
+
+    if(optind != argc || (!!device + !!host + local) != 1 || !bench.mode || !strchr("SET", bench.mode) || lines == 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+
+    if(device)
+        fd = open_tty(device, baud);
+    else if(host)
+        fd = open_tcp(host);
+    else
+        fd = open_local();
+
+    if(fd < 0)
+        return 2;
+
+    nonblocking(fd);
+    link.fd = fd;
+    link.telnet = !!host;
+
+    link_drain(&link, 200);
+
+    snprintf(cmd, sizeof(cmd), "\n$SBM=%c\n", bench.mode);
+    if(!write_all(fd, cmd, strlen(cmd)) || !link_wait(&link, "[SBM:ready", line, sizeof(line), READY_TIMEOUT_MS)) {
+        fprintf(stderr, "no response to $SBM, is the controller built with STREAM_BENCH_ENABLE?\n");
+        return 2;
+    }
+
+    t_next_query = now_ms();
+
+    // Send the lines and the terminating % line, then keep receiving until the final report arrives.
+
+    while(!done) {
+
+        struct pollfd pfd = { .fd = fd, .events = POLLIN|(n_sent <= lines ? POLLOUT : 0) };
+
+        if(poll(&pfd, 1, 100) < 0 && errno != EINTR) {
+            perror("poll");
+            return 2;
+        }
+
+        if(pfd.revents & (POLLERR|POLLHUP)) {
+            fprintf(stderr, "connection lost\n");
+            return 2;
+        }
+
+        if((pfd.revents & POLLIN) && !link_receive(&link)) {
+            fprintf(stderr, "connection closed\n");
+            return 2;
+        }
+
+        while(!done && link_line(&link, line, sizeof(line)))
+            done = bench_line(&bench, line);
+
+        if(n_sent > lines) {
+            if(now_ms() >= t_timeout) {
+                fprintf(stderr, "no final report received\n");
+                return 2;
+            }
+            continue;
+        }
+
+        if(!(pfd.revents & POLLOUT))
+            continue;
+
+        // ? is a realtime command, it is removed from the input and may thus be sent in the middle of a line.
+        if(query_ms && !bench.query_pending && now_ms() >= t_next_query) {
+            if(write(fd, "?", 1) == 1) {
+                bench.t_query = now_ms();
+                t_next_query = bench.t_query + query_ms;
+                bench.query_pending = true;
+                queries++;
+            }
+            continue;
+        }
+
+        if(tx_sent == tx_length) {
+            tx_length = n_sent < lines ? line_generate(tx, sizeof(tx), n_sent) : (size_t)snprintf(tx, sizeof(tx), "%%\n");
+            tx_sent = 0;
+        }
+
+        if((n = write(fd, tx + tx_sent, tx_length - tx_sent)) > 0) {
+            if(bytes_sent == 0)
+                t_start = now_ms();
+            bytes_sent += n;
+            if((tx_sent += n) == tx_length && ++n_sent > lines) {
+                t_end = now_ms();
+                t_timeout = t_end + REPORT_TIMEOUT_MS;
+            }
+        }
+    }
+
+    close(fd);
+
+    if(local)
+        wait(NULL);
+
+    n_sent--; // the % line is not counted by the controller
+
+    printf("mode:       %s\n", mode_name[bench.mode == 'E' ? 1 : (bench.mode == 'T' ? 2 : 0)]);
+    printf("host:       %u lines, %u bytes in %.1f ms, %.0f bytes/s, %.0f lines/s\n", n_sent, bytes_sent, t_end - t_start,
+            t_end > t_start ? bytes_sent * 1000.0 / (t_end - t_start) : 0.0, t_end > t_start ? n_sent * 1000.0 / (t_end - t_start) : 0.0);
+    printf("controller: %u lines, %u bytes in %u ms, %u bytes/s, %u lines/s, peak buffer %u\n", bench.report.lines, bench.report.bytes,
+            bench.report.ms, bench.report.bps, bench.report.lps, bench.report.peak);
+
+    if(bench.report.has_ovf)
+        printf("overflows:  %u\n", bench.report.ovf);
+    else
+        printf("overflows:  not reported by the stream\n");
+
+    printf("lost:       %d bytes, %d lines\n", (int)(bytes_sent - bench.report.bytes), (int)(n_sent - bench.report.lines));
+
+    if(query_ms)
+        printf("status:     %u requests, %u replies, round trip min %.2f avg %.2f max %.2f ms\n", queries, bench.replies,
+                bench.rtt.min, bench.rtt.n ? bench.rtt.sum / bench.rtt.n : 0.0, bench.rtt.max);
+
+    if(bench.mode == 'E')
+        printf("echoed:     %u lines\n", bench.echoes);
+    else if(bench.mode == 'T')
+        printf("stamped:    %u lines\n", bench.stamps);
+
+    return bench.report.bytes == bytes_sent && bench.report.lines == n_sent && !(bench.report.has_ovf && bench.report.ovf) ? 0 : 1;
+}